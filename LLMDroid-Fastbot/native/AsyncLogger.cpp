@@ -0,0 +1,208 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef AsyncLogger_CPP_
+#define AsyncLogger_CPP_
+
+#include <cstdlib>
+#include "AsyncLogger.h"
+#include "Base.h"
+#include "utils.hpp"
+
+namespace fastbotx {
+
+    AsyncLogger &AsyncLogger::inst() {
+        // never destroyed: lines may still be logged by destructors of other statics at exit,
+        // the atexit handler stops the drain thread instead
+        static AsyncLogger *logger = new AsyncLogger();
+        return *logger;
+    }
+
+    AsyncLogger::AsyncLogger()
+            : _slots(Capacity) {
+        for (size_t i = 0; i < Capacity; i++) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        _drainThread = std::thread(&AsyncLogger::drain, this);
+        std::atexit([] { AsyncLogger::inst().shutdown(); });
+    }
+
+    AsyncLogger::Slot *AsyncLogger::claim(size_t &position) {
+        // counted before _stopped is checked, so the drain thread waits for a slot claimed after the stop
+        _claiming.fetch_add(1, std::memory_order_seq_cst);
+        position = _enqueuePosition.load(std::memory_order_relaxed);
+        while (!_stopped.load(std::memory_order_seq_cst)) {
+            Slot &slot = _slots[position & (Capacity - 1)];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (_enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                           std::memory_order_relaxed)) {
+                    _claiming.fetch_sub(1, std::memory_order_release);
+                    return &slot;
+                }
+            } else if (difference < 0) {
+                // full: wait for the drain thread rather than lose the line
+                _wakeDrain.notify_one();
+                std::this_thread::yield();
+                position = _enqueuePosition.load(std::memory_order_relaxed);
+            } else {
+                position = _enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        _claiming.fetch_sub(1, std::memory_order_release);
+        return nullptr;
+    }
+
+    void AsyncLogger::publish(Slot *slot, size_t position) {
+        slot->sequence.store(position + 1, std::memory_order_seq_cst);
+        // the drain thread checks for a record after it says it sleeps, one published before is
+        // seen there and one after is notified, under the lock so not before it waits
+        if (_drainSleeping.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(_wakeMutex);
+            _wakeDrain.notify_one();
+        }
+    }
+
+    bool AsyncLogger::published() const {
+        const Slot &slot = _slots[_dequeuePosition & (Capacity - 1)];
+        return slot.sequence.load(std::memory_order_seq_cst) == _dequeuePosition + 1;
+    }
+
+    void AsyncLogger::drain() {
+        JavaVM *vm = nullptr;
+        jclass logger = nullptr;
+        jmethodID println = nullptr;
+        JNIEnv *env = nullptr;
+        while (true) {
+            if (!env) {
+                std::lock_guard<std::mutex> lock(_wakeMutex);
+                vm = _javaVM;
+                logger = _loggerClass;
+                println = _printlnMethod;
+            }
+            // attach once the Java logger is set up, as a daemon so the JVM can still exit
+            if (!env && vm && logger && println) {
+                if (vm->AttachCurrentThreadAsDaemon(&env, nullptr) != JNI_OK)
+                    env = nullptr;
+            }
+            size_t drained = writePublished(env, logger, println);
+            if (drained > 0)
+                continue;
+            if (_stopped.load(std::memory_order_seq_cst)) {
+                // up to the last claimed slot, its producer may still be copying the arguments
+                if (_claiming.load(std::memory_order_seq_cst) == 0 &&
+                    _dequeuePosition == _enqueuePosition.load(std::memory_order_acquire))
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_wakeMutex);
+            _drainSleeping.store(true, std::memory_order_seq_cst);
+            _wakeDrain.wait(lock, [this] { return published() || _stopped.load(std::memory_order_seq_cst); });
+            _drainSleeping.store(false, std::memory_order_relaxed);
+        }
+        if (env)
+            vm->DetachCurrentThread();
+    }
+
+    size_t AsyncLogger::writePublished(JNIEnv *env, jclass logger, jmethodID println) {
+        std::string line;
+        std::string batch;
+        size_t drained = 0;
+        while (true) {
+            Slot &slot = _slots[_dequeuePosition & (Capacity - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != _dequeuePosition + 1)
+                break;
+            Record &record = slot.record;
+            record.write(record.format, record.args, line);
+            record.destroy(record.args, record.args == record.inlineArgs);
+            slot.sequence.store(_dequeuePosition + Capacity, std::memory_order_release);
+            _dequeuePosition++;
+            drained++;
+
+            if (env) {
+                jstring message = env->NewStringUTF(line.c_str());
+                env->CallStaticVoidMethod(logger, println, message);
+                if (env->ExceptionCheck())
+                    env->ExceptionClear();
+                env->DeleteLocalRef(message);
+            } else {
+                LOGI("%s", line.c_str());
+            }
+            batch.append(line).push_back('\n');
+        }
+        if (drained == 0)
+            return 0;
+        {
+            // one write per batch instead of one per line
+            std::lock_guard<std::mutex> lock(_fileMutex);
+            if (_file) {
+                fwrite(batch.data(), 1, batch.size(), _file);
+                fflush(_file);
+            }
+        }
+        _written.fetch_add(drained, std::memory_order_release);
+        {
+            // flush checks _written under the lock, it is waiting or sees the new count
+            std::lock_guard<std::mutex> lock(_wakeMutex);
+        }
+        _wakeFlush.notify_all();
+        return drained;
+    }
+
+    void AsyncLogger::outputInPlace(const std::string &line) {
+        LOGI("%s", line.c_str());
+        std::lock_guard<std::mutex> lock(_fileMutex);
+        if (_file) {
+            fwrite(line.data(), 1, line.size(), _file);
+            fputc('\n', _file);
+            fflush(_file);
+        }
+    }
+
+    void AsyncLogger::flush() {
+        size_t target = _enqueuePosition.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(_wakeMutex);
+        _wakeFlush.wait(lock, [this, target] {
+            return _written.load(std::memory_order_acquire) >= target || _stopped.load(std::memory_order_seq_cst);
+        });
+    }
+
+    void AsyncLogger::setFile(const std::string &path) {
+        std::lock_guard<std::mutex> lock(_fileMutex);
+        if (_file) {
+            fclose(_file);
+            _file = nullptr;
+        }
+        if (!path.empty()) {
+            _file = fopen(path.c_str(), "a");
+            if (!_file)
+                LOGE("can not open log file %s", path.c_str());
+        }
+    }
+
+    void AsyncLogger::setJavaLogger(JavaVM *vm, jclass logger, jmethodID println) {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _javaVM = vm;
+        _loggerClass = logger;
+        _printlnMethod = println;
+    }
+
+    void AsyncLogger::shutdown() {
+        if (_stopped.exchange(true))
+            return;
+        {
+            std::lock_guard<std::mutex> lock(_wakeMutex);
+            _wakeDrain.notify_one();
+            _wakeFlush.notify_all();
+        }
+        if (_drainThread.joinable() && _drainThread.get_id() != std::this_thread::get_id())
+            _drainThread.join();
+        // nothing is left once the drain thread has stopped, unless the drain thread itself shuts down
+        writePublished(nullptr, nullptr, nullptr);
+    }
+
+}
+
+#endif //AsyncLogger_CPP_
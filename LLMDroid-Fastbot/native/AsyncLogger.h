@@ -0,0 +1,202 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef AsyncLogger_H_
+#define AsyncLogger_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <jni.h>
+
+namespace fastbotx {
+
+    /// printf arguments are kept as they are, except C strings, which are copied: the caller's
+    /// buffer (often a temporary's c_str()) is gone by the time the record is formatted
+    template<typename T>
+    using LogStored = typename std::conditional<
+            std::is_same<typename std::decay<T>::type, char *>::value ||
+            std::is_same<typename std::decay<T>::type, const char *>::value ||
+            std::is_same<typename std::decay<T>::type, std::string>::value,
+            std::string, typename std::decay<T>::type>::type;
+
+    inline std::string logStore(const char *value) { return value ? value : "(null)"; }
+
+    inline std::string logStore(char *value) { return value ? value : "(null)"; }
+
+    inline std::string logStore(const std::string &value) { return value; }
+
+    template<typename T>
+    inline T logStore(const T &value) { return value; }
+
+    inline const char *logValue(const std::string &value) { return value.c_str(); }
+
+    template<typename T>
+    inline const T &logValue(const T &value) { return value; }
+
+    /**
+     * @brief Log records queued by any thread without locks, then formatted and written by one
+     * drain thread. The drain thread attaches to the JVM once and hands the lines to the Java
+     * Logger, or to logcat before the Java logger is set up, and optionally appends them to a file.
+     *
+     * Producers only copy the arguments into a slot of a bounded ring (sequence numbered slots,
+     * so producers claim slots with one CAS and never wait on each other). When the ring is full,
+     * producers yield until the drain thread frees a slot rather than drop lines.
+     */
+    class AsyncLogger {
+    public:
+        static AsyncLogger &inst();
+
+        /// Queue a line formatted by printf rules
+        /// \param format must outlive the logger, i.e. a string literal
+        template<typename ...Args>
+        void log(const char *format, Args... args);
+
+        /// Block until every line queued before the call is written
+        void flush();
+
+        /// Also append the lines to this file, empty to stop
+        void setFile(const std::string &path);
+
+        /// Hand the lines to Logger.println from now on, logcat until then
+        /// \param logger a global reference
+        void setJavaLogger(JavaVM *vm, jclass logger, jmethodID println);
+
+        /// Write what is queued and stop the drain thread, lines logged later are written in place
+        void shutdown();
+
+    private:
+        static constexpr size_t Capacity = 4096;
+        static constexpr size_t InlineArgsSize = 192;
+
+        struct Record {
+            const char *format;
+            void (*write)(const char *format, const void *args, std::string &out);
+            void (*destroy)(void *args, bool isInline);
+            void *args;
+            alignas(std::max_align_t) unsigned char inlineArgs[InlineArgsSize];
+        };
+
+        struct Slot {
+            std::atomic<size_t> sequence;
+            Record record;
+        };
+
+        AsyncLogger();
+
+        template<typename Tuple, size_t... I>
+        static void writeTuple(const char *format, const Tuple &args, std::string &out,
+                               std::index_sequence<I...>);
+
+        template<typename Tuple>
+        static void writeRecord(const char *format, const void *args, std::string &out);
+
+        template<typename Tuple>
+        static void destroyRecord(void *args, bool isInline);
+
+        /// Claim the next free slot, nullptr once the logger is shut down
+        Slot *claim(size_t &position);
+
+        void publish(Slot *slot, size_t position);
+
+        /// Whether the next record to write is published
+        bool published() const;
+
+        void drain();
+
+        /// Format and write the published records in order, to the Java logger if env is set
+        /// \return number of records written
+        size_t writePublished(JNIEnv *env, jclass logger, jmethodID println);
+
+        void outputInPlace(const std::string &line);
+
+        std::vector<Slot> _slots;
+        alignas(64) std::atomic<size_t> _enqueuePosition{0};
+        alignas(64) size_t _dequeuePosition{0};
+        std::atomic<size_t> _written{0};
+        // producers between checking _stopped and claiming a slot
+        std::atomic<int> _claiming{0};
+
+        std::atomic<bool> _drainSleeping{false};
+        std::atomic<bool> _stopped{false};
+        // guards the sleeps of the drain thread and of flush, and the Java logger
+        std::mutex _wakeMutex;
+        std::condition_variable _wakeDrain;
+        std::condition_variable _wakeFlush;
+        JavaVM *_javaVM{nullptr};
+        jclass _loggerClass{nullptr};
+        jmethodID _printlnMethod{nullptr};
+
+        std::mutex _fileMutex;
+        FILE *_file{nullptr};
+
+        std::thread _drainThread;
+    };
+
+    template<typename Tuple, size_t... I>
+    void AsyncLogger::writeTuple(const char *format, const Tuple &args, std::string &out,
+                                 std::index_sequence<I...>) {
+        char buffer[1024];
+        int length = snprintf(buffer, sizeof(buffer), format, logValue(std::get<I>(args))...);
+        if (length < 0)
+            return;
+        if (static_cast<size_t>(length) < sizeof(buffer)) {
+            out.assign(buffer, static_cast<size_t>(length));
+            return;
+        }
+        out.resize(static_cast<size_t>(length) + 1);
+        snprintf(&out[0], out.size(), format, logValue(std::get<I>(args))...);
+        out.resize(static_cast<size_t>(length));
+    }
+
+    template<typename Tuple>
+    void AsyncLogger::writeRecord(const char *format, const void *args, std::string &out) {
+        writeTuple(format, *static_cast<const Tuple *>(args), out,
+                   std::make_index_sequence<std::tuple_size<Tuple>::value>());
+    }
+
+    template<typename Tuple>
+    void AsyncLogger::destroyRecord(void *args, bool isInline) {
+        if (isInline)
+            static_cast<Tuple *>(args)->~Tuple();
+        else
+            delete static_cast<Tuple *>(args);
+    }
+
+    template<typename ...Args>
+    void AsyncLogger::log(const char *format, Args... args) {
+        typedef std::tuple<LogStored<Args>...> Tuple;
+        size_t position;
+        Slot *slot = claim(position);
+        if (!slot) {
+            // after shutdown, e.g. from an atexit handler registered earlier
+            std::string line;
+            Tuple stored(logStore(args)...);
+            writeRecord<Tuple>(format, &stored, line);
+            outputInPlace(line);
+            return;
+        }
+        Record &record = slot->record;
+        record.format = format;
+        record.write = &AsyncLogger::writeRecord<Tuple>;
+        record.destroy = &AsyncLogger::destroyRecord<Tuple>;
+        if (sizeof(Tuple) <= InlineArgsSize && alignof(Tuple) <= alignof(std::max_align_t))
+            record.args = new(record.inlineArgs) Tuple(logStore(args)...);
+        else
+            record.args = new Tuple(logStore(args)...);
+        publish(slot, position);
+    }
+
+}
+
+#endif //AsyncLogger_H_
@@ -12,25 +12,131 @@
 #include <algorithm>
 #include <codecvt>
 #include <locale>
+#include <cstring>
 
 namespace fastbotx {
     JavaVM* jvm;
     JNIEnv* jnienv;
     jclass loggerClass;
     jmethodID printlnMethod;
-    std::mutex loggerMutex;
 
     jclass codeCoverageClass;
     jmethodID getCoverageMethod;
 
+    namespace {
+        const uint64_t kHashSecret0 = 0xa0761d6478bd642fULL;
+        const uint64_t kHashSecret1 = 0xe7037ed1a0b428dbULL;
+        const uint64_t kHashSecret2 = 0x8ebc6af09c88c6e3ULL;
+        const uint64_t kHashSecret3 = 0x589965cc75374cc3ULL;
+
+        // 64x64 -> 128 bits multiplication, lo and hi are replaced by the two halves
+        inline void hashMum(uint64_t *lo, uint64_t *hi) {
+#if defined(__SIZEOF_INT128__)
+            __uint128_t r = static_cast<__uint128_t>(*lo) * (*hi);
+            *lo = static_cast<uint64_t>(r);
+            *hi = static_cast<uint64_t>(r >> 64);
+#else
+            uint64_t ha = *lo >> 32, hb = *hi >> 32, la = (uint32_t) *lo, lb = (uint32_t) *hi;
+            uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+            uint64_t t = rl + (rm0 << 32), c = t < rl;
+            uint64_t lo2 = t + (rm1 << 32);
+            c += lo2 < t;
+            *lo = lo2;
+            *hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+        }
+
+        inline uint64_t hashRead8(const uint8_t *p) {
+            uint64_t v;
+            memcpy(&v, p, 8);
+            return v;
+        }
+
+        inline uint64_t hashRead4(const uint8_t *p) {
+            uint32_t v;
+            memcpy(&v, p, 4);
+            return v;
+        }
+
+        inline uint64_t hashRead3(const uint8_t *p, size_t k) {
+            return (((uint64_t) p[0]) << 16) | (((uint64_t) p[k >> 1]) << 8) | p[k - 1];
+        }
+
+        inline uint64_t hashMix(uint64_t a, uint64_t b) {
+            hashMum(&a, &b);
+            return a ^ b;
+        }
+    }
+
+    uint64_t fastMix(uint64_t a, uint64_t b) {
+        // without the secrets a zero on either side would zero the product
+        return hashMix(a ^ kHashSecret0, b ^ kHashSecret1);
+    }
+
+    uint64_t fastHash(const void *data, size_t len, uint64_t seed) {
+        const auto *p = static_cast<const uint8_t *>(data);
+        seed ^= hashMix(seed ^ kHashSecret0, kHashSecret1);
+        uint64_t a, b;
+        if (len <= 16) {
+            if (len >= 4) {
+                a = (hashRead4(p) << 32) | hashRead4(p + ((len >> 3) << 2));
+                b = (hashRead4(p + len - 4) << 32) | hashRead4(p + len - 4 - ((len >> 3) << 2));
+            } else if (len > 0) {
+                a = hashRead3(p, len);
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            size_t i = len;
+            if (i > 48) {
+                // three independent lanes, so the multiplications can overlap
+                uint64_t seed1 = seed, seed2 = seed;
+                do {
+                    seed = hashMix(hashRead8(p) ^ kHashSecret1, hashRead8(p + 8) ^ seed);
+                    seed1 = hashMix(hashRead8(p + 16) ^ kHashSecret2, hashRead8(p + 24) ^ seed1);
+                    seed2 = hashMix(hashRead8(p + 32) ^ kHashSecret3, hashRead8(p + 40) ^ seed2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= seed1 ^ seed2;
+            }
+            while (i > 16) {
+                seed = hashMix(hashRead8(p) ^ kHashSecret1, hashRead8(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = hashRead8(p + i - 16);
+            b = hashRead8(p + i - 8);
+        }
+        a ^= kHashSecret1;
+        b ^= seed;
+        hashMum(&a, &b);
+        return hashMix(a ^ kHashSecret0 ^ len, b ^ kHashSecret1);
+    }
+
+    uintptr_t hashString(const std::string &str) {
+#if HASH_LAYOUT_VERSION >= 2
+        return static_cast<uintptr_t>(fastHash(str));
+#else
+        return std::hash<std::string>{}(str);
+#endif
+    }
+
     const char* htmlClass[] = {
-        #define HTML_ITEM(a, b, c) b,
+        #define HTML_ITEM(a, b, c, d) b,
         HTML_TABLE
         #undef HTML_ITEM       
     };
 
     const char* htmlEndTag[] = {
-        #define HTML_ITEM(a, b, c) c,
+        #define HTML_ITEM(a, b, c, d) c,
+        HTML_TABLE
+        #undef HTML_ITEM
+    };
+
+    const char* compactTag[] = {
+        #define HTML_ITEM(a, b, c, d) d,
         HTML_TABLE
         #undef HTML_ITEM
     };
@@ -104,6 +210,48 @@ namespace fastbotx {
 
     }
 
+    static inline uint64_t rotateLeft(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    void FastRandom::seed(uint64_t seed) {
+        // expand the seed with splitmix64, so that nearby seeds give unrelated sequences
+        for (uint64_t &word: this->_state) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t FastRandom::next() {
+        uint64_t *s = this->_state;
+        uint64_t result = rotateLeft(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotateLeft(s[3], 45);
+        return result;
+    }
+
+    int FastRandom::nextInt(int min, int max) {
+        if (max <= min)
+            return min;
+        // multiply-shift maps 32 random bits onto the range without a division
+        uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(max) - min);
+        return static_cast<int>(min + static_cast<int64_t>(((next() >> 32) * range) >> 32));
+    }
+
+    uint64_t timeRandomSeed() {
+        auto now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+        static std::atomic<uint64_t> counter{0};
+        return fastMix(static_cast<uint64_t>(now), counter.fetch_add(1));
+    }
+
     Rect::Rect() {
         this->top = 0;
         this->bottom = 0;
@@ -130,8 +278,8 @@ namespace fastbotx {
     }
 
     Point Rect::center() const {
-        return {(int) ((double) (this->top) + 0.5f * (double) (this->bottom - this->top)),
-                (int) ((double) this->left + 0.5f * (double) (this->right - this->left))};
+        return {(int) ((double) this->left + 0.5f * (double) (this->right - this->left)),
+                (int) ((double) (this->top) + 0.5f * (double) (this->bottom - this->top))};
     }
 
     bool Rect::contains(const Point &point) const {
@@ -22,6 +22,7 @@
 #include <cmath>
 
 #include "json.hpp"
+#include "AsyncLogger.h"
 #include <jni.h>
 #include <mutex>
 
@@ -42,18 +43,19 @@ namespace std {
 #define MAIN_THREAD 0
 #define CHILD_THREAD 1
 
+// class, html tag, html end tag, tag of the compact description
 #define HTML_TABLE \
-    HTML_ITEM(BUTTON, "button", "</button>")          \
-    HTML_ITEM(CHECKBOX, "checkbox", "</checkbox>")    \
-    HTML_ITEM(SCROLLER, "scroller", "</scroller>")    \
-    HTML_ITEM(INPUT, "input", "</input>")             \
-    HTML_ITEM(P, "p", "</p>")
+    HTML_ITEM(BUTTON, "button", "</button>", "b")          \
+    HTML_ITEM(CHECKBOX, "checkbox", "</checkbox>", "c")    \
+    HTML_ITEM(SCROLLER, "scroller", "</scroller>", "s")    \
+    HTML_ITEM(INPUT, "input", "</input>", "i")             \
+    HTML_ITEM(P, "p", "</p>", "p")
 
 namespace fastbotx {
 
     enum HTML_CLASS
     {
-        #define HTML_ITEM(a, b, c) a,
+        #define HTML_ITEM(a, b, c, d) a,
         HTML_TABLE
         #undef HTML_ITEM
         HTML_CLASS_NUM
@@ -63,60 +65,25 @@ namespace fastbotx {
 
     extern const char* htmlEndTag[];
 
+    extern const char* compactTag[];
+
     extern JavaVM* jvm;
     extern JNIEnv* jnienv;
     extern jclass loggerClass;
     extern jmethodID printlnMethod;
-    extern std::mutex loggerMutex;
 
     extern jclass codeCoverageClass;
     extern jmethodID getCoverageMethod;
 
 
+    /// Queue a line for the Java Logger, formatted and written by the AsyncLogger drain thread
+    /// \param type MAIN_THREAD or CHILD_THREAD, kept for callers: any thread may log now
     template <typename ...Args>
     void callJavaLogger(int type, const char* format, Args... args)
     {
-        std::lock_guard<std::mutex> lock(loggerMutex);
-        
-        constexpr size_t bufflen = 1024;
-        char buffer[bufflen]; // Buffer on the default stack
-
-
-        size_t newlen = snprintf(buffer, bufflen, format, args..., nullptr);
-        newlen++; // Counting the terminator '\0'
-
-        char* message = nullptr;
-    
-        if (newlen > bufflen) { // The default buffer is not large enough and is allocated from the heap
-            std::vector<char> newbuffer(newlen);
-            snprintf(newbuffer.data(), newlen, format, args..., nullptr);
-            message = newbuffer.data();
-        }
-        else {
-            message = buffer;
-        }
-
-        if (type == MAIN_THREAD)
-        {
-            // Call this static method
-            jstring jmessage = jnienv->NewStringUTF(message);
-            jnienv->CallStaticVoidMethod(loggerClass, printlnMethod, jmessage);
-            // Release local reference
-            jnienv->DeleteLocalRef(jmessage);
-        }
-        else
-        {
-            JNIEnv *env;
-            jvm->AttachCurrentThread(&env, 0);
-
-            jstring jmessage = env->NewStringUTF(message);
-            env->CallStaticVoidMethod(loggerClass, printlnMethod, jmessage);
-            env->DeleteLocalRef(jmessage);
-
-            jvm->DetachCurrentThread();
-        }
-        
-    };
+        (void) type;
+        AsyncLogger::inst().log(format, args...);
+    }
 
     std::string safe_utf8_substr(const std::string& str, size_t start, size_t len);
 
@@ -225,6 +192,27 @@ namespace fastbotx {
         return hashCode;
     }
 
+    /// 64-bit non-cryptographic hash of a byte range (wyhash style: 8-byte reads folded with
+    /// 64x64->128 multiplications), much cheaper than std::hash on long strings.
+    /// \param data start of the bytes
+    /// \param len number of bytes
+    /// \param seed chains several fields into one hash when the previous result is passed in
+    /// \return the hash code
+    uint64_t fastHash(const void *data, size_t len, uint64_t seed = 0);
+
+    inline uint64_t fastHash(const std::string &str, uint64_t seed = 0) {
+        return fastHash(str.data(), str.size(), seed);
+    }
+
+    /// Mix two 64-bit values into one, used to fold integers and child hashes into a hash.
+    /// Its values are part of hash layout 2, like those of hashString
+    uint64_t fastMix(uint64_t a, uint64_t b);
+
+    /// The string hash behind widget, action and state hashes, picked by HASH_LAYOUT_VERSION
+    /// in utils.hpp. Those hashes are persisted in the reuse model, so they must not change
+    /// within one layout version.
+    uintptr_t hashString(const std::string &str);
+
     // ActionType
     enum ActionType {
         CRASH = 0,
@@ -368,6 +356,40 @@ namespace fastbotx {
     }
 
 
+    /// xoshiro256** generator. Small, fast and reproducible from its seed, unlike std::rand,
+    /// whose state is shared by the whole process and which callers used to reseed with the
+    /// current second.
+    class FastRandom {
+    public:
+        typedef uint64_t result_type;
+
+        explicit FastRandom(uint64_t seed = 0) { this->seed(seed); }
+
+        /// Restart the sequence, the same seed always gives the same sequence
+        void seed(uint64_t seed);
+
+        uint64_t next();
+
+        /// Uniform in [min, max), min if the range is empty
+        int nextInt(int min, int max);
+
+        /// Uniform in [0, 1)
+        double nextDouble() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+        // lets std distributions and std::shuffle draw from it
+        static constexpr result_type min() { return 0; }
+
+        static constexpr result_type max() { return UINT64_MAX; }
+
+        result_type operator()() { return next(); }
+
+    private:
+        uint64_t _state[4]{};
+    };
+
+    /// A seed that differs from run to run, for generators the user gave no seed
+    uint64_t timeRandomSeed();
+
     inline int randomInt(int min, int max, int seed) {
         std::srand((unsigned int) std::time(nullptr) + seed * 2989);
         int rand = std::rand();
@@ -0,0 +1,163 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef Tracer_CPP_
+#define Tracer_CPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include "Tracer.h"
+#include "Base.h"
+#include "utils.hpp"
+
+namespace fastbotx {
+
+    // about 6 MB a thread, later spans of the thread are counted but not kept
+    static const size_t MaxSpansPerThread = 1 << 18;
+
+    Tracer &Tracer::inst() {
+        // never destroyed, spans may end in destructors of other statics at exit
+        static Tracer *tracer = new Tracer();
+        return *tracer;
+    }
+
+    int64_t Tracer::now() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Tracer::enable(const std::string &path) {
+        if (path.empty() || this->_enabled.load())
+            return;
+        this->_path = path;
+        this->_startTime = now();
+        this->_enabled.store(true);
+        std::atexit([] { Tracer::inst().finish(); });
+    }
+
+    Tracer::ThreadBuffer &Tracer::localBuffer() {
+        // owned by _buffers too, so the spans outlive the thread
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer) {
+            buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(this->_buffersMutex);
+            buffer->tid = static_cast<int>(this->_buffers.size()) + 1;
+            this->_buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    void Tracer::record(const char *name, int64_t begin, int64_t end) {
+        if (!enabled())
+            return;
+        ThreadBuffer &buffer = localBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.spans.size() >= MaxSpansPerThread) {
+            buffer.dropped++;
+            return;
+        }
+        buffer.spans.push_back({name, begin, end - begin});
+    }
+
+    void Tracer::nameThread(const char *name) {
+        if (!enabled())
+            return;
+        ThreadBuffer &buffer = localBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.name = name;
+    }
+
+    void Tracer::finish() {
+        if (!enabled() || this->_finished.exchange(true))
+            return;
+        exportChromeTrace(this->_path);
+        writeSummary(this->_path + ".summary.txt");
+    }
+
+    bool Tracer::exportChromeTrace(const std::string &path) {
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file) {
+            BLOGE("can not open trace file %s", path.c_str());
+            return false;
+        }
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+        bool first = true;
+        std::lock_guard<std::mutex> buffersLock(this->_buffersMutex);
+        for (const auto &buffer: this->_buffers) {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            if (buffer->name) {
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                              "\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", buffer->tid, buffer->name);
+                first = false;
+            }
+            for (const Span &span: buffer->spans) {
+                // span names are literals of this code base, no escaping needed
+                fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"fastbot\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                              "\"ts\":%lld,\"dur\":%lld}", first ? "" : ",\n", span.name, buffer->tid,
+                        static_cast<long long>(span.begin - this->_startTime),
+                        static_cast<long long>(span.duration));
+                first = false;
+            }
+        }
+        fputs("\n]}\n", file);
+        fclose(file);
+        return true;
+    }
+
+    void Tracer::writeSummary(const std::string &path) {
+        std::map<std::string, std::vector<int64_t>> durations;
+        uint64_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> buffersLock(this->_buffersMutex);
+            for (const auto &buffer: this->_buffers) {
+                std::lock_guard<std::mutex> lock(buffer->mutex);
+                for (const Span &span: buffer->spans) {
+                    durations[span.name].push_back(span.duration);
+                }
+                dropped += buffer->dropped;
+            }
+        }
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file)
+            BLOGE("can not open trace summary file %s", path.c_str());
+        char line[256];
+        snprintf(line, sizeof(line), "%-24s %8s %10s %10s %10s %10s %12s", "span(ms)", "count",
+                 "p50", "p95", "p99", "max", "total");
+        callJavaLogger(MAIN_THREAD, "[Trace] %s", line);
+        if (file)
+            fprintf(file, "%s\n", line);
+        for (auto &entry: durations) {
+            std::vector<int64_t> &values = entry.second;
+            std::sort(values.begin(), values.end());
+            auto percentile = [&values](double p) {
+                size_t index = static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+                return static_cast<double>(values[index]) / 1000.0;
+            };
+            int64_t total = 0;
+            for (int64_t value: values) {
+                total += value;
+            }
+            snprintf(line, sizeof(line), "%-24s %8zu %10.3f %10.3f %10.3f %10.3f %12.3f",
+                     entry.first.c_str(), values.size(), percentile(0.5), percentile(0.95),
+                     percentile(0.99), static_cast<double>(values.back()) / 1000.0,
+                     static_cast<double>(total) / 1000.0);
+            callJavaLogger(MAIN_THREAD, "[Trace] %s", line);
+            if (file)
+                fprintf(file, "%s\n", line);
+        }
+        if (dropped > 0) {
+            callJavaLogger(MAIN_THREAD, "[Trace] %llu spans dropped, thread buffers full",
+                           static_cast<unsigned long long>(dropped));
+            if (file)
+                fprintf(file, "%llu spans dropped\n", static_cast<unsigned long long>(dropped));
+        }
+        if (file)
+            fclose(file);
+    }
+
+}
+
+#endif //Tracer_CPP_
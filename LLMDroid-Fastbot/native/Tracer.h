@@ -0,0 +1,105 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef Tracer_H_
+#define Tracer_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fastbotx {
+
+    /**
+     * @brief Records timed spans of the phases of a step, and of the LLM thread, into a buffer
+     * per thread. At the end of the run they are exported as Chrome trace JSON, which
+     * chrome://tracing and the Perfetto UI open, along with a p50/p95/p99 table per phase.
+     * Costs one relaxed load per span while disabled.
+     */
+    class Tracer {
+    public:
+        static Tracer &inst();
+
+        bool enabled() const { return this->_enabled.load(std::memory_order_relaxed); }
+
+        /// Start recording, the trace goes to path and the summary to path + ".summary.txt"
+        /// when the process exits, or on finish()
+        void enable(const std::string &path);
+
+        /// Steady clock in microseconds
+        static int64_t now();
+
+        /// \param name must outlive the tracer, i.e. a string literal
+        void record(const char *name, int64_t begin, int64_t end);
+
+        /// Name the calling thread in the trace
+        void nameThread(const char *name);
+
+        /// Write the trace and the summary, once
+        void finish();
+
+        bool exportChromeTrace(const std::string &path);
+
+        /// Log a table of count, p50, p95, p99, max and total per span name, and write it to path
+        void writeSummary(const std::string &path);
+
+    private:
+        struct Span {
+            const char *name;
+            int64_t begin;
+            int64_t duration;
+        };
+
+        struct ThreadBuffer {
+            // only contended while exporting
+            std::mutex mutex;
+            std::vector<Span> spans;
+            uint64_t dropped = 0;
+            int tid = 0;
+            const char *name = nullptr;
+        };
+
+        Tracer() = default;
+
+        ThreadBuffer &localBuffer();
+
+        std::atomic<bool> _enabled{false};
+        std::atomic<bool> _finished{false};
+        std::string _path;
+        int64_t _startTime = 0;
+
+        std::mutex _buffersMutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> _buffers;
+    };
+
+    /// Records the span from its construction to the end of its scope
+    class TraceSpan {
+    public:
+        explicit TraceSpan(const char *name)
+                : _name(Tracer::inst().enabled() ? name : nullptr),
+                  _begin(_name ? Tracer::now() : 0) {}
+
+        ~TraceSpan() {
+            if (this->_name)
+                Tracer::inst().record(this->_name, this->_begin, Tracer::now());
+        }
+
+        TraceSpan(const TraceSpan &) = delete;
+
+        TraceSpan &operator=(const TraceSpan &) = delete;
+
+    private:
+        const char *_name;
+        int64_t _begin;
+    };
+
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) fastbotx::TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#endif //Tracer_H_
@@ -13,6 +13,8 @@
 #include <utility>
 #include "../model/Model.h"
 #include "../thirdpart/json/json.hpp"
+#include "../Tracer.h"
+#include "LLMMetrics.h"
 
 using json = nlohmann::json;
 
@@ -34,6 +36,8 @@ namespace fastbotx {
         _lastGraphOverviewTime = currentStamp();
         _startTime = currentStamp();
         _nextStageTime = _startTime + _runTime;
+        if (_useCodeCoverage)
+            _coverageSampler.start();
         ////read from json
         //std::ifstream file("/sdcard/config.json");
         ////Check if the file is opened successfully
@@ -116,8 +120,17 @@ namespace fastbotx {
     {       
         _mCurrentState = state;
         if (_mCurrentAction) { callJavaLogger(MAIN_THREAD, "Last Action: %s\n", _mCurrentAction->toDescription().c_str()); }
+        // the description is written before the MergedState is known, the current one most likely shares its elements
+        MergedStatePtr currentNode = _mergedStateGraph->getCurrentNode();
+        if (!state->getMergedState() && currentNode) {
+            state->borrowFragmentCache(currentNode->getFragmentCache());
+        }
         callJavaLogger(MAIN_THREAD, "State%d\n%s\n------------------\n", state->getIdi(), state->getStateDescription().c_str());
-        MergedStatePtr mergedState = findMostSimilar(state);
+        MergedStatePtr mergedState = nullptr;
+        {
+            TRACE_SCOPE("findMostSimilar");
+            mergedState = findMostSimilar(state);
+        }
         bool isNew = false;
         if (mergedState)
         {
@@ -168,23 +181,26 @@ namespace fastbotx {
     }
 
     void AbstractAgent::switchMode() {
-        // update code coverage every step
-        double currentCodeCoverage = getCodeCoverage();
-        callJavaLogger(MAIN_THREAD, "[Check] currentCodeCoverage: %f", currentCodeCoverage);
-        
         if (_currentMode == Mode::EXPLORE) {
-            // update threshold
-            auto res = _codeCoverageMonitor.update(currentCodeCoverage);
-            _currentThreshold = res.second;
-            _growthRateWindow.push_back(res.first);
-            if (_growthRateWindow.size() > _rateCapacity) {
-                _growthRateWindow.erase(_growthRateWindow.begin());
+            // update threshold with each new coverage sample, the sampler thread takes them
+            CoverageSample sample = _coverageSampler.latest();
+            if (sample.sequence != _lastCoverageSequence) {
+                _lastCoverageSequence = sample.sequence;
+                callJavaLogger(MAIN_THREAD, "[Check] currentCodeCoverage: %f, sampled %.0fms ago",
+                               sample.coverage, currentStamp() - sample.timestamp);
+                auto res = _codeCoverageMonitor.update(sample.coverage);
+                _currentThreshold = res.second;
             }
 
-            callJavaLogger(MAIN_THREAD, "[Check] CV window size: %d, current threshold: %f", _growthRateWindow.size(), _currentThreshold);
+            callJavaLogger(MAIN_THREAD, "[Check] CV window size: %d, current threshold: %f",
+                           (int) _codeCoverageMonitor.windowCount(), _currentThreshold);
 
             checkShouldWait();
-            if (_shouldWait) {
+            if (_shouldWait && !_gptAgent.available()) {
+                // the llm keeps failing, explore like plain Fastbot until it is probed again
+                callJavaLogger(MAIN_THREAD, "[Check] LLM backend unavailable, keep exploring");
+            }
+            else if (_shouldWait) {
                 prepareForNavigation();
                 return;
             }
@@ -214,18 +230,10 @@ namespace fastbotx {
     void AbstractAgent::checkShouldWait()
     {
         bool lowGrowthRate = false;
-        if (_growthRateWindow.size() == _rateCapacity) {
-            callJavaLogger(MAIN_THREAD, "[Check] checking...");
-            bool pass = false;
-            for (double d: _growthRateWindow) {
-                if (d > _currentThreshold) {
-                    pass = true;
-                }
-            }
-            if (!pass) {
-                lowGrowthRate = true;
-                callJavaLogger(MAIN_THREAD, "[Check] Low growth rate detected!!!");
-            }
+        if (_codeCoverageMonitor.isStagnant()) {
+            lowGrowthRate = true;
+            callJavaLogger(MAIN_THREAD, "[Check] Low growth rate detected by %s!!!",
+                           CodeCoverageMonitor::detectorName(_codeCoverageMonitor.getDetector()));
         }
 
         if (_useCodeCoverage) {
@@ -304,13 +312,17 @@ namespace fastbotx {
 
     void AbstractAgent::GPTFunctionAnalysis(QuestionPayload payload)
     {
-        _gptAgent.pushStateToQueue(payload);
+        _gptAgent.pushStateToQueue(std::move(payload));
         return;
     }
 
     void AbstractAgent::prepareForNavigation() {
         _currentMode = Mode::NAVIGATE;
-        _gptAgent.waitUntilQueueEmpty();
+        {
+            TRACE_SCOPE("wait.queueEmpty");
+            LLMMainWait llmWait;
+            _gptAgent.waitUntilQueueEmpty();
+        }
         debugMergedStates();
 
         _guideTime++;
@@ -320,7 +332,18 @@ namespace fastbotx {
         resetFuture();
         GPTFunctionAnalysis({AskModel::GUIDE, nullptr, {}, 0, nullptr, false});
 
-        _guideTarget = _futureInt.get();
+        {
+            TRACE_SCOPE("wait.guideTarget");
+            LLMMainWait llmWait;
+            if (_futureInt.wait_for(_gptAgent.answerWait(AskModel::GUIDE)) == std::future_status::ready ||
+                !_gptAgent.abandonAnswer(AskModel::GUIDE)) {
+                _guideTarget = _futureInt.get();
+            }
+            else {
+                callJavaLogger(MAIN_THREAD, "[MAIN] no guide from LLM in time, choose the target locally");
+                _guideTarget = _gptAgent.localGuide();
+            }
+        }
         callJavaLogger(MAIN_THREAD, "[MAIN] get guide target state: %d", _guideTarget);
         //find path
         _paths = _graph->findPath(_guideTarget, true);
@@ -349,7 +372,7 @@ namespace fastbotx {
             _currentPath = _paths[0];
             _paths.erase(_paths.begin());
         }
-        else if (_guideTime < 3) {
+        else if (_guideTime < 3 && _gptAgent.available()) {
             // callJavaLogger(MAIN_THREAD, "[MAIN] try to guide again");
             _gptAgent.addTestedFunction();
             // TODO update function in mergedState
@@ -487,7 +510,7 @@ namespace fastbotx {
         // 'checkShouldWait' related
         _nextStageTime = _runTime + currentStamp();
         _lastGraphOverviewTime = currentStamp();
-        _growthRateWindow.clear();
+        _codeCoverageMonitor.resetDetector();
         _shouldWait = false;
 
         // consider the function is tested whether succeed or not
@@ -536,39 +559,46 @@ namespace fastbotx {
     }
 
     void AbstractAgent::adjustActions() {
-        double totalPriority = 0;           
+        // a priority only changes when its action is visited or retargeted, or when the state
+        // details are refilled, so after the first pass only the dirty actions are recomputed
+        // and the state total is updated by their difference
+        bool adjustAll = !_newState->hasActionPriorities();
+        int totalPriority = adjustAll ? 0 : _newState->getPriority();
         for (const ActivityStateActionPtr &action: _newState->getActions()) {
+            if (!adjustAll && !action->isPriorityDirty()) {
+                continue;
+            }
             // click has priority of 4, other priority is 2, why?
             int basePriority = action->getPriorityByActionType();
-            action->setPriority(basePriority);
             if (!action->requireTarget()) {
-                if (!action->isVisited()) {
-                    int priority = action->getPriority();
-                    priority += 5;
-                    action->setPriority(priority);
-                }
+                action->setPriority(action->isVisited() ? basePriority : basePriority + 5);
                 continue;
             }
+            if (!adjustAll) {
+                // remove what this action added to the total last time
+                totalPriority -= action->getPriority() - basePriority;
+            }
             if (!action->isValid()) {
+                action->setPriority(basePriority);
                 continue;
             }
-            int priority = action->getPriority();
+            int priority = basePriority;
             if (!action->isVisited()) {
-                priority += 20;         
+                priority += 20;
             }
-            if (!this->_newState->isSaturated(action))          
-            {
-                priority += 5 * action->getPriorityByActionType();
+            if (!this->_newState->isSaturated(action)) {
+                priority += 5 * basePriority;
             }
 
             if (priority <= 0) {
                 priority = 0;
             }
 
-            action->setPriority(priority);          
-            totalPriority += (priority - action->getPriorityByActionType());
+            action->setPriority(priority);
+            totalPriority += (priority - basePriority);
         }
-        _newState->setPriority((int) totalPriority);
+        _newState->setPriority(totalPriority);
+        _newState->setHasActionPriorities(true);
     }
 
     ActionPtr AbstractAgent::resolveNewAction() {
@@ -604,6 +634,9 @@ namespace fastbotx {
                 callJavaLogger(MAIN_THREAD, "About to execute event chosen by llm");
                 return _mNewAction;
             }
+            else if (_actionLate) {
+                callJavaLogger(MAIN_THREAD, "no event from llm in time, fastbot chooses this step");
+            }
             else {
                 callJavaLogger(MAIN_THREAD, "event by llm is None, back to EXPLORE mode");
                 prepareBackToExplore();
@@ -618,7 +651,8 @@ namespace fastbotx {
     }
 
     ActivityStateActionPtr AbstractAgent::handleNullAction() const {
-        ActivityStateActionPtr action = this->_newState->randomPickAction(this->_validateFilter);
+        ActivityStateActionPtr action = this->_newState->randomPickAction(this->_validateFilter,
+                                                                           this->_random);
         if (nullptr != action) {
             ActivityStateActionPtr resolved = this->_newState->resolveAt(action,
                                                                          this->_model.lock()->getGraph()->getTimestamp());
@@ -657,14 +691,33 @@ namespace fastbotx {
 
     void AbstractAgent::prepareTestFunction()
     {
-        if (_executedSteps < 5) {
+        _actionLate = false;
+        if (!_gptAgent.available()) {
+            _actionByGPT = nullptr;
+            callJavaLogger(MAIN_THREAD, "LLM backend unavailable, quit TEST FUNCTION!");
+        }
+        else if (_gptAgent.takeFunctionDone()) {
+            _actionByGPT = nullptr;
+            callJavaLogger(MAIN_THREAD, "LLM answered late that the function is done, quit TEST FUNCTION!");
+        }
+        else if (_executedSteps < 5) {
             _executedSteps++;
 
             resetFuture();
             ReuseStatePtr state = std::dynamic_pointer_cast<ReuseState>(_newState);          
             GPTFunctionAnalysis({AskModel::TEST_FUNCTION, nullptr, {}, 0, state, false});
 
-            _actionByGPT = _futureAction.get();           
+            TRACE_SCOPE("wait.testAction");
+            LLMMainWait llmWait;
+            if (_futureAction.wait_for(_gptAgent.answerWait(AskModel::TEST_FUNCTION)) == std::future_status::ready ||
+                !_gptAgent.abandonAnswer(AskModel::TEST_FUNCTION)) {
+                _actionByGPT = _futureAction.get();
+            }
+            else {
+                // fastbot takes this step, the test goes on with the LLM at the next one
+                _actionByGPT = nullptr;
+                _actionLate = true;
+            }
         }
         else {
             _actionByGPT = nullptr;
@@ -682,11 +735,6 @@ namespace fastbotx {
         _gptAgent.resetPromise(promInt, promAction);
     }
 
-    double AbstractAgent::getCodeCoverage() {
-        jdouble rate = jnienv->CallStaticDoubleMethod(codeCoverageClass, getCoverageMethod);
-        return rate;
-    }
-
 }
 
 #endif          
@@ -18,6 +18,7 @@
 #include "GPTAgent.h"
 #include "MergedState.h"
 #include "CodeCoverageMonitor.h"
+#include "CoverageSampler.h"
 
 namespace fastbotx {
 
@@ -69,6 +70,12 @@ namespace fastbotx {
 
         virtual AlgorithmType getAlgorithmType() { return this->_algorithmType; }
 
+        /// Restart the random choices of this agent, the same seed replays the same choices
+        void seedRandom(uint64_t seed) { this->_random.seed(seed); }
+
+        /// How a stall of code coverage growth is detected
+        void setStagnationDetector(StagnationDetector detector) { this->_codeCoverageMonitor.setDetector(detector); }
+
     protected:
 
         //AbstractAgent();
@@ -110,19 +117,14 @@ namespace fastbotx {
 
         void resetFuture();
 
-        /**
-         * @brief Call method in java to get code coverage's growth rate
-         * @note must call from main thread
-         * @return
-         */
-        double getCodeCoverage();
-
         const size_t _rateCapacity = 80;
         const double _minGrowthRate = 0.05;
-        std::vector<double> _growthRateWindow;
         double _currentThreshold = 0.05;
         bool _useCodeCoverage = false;
         CodeCoverageMonitor _codeCoverageMonitor;
+        // samples coverage off the step path, only running when _useCodeCoverage
+        CoverageSampler _coverageSampler;
+        uint64_t _lastCoverageSequence = 0;
 
         GraphPtr _graph;
         MergedStateGraphPtr _mergedStateGraph; //= std::make_shared<MergedStateGraph>();
@@ -144,6 +146,7 @@ namespace fastbotx {
         bool _guideMode = false;
         bool _functionTestMode = false;
         ActivityStateActionPtr _actionByGPT = nullptr;
+        bool _actionLate = false; // the LLM missed the wait for this step's action
         int _executedSteps = 0;
 
         const float _maxSimilarity = 0.6;
@@ -190,6 +193,9 @@ namespace fastbotx {
         int _currentStateBlockTimes;
 
         AlgorithmType _algorithmType;
+
+        // every random choice of the agent, seeded by Model::addAgent
+        mutable FastRandom _random;
     };
 
 
@@ -1,48 +1,167 @@
 #include "CodeCoverageMonitor.h"
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <fstream>
 #include "Base.h"
 
-CodeCoverageMonitor::CodeCoverageMonitor(int windowSize, double minGrowthRate, double adjustmentFactor):
-    windowSize(windowSize), minGrowthRate(minGrowthRate), adjustmentFactor(adjustmentFactor)
+// CUSUM and EWMA start judging after this share of a window of growth rates
+static const int DetectorWarmupDivisor = 4;
+
+CodeCoverageMonitor::CodeCoverageMonitor(int windowSize, double minGrowthRate, double adjustmentFactor,
+                                         StagnationDetector detector):
+    windowSize(std::max(windowSize, 1)), minGrowthRate(minGrowthRate), adjustmentFactor(adjustmentFactor),
+    _detector(detector)
 {
     _adjustedThreshold = minGrowthRate;
+    _threshold = minGrowthRate;
 }
 
 std::pair<double, double> CodeCoverageMonitor::update(double currentCoverage) {
-    coverageHistory.push_back(currentCoverage);
-    int n = coverageHistory.size();
+    _samples++;
     double currentGrowthRate = 0.0;
-    if (n >= 2) {
-        // gn = (xn - xn-1) / xn-1
-        currentGrowthRate = (currentCoverage - coverageHistory[n - 2]) / coverageHistory[n - 2];
+    if (_samples >= 2) {
+        // gn = (xn - xn-1) / xn-1, growth from nothing counts as doubling
+        if (_lastCoverage > 0.0)
+            currentGrowthRate = (currentCoverage - _lastCoverage) / _lastCoverage;
+        else
+            currentGrowthRate = currentCoverage > 0.0 ? 1.0 : 0.0;
         // g1 + g2 + ... + gn
         _growthRateSum += currentGrowthRate;
-        fastbotx::callJavaLogger(MAIN_THREAD, "[CV_Monitor] growth rate: %f, growthRateSum: %f", currentGrowthRate, _growthRateSum);
+        if (_logging)
+            fastbotx::callJavaLogger(MAIN_THREAD, "[CV_Monitor] growth rate: %f, growthRateSum: %f", currentGrowthRate, _growthRateSum);
     }
+    _lastCoverage = currentCoverage;
 
-    if (n >= windowSize) {
+    _threshold = minGrowthRate;
+    if (_samples >= static_cast<uint64_t>(windowSize)) {
         // G
-        double dynamicBaselineGrowthRate = _growthRateSum / (n - 1);
+        double dynamicBaselineGrowthRate = _growthRateSum / static_cast<double>(_samples - 1);
         // delta_g = gn - G
         double growthRateDifference = currentGrowthRate - dynamicBaselineGrowthRate;
-        fastbotx::callJavaLogger(MAIN_THREAD, "[CV_Monitor] Dynamic Baseline: %f, delta_g: %f", dynamicBaselineGrowthRate, growthRateDifference);
+        if (_logging)
+            fastbotx::callJavaLogger(MAIN_THREAD, "[CV_Monitor] Dynamic Baseline: %f, delta_g: %f", dynamicBaselineGrowthRate, growthRateDifference);
 
         // Tn = T0 * exp(k * delta_g)
         double adjustedThreshold = _adjustedThreshold * std::exp(adjustmentFactor * growthRateDifference);
         _adjustedThreshold = adjustedThreshold > _minThreshold ?  adjustedThreshold : _minThreshold;
-        return std::make_pair(currentGrowthRate, _adjustedThreshold);
+        _threshold = _adjustedThreshold;
+    }
+
+    pushGrowthRate(currentGrowthRate);
+    if (_samples >= 2) {
+        // the first sample has no growth rate, only the window counts it as 0
+        double alpha = 2.0 / (windowSize + 1);
+        _ewma = _detectorSamples == 0 ? currentGrowthRate : alpha * currentGrowthRate + (1 - alpha) * _ewma;
+        // slack of half the threshold: growth above it drains the sum, flat coverage fills it
+        _cusum = std::max(0.0, _cusum + _threshold / 2 - currentGrowthRate);
+        _detectorSamples++;
     }
+    return std::make_pair(currentGrowthRate, _threshold);
+}
 
-    return std::make_pair(currentGrowthRate, minGrowthRate);;
+void CodeCoverageMonitor::pushGrowthRate(double growthRate) {
+    auto capacity = static_cast<size_t>(windowSize);
+    uint64_t pushed = _windowPushed++;
+    if (_windowCount < capacity)
+        _windowCount++;
+    // running max: drop the rates that left the window and those the new one dominates
+    while (!_windowMax.empty() && _windowMax.front().first + capacity <= pushed)
+        _windowMax.pop_front();
+    while (!_windowMax.empty() && _windowMax.back().second <= growthRate)
+        _windowMax.pop_back();
+    _windowMax.emplace_back(pushed, growthRate);
 }
 
-double CodeCoverageMonitor::calculateDynamicBaselineGrowthRate() {
-    int n = coverageHistory.size();
-    double sumGrowthRates = 0.0;
-    for (int i = 1; i < n; i++) {
-        double growthRate = (coverageHistory[i] - coverageHistory[i - 1]) / coverageHistory[i - 1];
-        sumGrowthRates += growthRate;
+bool CodeCoverageMonitor::isStagnant() const {
+    int warmup = std::max(2, windowSize / DetectorWarmupDivisor);
+    switch (_detector) {
+        case StagnationDetector::WINDOW_MAX:
+            return _windowCount == static_cast<size_t>(windowSize) && !_windowMax.empty() &&
+                   _windowMax.front().second <= _threshold;
+        case StagnationDetector::EWMA:
+            return _detectorSamples >= static_cast<uint64_t>(warmup) && _ewma <= _threshold;
+        case StagnationDetector::CUSUM:
+            // as much shortfall as warmup samples with no growth at all
+            return _detectorSamples >= static_cast<uint64_t>(warmup) &&
+                   _cusum >= warmup * _threshold / 2;
     }
+    return false;
+}
 
-    return sumGrowthRates / (n - 1);
+void CodeCoverageMonitor::resetDetector() {
+    _windowCount = 0;
+    _windowPushed = 0;
+    _windowMax.clear();
+    _ewma = 0.0;
+    _cusum = 0.0;
+    _detectorSamples = 0;
+}
+
+void CodeCoverageMonitor::setDetector(StagnationDetector detector) {
+    _detector = detector;
+}
+
+const char *CodeCoverageMonitor::detectorName(StagnationDetector detector) {
+    switch (detector) {
+        case StagnationDetector::WINDOW_MAX:
+            return "window";
+        case StagnationDetector::EWMA:
+            return "ewma";
+        case StagnationDetector::CUSUM:
+            return "cusum";
+    }
+    return "";
+}
+
+bool CodeCoverageMonitor::detectorFromName(const std::string &name, StagnationDetector &detector) {
+    for (StagnationDetector candidate: {StagnationDetector::WINDOW_MAX, StagnationDetector::EWMA,
+                                        StagnationDetector::CUSUM}) {
+        if (name == detectorName(candidate)) {
+            detector = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+int CodeCoverageMonitor::replay(const std::vector<double> &coverages, StagnationDetector detector,
+                                int windowSize, double minGrowthRate, double adjustmentFactor) {
+    CodeCoverageMonitor monitor(windowSize, minGrowthRate, adjustmentFactor, detector);
+    monitor._logging = false;
+    for (size_t i = 0; i < coverages.size(); i++) {
+        monitor.update(coverages[i]);
+        if (monitor.isStagnant())
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void CodeCoverageMonitor::replayFile(const std::string &path, int windowSize, double minGrowthRate,
+                                     double adjustmentFactor) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        fastbotx::callJavaLogger(MAIN_THREAD, "[CV_Monitor] can't open coverage curve %s", path.c_str());
+        return;
+    }
+    static const std::string logPrefix = "currentCodeCoverage:";
+    std::vector<double> coverages;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t start = line.find(logPrefix);
+        start = start == std::string::npos ? 0 : start + logPrefix.size();
+        const char *begin = line.c_str() + start;
+        char *end = nullptr;
+        double coverage = std::strtod(begin, &end);
+        if (end != begin)
+            coverages.push_back(coverage);
+    }
+    fastbotx::callJavaLogger(MAIN_THREAD, "[CV_Monitor] replaying %d coverage samples of %s",
+                             static_cast<int>(coverages.size()), path.c_str());
+    for (StagnationDetector detector: {StagnationDetector::WINDOW_MAX, StagnationDetector::EWMA,
+                                       StagnationDetector::CUSUM}) {
+        int triggered = replay(coverages, detector, windowSize, minGrowthRate, adjustmentFactor);
+        fastbotx::callJavaLogger(MAIN_THREAD, "[CV_Monitor] replay detector %s triggers at sample %d",
+                                 detectorName(detector), triggered);
+    }
 }
@@ -1,11 +1,28 @@
 #ifndef CODE_COVERAGE_MONITOR_H
 #define CODE_COVERAGE_MONITOR_H
 
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
 #include <vector>
 
+/**
+ * How CodeCoverageMonitor decides exploration has stalled, each costs O(1) per sample
+ */
+enum class StagnationDetector {
+    // no growth rate above the threshold in the last windowSize samples
+    WINDOW_MAX,
+    // the exponentially weighted average of the growth rate falls to the threshold
+    EWMA,
+    // the shortfall of growth under the threshold, accumulated CUSUM style, passes a limit
+    CUSUM
+};
+
 class CodeCoverageMonitor {
 public:
-    CodeCoverageMonitor(int windowSize = 80, double minGrowthRate = 0.05, double adjustmentFactor = 1.0);
+    CodeCoverageMonitor(int windowSize = 80, double minGrowthRate = 0.05, double adjustmentFactor = 1.0,
+                        StagnationDetector detector = StagnationDetector::WINDOW_MAX);
 
     /**
      * adjust threshold based on cv history
@@ -16,17 +33,68 @@ public:
      */
     std::pair<double, double> update(double currentCoverage);
 
-//    void setWindowSize(int wsize) { this->windowSize = wsize; }
+    /// Whether the detector considers exploration stalled, against the current threshold
+    bool isStagnant() const;
+
+    /// Forget the window and the detector state, the growth baseline and threshold are kept
+    void resetDetector();
+
+    /// number of growth rates in the window, at most windowSize
+    size_t windowCount() const { return _windowCount; }
+
+    StagnationDetector getDetector() const { return _detector; }
+
+    void setDetector(StagnationDetector detector);
+
+    static const char *detectorName(StagnationDetector detector);
+
+    /// \param name window, ewma or cusum
+    /// \return false, leaving detector as is, for other names
+    static bool detectorFromName(const std::string &name, StagnationDetector &detector);
+
+    /**
+     * Feed a recorded coverage curve to a fresh monitor
+     * @return index of the sample at which the detector first reports a stall, -1 if never
+     */
+    static int replay(const std::vector<double> &coverages, StagnationDetector detector,
+                      int windowSize = 80, double minGrowthRate = 0.05, double adjustmentFactor = 1.0);
+
+    /**
+     * Replay a recorded curve with every detector and log when each one triggers
+     * @param path one coverage per line, either the bare value or a "[Check] currentCodeCoverage:"
+     * line of the fastbot log
+     */
+    static void replayFile(const std::string &path, int windowSize = 80, double minGrowthRate = 0.05,
+                           double adjustmentFactor = 1.0);
 
 private:
-    std::vector<double> coverageHistory;
+    void pushGrowthRate(double growthRate);
+
     const int windowSize;
     const double minGrowthRate;
     const double adjustmentFactor;
     const double _minThreshold = 0.01;
     double _adjustedThreshold;
     double _growthRateSum = 0.0;
-    double calculateDynamicBaselineGrowthRate();
+    // threshold returned by the last update
+    double _threshold;
+    StagnationDetector _detector;
+    // replays keep quiet
+    bool _logging = true;
+
+    uint64_t _samples = 0;
+    double _lastCoverage = 0.0;
+
+    // the window holds the last windowSize growth rates, only their running max is kept:
+    // (push number, growth rate) with decreasing rates, so the front is the window's max
+    size_t _windowCount = 0;
+    uint64_t _windowPushed = 0;
+    std::deque<std::pair<uint64_t, double>> _windowMax;
+
+    // real growth rates seen by EWMA and CUSUM since the last reset
+    uint64_t _detectorSamples = 0;
+    double _ewma = 0.0;
+    double _cusum = 0.0;
 };
 
-#endif // CODE_COVERAGE_MONITOR_H
\ No newline at end of file
+#endif // CODE_COVERAGE_MONITOR_H
@@ -0,0 +1,127 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef CoverageSampler_CPP_
+#define CoverageSampler_CPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "CoverageSampler.h"
+#include "Base.h"
+#include "../Tracer.h"
+
+namespace fastbotx {
+
+    // coverage moving less than this between two samples counts as flat
+    static const double FlatCoverageDelta = 1e-6;
+
+    static uint64_t toBits(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static double fromBits(uint64_t bits) {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    CoverageSampler::CoverageSampler(int minInterval, int maxInterval)
+            : _minInterval(std::max(minInterval, 1)),
+              _maxInterval(std::max(maxInterval, std::max(minInterval, 1))) {
+    }
+
+    CoverageSampler::~CoverageSampler() {
+        stop();
+    }
+
+    void CoverageSampler::start() {
+        if (this->_thread.joinable() || !jvm || !codeCoverageClass || !getCoverageMethod)
+            return;
+        this->_stopped.store(false);
+        this->_thread = std::thread(&CoverageSampler::run, this);
+    }
+
+    void CoverageSampler::stop() {
+        {
+            std::lock_guard<std::mutex> lock(this->_wakeMutex);
+            this->_stopped.store(true);
+        }
+        this->_wake.notify_all();
+        if (this->_thread.joinable())
+            this->_thread.join();
+    }
+
+    void CoverageSampler::publish(double coverage, double timestamp) {
+        // only the sampler thread writes
+        uint64_t version = this->_version.load(std::memory_order_relaxed);
+        this->_version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        this->_coverageBits.store(toBits(coverage), std::memory_order_relaxed);
+        this->_timestampBits.store(toBits(timestamp), std::memory_order_relaxed);
+        this->_version.store(version + 2, std::memory_order_release);
+    }
+
+    CoverageSample CoverageSampler::latest() const {
+        CoverageSample sample;
+        while (true) {
+            uint64_t before = this->_version.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            uint64_t coverage = this->_coverageBits.load(std::memory_order_relaxed);
+            uint64_t timestamp = this->_timestampBits.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (this->_version.load(std::memory_order_relaxed) != before)
+                continue;
+            sample.sequence = before / 2;
+            if (sample.sequence > 0) {
+                sample.coverage = fromBits(coverage);
+                sample.timestamp = fromBits(timestamp);
+            }
+            return sample;
+        }
+    }
+
+    void CoverageSampler::run() {
+        JNIEnv *env = nullptr;
+        if (jvm->AttachCurrentThreadAsDaemon(&env, nullptr) != JNI_OK || !env) {
+            callJavaLogger(CHILD_THREAD, "[CoverageSampler] can't attach to jvm, no coverage");
+            return;
+        }
+        int interval = this->_minInterval;
+        bool sampled = false;
+        double lastCoverage = 0.0;
+        Tracer::inst().nameThread("coverage");
+        while (!this->_stopped.load()) {
+            jdouble coverage;
+            {
+                TRACE_SCOPE("coverage.sample");
+                coverage = env->CallStaticDoubleMethod(codeCoverageClass, getCoverageMethod);
+            }
+            if (env->ExceptionCheck()) {
+                env->ExceptionClear();
+                callJavaLogger(CHILD_THREAD, "[CoverageSampler] getCoverage threw");
+            } else {
+                publish(coverage, currentStamp());
+                // sample faster while coverage moves, back off while it is flat
+                if (sampled && std::fabs(coverage - lastCoverage) <= FlatCoverageDelta)
+                    interval = std::min(this->_maxInterval, interval + interval / 2);
+                else
+                    interval = std::max(this->_minInterval, interval / 2);
+                lastCoverage = coverage;
+                sampled = true;
+            }
+            std::unique_lock<std::mutex> lock(this->_wakeMutex);
+            this->_wake.wait_for(lock, std::chrono::milliseconds(interval),
+                                 [this] { return this->_stopped.load(); });
+        }
+        jvm->DetachCurrentThread();
+    }
+
+}
+
+#endif //CoverageSampler_CPP_
@@ -0,0 +1,65 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef CoverageSampler_H_
+#define CoverageSampler_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace fastbotx {
+
+    struct CoverageSample {
+        double coverage = 0.0;
+        /// currentStamp() when the sample was taken, in ms
+        double timestamp = 0.0;
+        /// number of samples taken so far, 0 when there is none yet
+        uint64_t sequence = 0;
+    };
+
+    /**
+     * @brief Samples CodeCoverage.getCoverage on its own thread, so the JaCoCo dump is off the
+     * step's critical path. The cadence adapts: it speeds up while coverage changes and backs
+     * off while it stays flat. The latest sample is published as a lock-free snapshot.
+     */
+    class CoverageSampler {
+    public:
+        /// \param minInterval shortest time between two samples, in ms
+        /// \param maxInterval longest time between two samples, in ms
+        explicit CoverageSampler(int minInterval = 200, int maxInterval = 4000);
+
+        ~CoverageSampler();
+
+        /// Start sampling, does nothing if already started or if CodeCoverage was not found
+        void start();
+
+        void stop();
+
+        /// The latest sample, its sequence tells whether it is newer than one read before
+        CoverageSample latest() const;
+
+    private:
+        void run();
+
+        void publish(double coverage, double timestamp);
+
+        const int _minInterval;
+        const int _maxInterval;
+
+        // seqlock: odd while the sampler thread writes the two fields below
+        std::atomic<uint64_t> _version{0};
+        std::atomic<uint64_t> _coverageBits{0};
+        std::atomic<uint64_t> _timestampBits{0};
+
+        std::atomic<bool> _stopped{false};
+        std::mutex _wakeMutex;
+        std::condition_variable _wake;
+        std::thread _thread;
+    };
+
+}
+
+#endif //CoverageSampler_H_
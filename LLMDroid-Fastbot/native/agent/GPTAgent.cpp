@@ -5,10 +5,14 @@
 #include <algorithm>
 #include "../thirdpart/json/json.hpp"
 #include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <stdexcept>
 #include <unordered_map>
 #include <utility>
 #include <iomanip>
+#include "../Tracer.h"
+#include "LLMMetrics.h"
 
 using json = nlohmann::json;
 
@@ -16,8 +20,7 @@ namespace fastbotx {
 
     GPTAgent::GPTAgent(MergedStateGraphPtr& graph, PromiseIntPtr prom):
     _file("/sdcard/gpt.txt", std::ios::out | std::ios::trunc),
-    _interactionFile("/sdcard/LLM-Interaction-Fastbot.txt", std::ios::out | std::ios::trunc),
-    _questionRemained(0)
+    _interactionFile("/sdcard/LLM-Interaction-Fastbot.txt", std::ios::out | std::ios::trunc)
     {
         _mergedStateGraph = graph;
         _promiseInt = std::move(prom);
@@ -34,16 +37,34 @@ namespace fastbotx {
         file.close();
         // Read field value
         try {
+            if (config.contains("Backend")) {
+                _replay.configure(config["Backend"]);
+            }
+            if (config.contains("Metrics")) {
+                LLMMetrics::inst().configure(config["Metrics"]);
+            }
+            if (config.contains("Resilience")) {
+                _resilience.configure(config["Resilience"]);
+            }
+            if (config.contains("Scheduler")) {
+                _scheduler.configure(config["Scheduler"]);
+            }
             std::string appName = config["AppName"];
             std::string description = config["Description"];
-            std::string apiKey = config["ApiKey"];
+            // a replayed run asks nobody
+            std::string apiKey = _replay.replaying() ? config.value("ApiKey", std::string())
+                                                     : config["ApiKey"].get<std::string>();
             if (config.contains("Model")) {
                 _model_str = config["Model"];
                 callJavaLogger(MAIN_THREAD, "Set model_str to %s", _model_str.c_str());
             }
+            if (config.contains("DescriptionFormat")) {
+                loadDescriptionFormat(config["DescriptionFormat"]);
+            }
+            std::string baseUrl;
             if (config.contains("BaseUrl")) {
-                _gpt.ChatCompletion->set_base_url(config["BaseUrl"]);
-                callJavaLogger(MAIN_THREAD, "Set base_url to %s", config["BaseUrl"].get<std::string>().c_str());
+                baseUrl = config["BaseUrl"];
+                callJavaLogger(MAIN_THREAD, "Set base_url to %s", baseUrl.c_str());
             }
             if (!appName.empty() && !description.empty()) {
                 _startPrompt = "I'm now testing an app called " + appName + " on Android.\n" + description + "\n";
@@ -54,6 +75,22 @@ namespace fastbotx {
                 callJavaLogger(MAIN_THREAD, "The value of `AppName` and `Description` are missing in json");
                 exit(0);
             }
+            // Model, BaseUrl and ApiKey are the only backend unless "Routing" lists others
+            _router.configure(config.contains("Routing") ? config["Routing"] : json::object(),
+                              {"default", _model_str, baseUrl, _apiKey});
+            for (const LLMBackend& backend : _router.backends()) {
+                auto chat = std::make_unique<liboai::ChatCompletion>();
+                if (!backend.baseUrl.empty()) {
+                    chat->set_base_url(backend.baseUrl);
+                }
+                _chats.push_back(std::move(chat));
+            }
+            if (config.contains("Hedging")) {
+                _hedger.configure(config["Hedging"], _router);
+            }
+            if (config.contains("RateLimit")) {
+                _limiter.configure(config["RateLimit"], _router.backends().size());
+            }
         }
         catch (const std::exception& e) {
             callJavaLogger(CHILD_THREAD, "[Exception]: %s", e.what());
@@ -63,8 +100,61 @@ namespace fastbotx {
         init();
     }
 
+    const char *askModelName(AskModel type)
+    {
+        switch (type) {
+            case AskModel::STATE_OVERVIEW: return "STATE_OVERVIEW";
+            case AskModel::GRAPH_OVERVIEW: return "GRAPH_OVERVIEW";
+            case AskModel::GUIDE: return "GUIDE";
+            case AskModel::TEST_FUNCTION: return "TEST_FUNCTION";
+            case AskModel::GUIDE_FAILURE: return "GUIDE_FAILURE";
+            case AskModel::REANALYSIS: return "REANALYSIS";
+        }
+        return "UNKNOWN";
+    }
+
+    bool askModelFromName(const std::string& name, AskModel& type)
+    {
+        const AskModel types[] = {AskModel::STATE_OVERVIEW, AskModel::GRAPH_OVERVIEW, AskModel::GUIDE,
+                                  AskModel::TEST_FUNCTION, AskModel::GUIDE_FAILURE, AskModel::REANALYSIS};
+        for (AskModel candidate : types) {
+            if (name == askModelName(candidate)) {
+                type = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void GPTAgent::loadDescriptionFormat(const json& config)
+    {
+        const AskModel types[] = {AskModel::STATE_OVERVIEW, AskModel::GRAPH_OVERVIEW, AskModel::GUIDE,
+                                  AskModel::TEST_FUNCTION, AskModel::GUIDE_FAILURE, AskModel::REANALYSIS};
+        for (AskModel type : types) {
+            std::string format;
+            if (config.is_string()) {
+                format = config.get<std::string>();
+            }
+            else if (config.is_object() && config.contains(askModelName(type))) {
+                format = config[askModelName(type)].get<std::string>();
+            }
+            if (format.empty()) {
+                continue;
+            }
+            _descriptionFormat[type] = (format == "compact") ? DescriptionFormat::COMPACT : DescriptionFormat::HTML;
+            callJavaLogger(MAIN_THREAD, "Set description format of %s to %s", askModelName(type), format.c_str());
+        }
+    }
+
+    DescriptionFormat GPTAgent::descriptionFormatFor(AskModel type) const
+    {
+        auto found = _descriptionFormat.find(type);
+        return found != _descriptionFormat.end() ? found->second : DescriptionFormat::HTML;
+    }
+
     GPTAgent::~GPTAgent()
     {
+        joinRequests();
         if (_file.is_open()) {
             _file.close();
         }
@@ -76,7 +166,7 @@ namespace fastbotx {
 
     bool GPTAgent::init()
     {
-        _gpt.auth.SetMaxTimeout(300000);
+        _auth.SetMaxTimeout(300000);
         callJavaLogger(MAIN_THREAD, "Start child thread!!!");
         std::thread child(&GPTAgent::pageAnalysisLoop, this);
         child.detach();
@@ -85,123 +175,184 @@ namespace fastbotx {
 
     void GPTAgent::pushStateToQueue(QuestionPayload payload)
     {
-        if (payload.type == AskModel::REANALYSIS) {
-            // need to protect _topValuedMergedState
-            std::unique_lock<std::mutex> lock(_mtx); 
-            int targetId = payload.from->getId();
-            auto end = _topValuedMergedState->begin() + std::min(_P2 + 1ul, _topValuedMergedState->size());
-            auto found = std::find_if(_topValuedMergedState->begin(), end,
-                                      [targetId](MergedStatePtr& ms){
-                                          return targetId == ms->getId();
-                                      });
-            if (found != end) {
-                // std::lock_guard<std::mutex> lock(_mtx);
-                std::unique_lock<std::mutex> questionCountLock(_questionMtx);
-                _questionRemained++;
-
-                this->_lowQueue.push(payload);
-                callJavaLogger(MAIN_THREAD, "[MAIN] push M%d to low priority queue, remains: %d", payload.from->getId(), _lowQueue.size());
-                lock.unlock();
-                _cv.notify_one();
-            }
+        // the answer goes to the promise of this question, not to one reset for a later question
+        if (payload.type == AskModel::GUIDE) {
+            std::lock_guard<std::mutex> lock(_answerMtx);
+            payload.promiseInt = _promiseInt;
+            _pendingGuide = _promiseInt;
+        }
+        else if (payload.type == AskModel::TEST_FUNCTION) {
+            std::lock_guard<std::mutex> lock(_answerMtx);
+            payload.promiseAction = _promiseAction;
+            _pendingAction = _promiseAction;
+        }
+        _scheduler.push(std::move(payload));
+    }
+
+    std::chrono::milliseconds GPTAgent::answerWait(AskModel type) const
+    {
+        double wait = type == AskModel::GUIDE ? _resilience.guideWait() : _resilience.actionWait();
+        return std::chrono::milliseconds(static_cast<int64_t>(wait));
+    }
+
+    bool GPTAgent::abandonAnswer(AskModel type)
+    {
+        std::lock_guard<std::mutex> lock(_answerMtx);
+        std::shared_ptr<void> pending;
+        if (type == AskModel::GUIDE) {
+            if (!_pendingGuide) { return false; }
+            pending = std::move(_pendingGuide);
+            _pendingGuide = nullptr;
         }
         else {
-            {
-                std::unique_lock<std::mutex> questionCountLock(_questionMtx);
-                _questionRemained++;
-                // Protect access to queues using mutex locks
-                std::lock_guard<std::mutex> lock(_mtx);
-                this->_stateQueue.push(payload);
-                std::stringstream ss;
-                if (payload.from) { ss << "from: MergedState" << payload.from->getId();}
-                callJavaLogger(MAIN_THREAD, "[MAIN] push {%s} to high priority queue, remains: %d", ss.str().c_str(), _stateQueue.size());
+            if (!_pendingAction) { return false; }
+            pending = std::move(_pendingAction);
+            _pendingAction = nullptr;
+        }
+        LLMMetrics::inst().abandoned(type);
+        // not asked yet, nobody would read the answer
+        _scheduler.withdraw(type, pending);
+        return true;
+    }
+
+    int GPTAgent::localGuide()
+    {
+        std::lock_guard<std::mutex> answerLock(_answerMtx);
+        MergedStatePtr destination = nullptr;
+        std::string function;
+        // a guide the llm gave too late for an earlier navigation
+        if (_lateGuide.first >= 0 && _testedFunctions.count(_lateGuide.second) == 0) {
+            destination = _mergedStateGraph->findMergedStateById(_lateGuide.first);
+            function = _lateGuide.second;
+        }
+        _lateGuide = {-1, ""};
+        if (!destination) {
+            std::lock_guard<std::mutex> lock(_mtx);
+            size_t end = std::min(_P2, _topValuedMergedState->size());
+            for (size_t i = 0; i < end && !destination; i++) {
+                MergedStatePtr ms = (*_topValuedMergedState)[i];
+                for (const std::string& untested : ms->untestedFunctions()) {
+                    if (_testedFunctions.count(untested) == 0) {
+                        destination = ms;
+                        function = untested;
+                        break;
+                    }
+                }
             }
-            _cv.notify_one();
         }
+        if (!destination) {
+            callJavaLogger(MAIN_THREAD, "[MAIN] no untested function to guide to");
+            return -1;
+        }
+        _targetFunction = function;
+        _targetMergedStateId = destination->getId();
+        ReuseStatePtr targetState = destination->getTargetState(function);
+        callJavaLogger(MAIN_THREAD, "[MAIN] guide to function %s of MergedState%d without LLM", function.c_str(), _targetMergedStateId);
+        return targetState ? targetState->getIdi() : -1;
+    }
+
+    bool GPTAgent::takeFunctionDone()
+    {
+        std::lock_guard<std::mutex> lock(_answerMtx);
+        bool done = !_doneFunction.empty() && _doneFunction == _targetFunction;
+        _doneFunction.clear();
+        return done;
     }
 
     void GPTAgent::waitUntilQueueEmpty()
     {
         callJavaLogger(MAIN_THREAD, "[MAIN] wait until queue is empty");
-        int questionRemained = 0;
-        while(true)
-        {
-            std::unique_lock<std::mutex> questionCountLock(_questionMtx);
-            questionRemained = _questionRemained;//_questionRemained.load();
-            questionCountLock.unlock();
+        // as long as for a guide, a question answered too late may still be in the queue
+        if (_scheduler.waitUntilIdle(answerWait(AskModel::GUIDE))) {
+            callJavaLogger(MAIN_THREAD, "[MAIN] question all done");
+        }
+        else {
+            callJavaLogger(MAIN_THREAD, "[MAIN] %zu questions still queued, go on", _scheduler.depth());
+        }
+    }
 
-            if (questionRemained == 0) {
-                callJavaLogger(MAIN_THREAD, "[MAIN] question all done");
-                break;
-            }
-            else {
-                callJavaLogger(MAIN_THREAD, "[MAIN] question remains: %d, sleep 3 seconds", questionRemained);
-                std::this_thread::sleep_for(std::chrono::seconds(3));
-            }
+    bool GPTAgent::isStale(const QuestionPayload& payload)
+    {
+        if (payload.type != AskModel::REANALYSIS || !payload.from) {
+            return false;
         }
-        
+        // only the states worth guiding to are reanalysed, the top list may have changed since queued
+        std::unique_lock<std::mutex> lock(_mtx);
+        int targetId = payload.from->getId();
+        auto end = _topValuedMergedState->begin() + std::min(_P2 + 1ul, _topValuedMergedState->size());
+        return std::find_if(_topValuedMergedState->begin(), end,
+                            [targetId](MergedStatePtr& ms){
+                                return targetId == ms->getId();
+                            }) == end;
     }
 
     void GPTAgent::pageAnalysisLoop()
     {
+        Tracer::inst().nameThread("llm");
+        // the questions the main thread does not wait on stay queued while the rate limit holds them back
+        std::function<double(AskModel)> paced;
+        if (_limiter.enabled()) {
+            // the bucket of the backend the question would be sent to, which may not be the first of its route
+            paced = [this](AskModel type) {
+                double now = currentStamp();
+                return _limiter.wait(_router.peek(type, now), type, now);
+            };
+        }
         while (true)
         {
-            //callJavaLogger(1, "[THREAD] before get lock");
             QuestionPayload payload;
-            {
-                std::unique_lock<std::mutex> lock(_mtx);
-                if (_cv.wait_for(lock, std::chrono::seconds(1), [this]() { return !_stateQueue.empty() || !_lowQueue.empty(); })) {
-                    if (!_stateQueue.empty()) {
-                        payload = _stateQueue.front();
-                        _stateQueue.pop();
-                        callJavaLogger(CHILD_THREAD, "[THREAD]pop one payload from high priority queue, remains: %d", _stateQueue.size());
+            if (!_scheduler.pop(payload, std::chrono::seconds(1), paced)) {
+                continue; // No payload available, retry
+            }
+            if (isStale(payload)) {
+                callJavaLogger(CHILD_THREAD, "[THREAD] MergedState%d left the top list, skip REANALYSIS", payload.from->getId());
+                LLMMetrics::inst().cancelled(payload.type);
+                _scheduler.done();
+                continue;
+            }
+            int64_t questionBegin = Tracer::now();
+            if (Tracer::inst().enabled())
+                Tracer::inst().record("llm.queueWait", payload.enqueuedAt, questionBegin);
+
+            TRACE_SCOPE("llm.question");
+            // an answer that does not fit the question must not end the thread
+            try {
+                switch(payload.type)
+                {
+                    case AskModel::STATE_OVERVIEW:
+                    {
+                        askForStateOverview(payload);
+                        break;
                     }
-                    else if (!_lowQueue.empty()) {
-                        payload = _lowQueue.front();
-                        _lowQueue.pop();
-                        callJavaLogger(CHILD_THREAD, "[THREAD]pop one payload from low priority queue, remains: %d", _lowQueue.size());
+                    case AskModel::GUIDE:
+                    {
+                        askForGuiding(payload);
+                        break;
                     }
-                }
-                else {
-                    continue; // No payload available, retry
-                }
-            } // Lock is automatically released here
-            
-            switch(payload.type)
-            {
-                case AskModel::STATE_OVERVIEW:
-                {
-                    askForStateOverview(payload);
-                    break;
-                }
-                case AskModel::GUIDE:
-                {
-                    askForGuiding(payload);
-                    break;
-                }
-                case AskModel::TEST_FUNCTION:
-                {
-                    askForTestFunction(payload);
-                    break;
-                }
-                case AskModel::REANALYSIS:
-                {
-                    askForReanalysis(payload);
-                    break;
-                }
-                default: {
-                    break;
-                }
-            }// end switch
-
-            //_questionRemained.fetch_sub(1);
-            //std::unique_lock<std::mutex> questionCountLock2(_questionMtx);
-            std::unique_lock<std::mutex> questionCountLock(_questionMtx);
-            _questionRemained--;
-            //questionCountLock2.unlock();
+                    case AskModel::TEST_FUNCTION:
+                    {
+                        askForTestFunction(payload);
+                        break;
+                    }
+                    case AskModel::REANALYSIS:
+                    {
+                        askForReanalysis(payload);
+                        break;
+                    }
+                    default: {
+                        break;
+                    }
+                }// end switch
+            }
+            catch (const std::exception& e) {
+                callJavaLogger(CHILD_THREAD, "[Exception] %s question failed: %s", askModelName(payload.type), e.what());
+            }
+            LLMMetrics::inst().question(payload.type, payload.enqueuedAt, questionBegin, Tracer::now());
+            _scheduler.done();
         }        
     }
 
+
     void GPTAgent::saveToFile(const std::string& prompt, const std::string& response)
     {
         if (_file.is_open()) {
@@ -229,6 +380,21 @@ namespace fastbotx {
     }
 
 
+    /// About four characters of html or english per token, close enough for a budget
+    static size_t roughTokens(const std::string& text)
+    {
+        return text.size() / 4;
+    }
+
+    std::string GPTAgent::overviewDescription(const MergedStatePtr& mergedState, DescriptionFormat format)
+    {
+        std::string stateDesc = mergedState->stateDescription(format);
+        if (stateDesc.length() > 7000) {
+            stateDesc = safe_utf8_substr(stateDesc, 0, 7000);
+        }
+        return stateDesc;
+    }
+
     void GPTAgent::askForStateOverview(QuestionPayload& payload)
     {
         std::unique_lock<std::mutex> lock(_mtx);
@@ -238,44 +404,100 @@ namespace fastbotx {
             callJavaLogger(CHILD_THREAD, "[THREAD] payload.from is null, skip");
             return;
         }
-        callJavaLogger(CHILD_THREAD, "[THREAD] ask for MergedState's overview and funtion list");
 
-        std::stringstream promptstream;
-        promptstream << _startPrompt << _functionExplanationPrompt << _inputExplanationPrompt_state;
+        DescriptionFormat format = descriptionFormatFor(AskModel::STATE_OVERVIEW);
+        // the overviews queued meanwhile are asked in the same question while they fit
+        std::vector<MergedStatePtr> states{payload.from};
+        std::vector<std::string> descriptions{overviewDescription(payload.from, format)};
+        size_t tokens = roughTokens(descriptions.front());
+        while (states.size() < _scheduler.overviewBatch()) {
+            MergedStatePtr next = _scheduler.peek(AskModel::STATE_OVERVIEW);
+            // queued again for a state already in this question, it is asked on its own later
+            if (!next || std::find(states.begin(), states.end(), next) != states.end()) { break; }
+            std::string description = overviewDescription(next, format);
+            if (tokens + roughTokens(description) > _scheduler.overviewTokens()) { break; }
+            QuestionPayload taken;
+            if (!_scheduler.take(AskModel::STATE_OVERVIEW, next->getId(), taken)) { break; }
+            LLMMetrics::inst().batched(AskModel::STATE_OVERVIEW, taken.enqueuedAt, Tracer::now());
+            tokens += roughTokens(description);
+            states.push_back(next);
+            descriptions.push_back(std::move(description));
+        }
+        bool batch = states.size() > 1;
+        callJavaLogger(CHILD_THREAD, "[THREAD] ask for the overview and funtion list of %zu MergedState(s)", states.size());
+
+        // the instructions first and alike for every overview, the pages of this question after them
+        _prompt.clear();
+        PromptText& system = _prompt.system();
+        PromptText& promptstream = _prompt.user();
+        system << _startPrompt << _functionExplanationPrompt << _inputExplanationPrompt_state;
+        if (format == DescriptionFormat::COMPACT) { system << _compactFormatPrompt; }
+        if (batch) { system << _inputExplanationPrompt_stateBatch; }
         // If a new state has been added to the merged state here, it will be asked along with the new one.
-        promptstream << "\n```HTML Description\n";
-        std::string stateDesc = payload.from->stateDescription();
-        if (stateDesc.length() > 7000) {
-            stateDesc = safe_utf8_substr(stateDesc, 0, 7000);
+        for (size_t i = 0; i < states.size(); i++) {
+            promptstream << (format == DescriptionFormat::COMPACT ? "\n```Compact Description" : "\n```HTML Description");
+            if (batch) { promptstream << " of State" << states[i]->getId(); }
+            promptstream << "\n" << descriptions[i] << "```\n";
         }
-        promptstream << stateDesc << "```\n";
 
         if (_topValuedMergedState->size() >= 5) {
             // ask gpt to maintain the M list
-            promptstream << _requiredOutputPrompt_state3;
+            system << _requiredOutputPrompt_state3 << _requiredOutputPrompt_state_summary3
+                   << (batch ? _anwserFormatPrompt_stateBatch3 : _anwserFormatPrompt_state3);
+            promptstream << "Current: ";
+            for (size_t i = 0; i < states.size(); i++) {
+                promptstream << (i > 0 ? ", State" : "State") << states[i]->getId();
+            }
+            promptstream << "\n";
             // M list
-            nlohmann::ordered_json top5;
+            promptstream << "Five other pages:\n{";
             int count = 0;
             for (auto it = _topValuedMergedState->begin(); it < _topValuedMergedState->end() && count < 5; ++it) {
                 // M: overview, top 5 function to json
                 if ((*it)->hasUntestedFunctions()) {
-                    (*it)->writeOverviewAndTop5Tojson(top5);
+                    if (count > 0) { promptstream << ','; }
+                    (*it)->writeOverviewAndTop5(promptstream);
                     count++;
                 }
 
             }
-            promptstream << "Current: State" << payload.from->getId() << "\n";
-            promptstream << "Five other pages:\n" << top5.dump(4) << "\n";
-            promptstream << _requiredOutputPrompt_state_summary3 << _anwserFormatPrompt_state3;
+            promptstream << "}\n";
         }
         else {
-            promptstream << _requiredOutputPrompt_state2 <<  _requiredOutputPrompt_state_summary2 << _anwserFormatPrompt_state2;
+            system << _requiredOutputPrompt_state2 <<  _requiredOutputPrompt_state_summary2
+                   << (batch ? _anwserFormatPrompt_stateBatch2 : _anwserFormatPrompt_state2);
         }
 
-        nlohmann::ordered_json jsonResponse = getResponse(promptstream.str(), AskModel::STATE_OVERVIEW);
+        // only this thread changes the top list, the main thread may read it meanwhile
+        lock.unlock();
+        nlohmann::ordered_json jsonResponse = getResponse(system.str(), promptstream.str(), AskModel::STATE_OVERVIEW);
+        lock.lock();
+        if (jsonResponse.is_null()) {
+            callJavaLogger(CHILD_THREAD, "[THREAD] no overview of MergedState%d", payload.from->getId());
+            return;
+        }
 
-        // process response
-        payload.from->updateFromStateOverview(jsonResponse);
+        // process response, page by page, a page missing from the answer does not spoil the others
+        std::vector<MergedStatePtr> answered;
+        for (const MergedStatePtr& state : states) {
+            std::string name = "State" + std::to_string(state->getId());
+            nlohmann::ordered_json* overview = &jsonResponse;
+            if (batch) {
+                auto pages = jsonResponse.find("Pages");
+                if (pages == jsonResponse.end() || !pages->is_object() || !pages->contains(name)) {
+                    callJavaLogger(CHILD_THREAD, "[THREAD] no overview of MergedState%d in the answer", state->getId());
+                    continue;
+                }
+                overview = &(*pages)[name];
+            }
+            try {
+                state->updateFromStateOverview(*overview);
+                answered.push_back(state);
+            }
+            catch (const std::exception& e) {
+                callJavaLogger(CHILD_THREAD, "[Exception] overview of MergedState%d: %s", state->getId(), e.what());
+            }
+        }
         if (_topValuedMergedState->size() >= 5) {
             // update M list from response
             std::vector<int> topList;
@@ -294,7 +516,7 @@ namespace fastbotx {
             // Store the first 5 elements of _topValuedMergedState
             std::vector<MergedStatePtr> originalFirstFive(_topValuedMergedState->begin(), _topValuedMergedState->begin() + 5);
             // Replace the first 5 elements of _topValuedMergedState with elements from topList
-            for (size_t i = 0; i < topList.size(); ++i) {
+            for (size_t i = 0; i < topList.size() && i < 5; ++i) {
                 MergedStatePtr mergedState = _mergedStateGraph->findMergedStateById(topList[i]);
                 if (mergedState) {
                     (*_topValuedMergedState)[i] = mergedState;
@@ -320,7 +542,7 @@ namespace fastbotx {
             }*/
         }
         else {
-            _topValuedMergedState->push_back(payload.from);
+            _topValuedMergedState->insert(_topValuedMergedState->end(), answered.begin(), answered.end());
         }
         callJavaLogger(CHILD_THREAD, "askForStateOverview complete!");
     }
@@ -328,73 +550,118 @@ namespace fastbotx {
     void GPTAgent::askForGuiding(QuestionPayload& payload)
     {
         callJavaLogger(CHILD_THREAD, "[THREAD] ask for guiding");
-        std::stringstream promptstream;
-        promptstream << _startPrompt << _inputExplanationPrompt_guide;
+        _prompt.clear();
+        PromptText& system = _prompt.system();
+        PromptText& promptstream = _prompt.user();
+        system << _startPrompt << _inputExplanationPrompt_guide
+               << _requiredOutputPrompt_guide_part1 << _requiredOutputPrompt_guide_part2 << _answerFormatPrompt_guide;
 
-        nlohmann::ordered_json jsonData;
+        promptstream << "\n```State Informations\n{";
         int end = (_topValuedMergedState->size() > _P2) ? _P2 : _topValuedMergedState->size();
         int count = 0;
         for (int i = 0; i < _topValuedMergedState->size(); i++) {
             if ((*_topValuedMergedState)[i]->hasUntestedFunctions()) {
-                (*_topValuedMergedState)[i]->writeOverviewAndTop5Tojson(jsonData);
+                if (count > 0) { promptstream << ','; }
+                (*_topValuedMergedState)[i]->writeOverviewAndTop5(promptstream);
                 count++;
             }
             if (count >= end) {
                 break;
             }
         }
-        count = 0;
-        if (jsonData.empty()) {
+        if (count == 0) {
             for (int i = 0; i < _topValuedMergedState->size(); i++) {
-                (*_topValuedMergedState)[i]->writeOverviewAndTop5Tojson(jsonData, true);
+                if (count > 0) { promptstream << ','; }
+                (*_topValuedMergedState)[i]->writeOverviewAndTop5(promptstream, true);
                 count++;
                 if (count >= end) {
                     break;
                 }
             }
         }
-        promptstream << "\n```State Informations\n" << jsonData.dump(4) << "\n```\n";
+        promptstream << "}\n```\n";
 
-        // tested function
-        promptstream << _requiredOutputPrompt_guide_part1 << "{";
-        for (auto it: _testedFunctions) {
-            promptstream << it << ", ";
+        // tested function, the main thread adds to them while the question is asked
+        std::set<std::string> testedFunctions;
+        {
+            std::lock_guard<std::mutex> lock(_answerMtx);
+            testedFunctions = _testedFunctions;
+        }
+        promptstream << "Functions chosen before: {";
+        for (const std::string& tested : testedFunctions) {
+            promptstream << tested << ", ";
         }
-        promptstream << "}" << _requiredOutputPrompt_guide_part2;
-        promptstream << _answerFormatPrompt_guide;
+        promptstream << "}\n";
 
         // ask
-        nlohmann::ordered_json jsonResponse = getResponse(promptstream.str(), AskModel::GUIDE);
+        nlohmann::ordered_json jsonResponse = getResponse(system.str(), promptstream.str(), AskModel::GUIDE);
 
-        // process response
-        std::string targetState = jsonResponse["Target State"];
-        _targetFunction =  jsonResponse["Target Function"];
-        _targetMergedStateId = std::stoi(targetState.substr(5));
+        // process response, without a target the main thread treats the navigation as failed
+        int target = -1;
+        std::string function;
+        int mergedStateId = -1;
+        try {
+            if (!jsonResponse.is_null()) {
+                std::string targetState = jsonResponse["Target State"];
+                function = jsonResponse["Target Function"].get<std::string>();
+                mergedStateId = std::stoi(targetState.substr(5));
 
-        MergedStatePtr destination = _mergedStateGraph->findMergedStateById(_targetMergedStateId);
-        if (!destination) {
-            _promiseInt->set_value(-1);
+                MergedStatePtr destination = _mergedStateGraph->findMergedStateById(mergedStateId);
+                if (destination) {
+                    ReuseStatePtr targetState = destination->getTargetState(function);
+                    target = targetState ? targetState->getIdi() : -1;
+                }
+            }
         }
-        else {
-            ReuseStatePtr targetState = destination->getTargetState(_targetFunction);
-            _promiseInt->set_value((targetState? targetState->getIdi(): -1));
-        }   
+        catch (const std::exception& e) {
+            callJavaLogger(CHILD_THREAD, "[Exception] unexpected guide from GPT: %s", e.what());
+        }
+
+        std::lock_guard<std::mutex> lock(_answerMtx);
+        if (payload.promiseInt != _pendingGuide) {
+            // the main thread went on without it, the next local guide may still use it
+            if (target != -1) {
+                _lateGuide = {mergedStateId, function};
+            }
+            callJavaLogger(CHILD_THREAD, "[THREAD] guide came too late, keep it for the next navigation");
+            return;
+        }
+        _pendingGuide = nullptr;
+        if (mergedStateId != -1) {
+            _targetFunction = function;
+            _targetMergedStateId = mergedStateId;
+        }
+        payload.promiseInt->set_value(target);
     }
 
     void GPTAgent::askForTestFunction(QuestionPayload& payload)
     {
         callJavaLogger(CHILD_THREAD, "[THREAD] ask for testing function");
-        std::stringstream promptstream;
-        promptstream << _startPrompt << _inputExplanationPrompt_functionTest;
+        DescriptionFormat format = descriptionFormatFor(AskModel::TEST_FUNCTION);
+        _prompt.clear();
+        PromptText& system = _prompt.system();
+        PromptText& promptstream = _prompt.user();
+        system << _startPrompt << _inputExplanationPrompt_functionTest;
+        if (format == DescriptionFormat::COMPACT) { system << _compactFormatPrompt; }
+        // Ask which control to click
+        system << _requiredOutputPrompt_functionTest << "\n" << _answerFormatPrompt_functionTest;
+        if (!_executedFunctions.empty()) {
+            system << _answerFormatPrompt_functionTestEmpty;
+        }
         // Provide a detailed description of the page (including action number)
         // To extend to mergedWidget
-        std::string html = (payload.reuseState)->getStateDescription();
+        std::string html = (payload.reuseState)->getStateDescription(format);
         promptstream << "\n```Page Description\n" 
             << html
             << "```\n";
 
-        // Function to be tested
-        promptstream << "The target function I want to test is : " << _targetFunction << "\n";
+        // Function to be tested, a local guide of the main thread may change it meanwhile
+        std::string function;
+        {
+            std::lock_guard<std::mutex> lock(_answerMtx);
+            function = _targetFunction;
+        }
+        promptstream << "The target function I want to test is : " << function << "\n";
 
         // executed functions
         if (!_executedFunctions.empty()) {
@@ -405,61 +672,87 @@ namespace fastbotx {
             }
             promptstream << "]\n";
         }
-        
-        // Ask which control to click
-        promptstream << _requiredOutputPrompt_functionTest << "\n" << _answerFormatPrompt_functionTest;
-        if (!_executedFunctions.empty()) {
-            promptstream << _answerFormatPrompt_functionTestEmpty;
-        }
 
         // ask
-        nlohmann::ordered_json jsonResponse = getResponse(promptstream.str(), AskModel::TEST_FUNCTION);
+        nlohmann::ordered_json jsonResponse = getResponse(system.str(), promptstream.str(), AskModel::TEST_FUNCTION);
 
-        // process response
-        int elementId = jsonResponse["Element Id"];
-        int actionType = ActionType::CLICK + jsonResponse["Action Type"].get<int>();
-        // Special handling in Fastbot where the input corresponds to the click type.
-        if (jsonResponse["Action Type"].get<int>() == 6) {
-            actionType = ActionType::CLICK;
-        }
+        // process response, without an action the main thread goes back to exploring
+        ActivityStateActionPtr ret = nullptr;
+        int elementForAction = -1;
+        try {
+            if (jsonResponse.is_null()) {
+                callJavaLogger(CHILD_THREAD, "No answer of LLM, stop testing function %s", function.c_str());
+            }
+            else {
+                int elementId = jsonResponse["Element Id"];
+                int actionType = ActionType::CLICK + jsonResponse["Action Type"].get<int>();
+                // Special handling in Fastbot where the input corresponds to the click type.
+                if (jsonResponse["Action Type"].get<int>() == 6) {
+                    actionType = ActionType::CLICK;
+                }
 
-        if (elementId == -1) {
-            _promiseAction->set_value(nullptr);
-            return;
+                // Find action based on number
+                // If the widget comes from mergedWidgets, change the target widget of the action
+                // Directly return actionPtr, with inputText set, and add executed event in here, using line in html
+                int actionId = elementId == -1 ? -1 : payload.reuseState->findActionByElementId(elementId, actionType);
+                if (actionId == -1) {
+                    // _actionByGPT = state->getActions()[0];
+                    callJavaLogger(CHILD_THREAD, "LLM returns None, meaning function %s is either finished testing or can't be tested", function.c_str());
+                }
+                else {
+                    ret = (payload.reuseState)->getActions()[actionId];
+                    // set inputText to action
+                    if (jsonResponse.contains("Input")) {
+                        ret->setInputText(jsonResponse["Input"].get<std::string>());
+                    }
+                    elementForAction = elementId;
+                }
+            }
         }
-
-        // Find action based on number
-        // If the widget comes from mergedWidgets, change the target widget of the action
-        // Directly return actionPtr, with inputText set, and add executed event in here, using line in html
-        int actionId = payload.reuseState->findActionByElementId(elementId, actionType);
-        ActivityStateActionPtr ret = nullptr;
-        if (actionId == -1) {
-            // _actionByGPT = state->getActions()[0];
+        catch (const std::exception& e) {
+            callJavaLogger(CHILD_THREAD, "[Exception] unexpected action from LLM: %s", e.what());
             ret = nullptr;
-            callJavaLogger(CHILD_THREAD, "LLM returns None, meaning function %s is either finished testing or can't be tested", _targetFunction.c_str());
         }
-        else {
-            ret = (payload.reuseState)->getActions()[actionId];
-            // set inputText to action
-            if (jsonResponse.contains("Input")) {
-                ret->setInputText(jsonResponse["Input"].get<std::string>());
+
+        std::lock_guard<std::mutex> lock(_answerMtx);
+        if (payload.promiseAction != _pendingAction) {
+            // the page is gone, only "nothing left to do" still holds
+            bool done = !jsonResponse.is_null() && !ret;
+            if (done) {
+                _doneFunction = function;
             }
-            addExecutedEvent(html, elementId, ret);
+            callJavaLogger(CHILD_THREAD, "[THREAD] action came too late%s", done ? ", function is done" : ", dropped");
+            return;
+        }
+        _pendingAction = nullptr;
+        if (ret) {
+            addExecutedEvent(html, elementForAction, ret, format);
         }
-        _promiseAction->set_value(ret);
+        payload.promiseAction->set_value(ret);
     }
 
     void GPTAgent::askForReanalysis(QuestionPayload& payload) {
         callJavaLogger(CHILD_THREAD, "Ask for Reanalysis of MergedState%d", payload.from->getId());
-        std::stringstream prompt;
+        _prompt.clear();
+        PromptText& system = _prompt.system();
+        PromptText& prompt = _prompt.user();
+
+        DescriptionFormat format = descriptionFormatFor(AskModel::REANALYSIS);
+        system << _startPrompt << inputExplanationReanalysis1 << inputExplanationReanalysis2;
+        if (format == DescriptionFormat::COMPACT) {
+            system << _compactFormatPrompt;
+        }
+        system << requiredOutputReanalysis << answerFormatReanalysis;
 
-        prompt << _startPrompt << inputExplanationReanalysis1;
         prompt << "```Overview and Function List\n";
-        nlohmann::ordered_json data = payload.from->toJson();
-        prompt << data.dump(4);
+        payload.from->writeOverviewAndFunctions(prompt);
         prompt << "\n```\n";
-
-        prompt << inputExplanationReanalysis2 << "```Controls in HTML Description\n";
+        if (format == DescriptionFormat::COMPACT) {
+            prompt << "```Controls in Compact Description\n";
+        }
+        else {
+            prompt << "```Controls in HTML Description\n";
+        }
 
         // create widgetsDict
         std::unordered_map<int, WidgetInfo> widgetsDict;
@@ -493,72 +786,268 @@ namespace fastbotx {
         // generate widget list in html
         for (const auto& item : uniqueWidgets) {
             int widgetId = item.second[0];
-            prompt << widgetsDict[widgetId].widget->toHTML({}, true, widgetId);
+            if (format == DescriptionFormat::COMPACT) {
+                prompt << widgetsDict[widgetId].widget->toCompact(widgetId);
+            }
+            else {
+                prompt << widgetsDict[widgetId].widget->toHTML({}, true, widgetId);
+            }
         }
 
         prompt << "```\n";
-        prompt << requiredOutputReanalysis + answerFormatReanalysis;
 
-        nlohmann::ordered_json json_resp = getResponse(prompt.str(), AskModel::REANALYSIS);
+        nlohmann::ordered_json json_resp = getResponse(system.str(), prompt.str(), AskModel::REANALYSIS);
+        if (json_resp.is_null()) {
+            callJavaLogger(CHILD_THREAD, "No reanalysis of MergedState%d", payload.from->getId());
+            return;
+        }
 
         payload.from->updateFromReanalysis(json_resp, uniqueWidgets, widgetsDict);
 
     }
     
-    nlohmann::ordered_json GPTAgent::getResponse(const std::string& prompt, AskModel type)
+    // from the first "{" to the last "}" of an answer, the json in it if any
+    static std::string jsonPart(const std::string& response)
+    {
+        size_t begin = response.find('{');
+        begin = begin == std::string::npos ? 0 : begin;
+        size_t end = response.rfind('}');
+        end = end == std::string::npos || end < begin ? response.size() : end + 1;
+        return response.substr(begin, end - begin);
+    }
+
+    nlohmann::ordered_json GPTAgent::getResponse(const std::string& system, const std::string& prompt, AskModel type)
+    {
+        if (_saveToFile) {
+            saveToFile(system + prompt, 0);
+        }
+        callJavaLogger(CHILD_THREAD, "[THREAD]prompt:\n%s%s\n-----prompt end %d-----", system.c_str(), prompt.c_str(),
+                       system.length() + prompt.length());
+
+        double deadline = _resilience.deadline(currentStamp());
+        // an answer that does not parse is asked again, a few times and before the deadline
+        for (int parseRetry = 0; ; parseRetry++) {
+            std::string response;
+            if (!requestResponse(system, prompt, type, deadline, response)) {
+                callJavaLogger(CHILD_THREAD, "[ERROR]: no response from GPT, give up the %s question", askModelName(type));
+                return nlohmann::ordered_json();
+            }
+
+            try {
+                TRACE_SCOPE("llm.parse");
+                return nlohmann::ordered_json::parse(jsonPart(response));
+            }
+            catch (nlohmann::json::parse_error& e) {
+                if (parseRetry >= _resilience.parseRetries() || currentStamp() >= deadline) {
+                    callJavaLogger(CHILD_THREAD, "[Exception] %s, give up the %s question", e.what(), askModelName(type));
+                    return nlohmann::ordered_json();
+                }
+                callJavaLogger(CHILD_THREAD, "[Exception] %s, ask for response again", e.what());
+            }
+        }
+    }
+
+    // client errors other than timeouts, conflicts and rate limits fail the same way when retried
+    static bool retryableStatus(long statusCode)
+    {
+        return statusCode < 400 || statusCode >= 500 || statusCode == 408 || statusCode == 409 || statusCode == 429;
+    }
+
+    // the content of the first choice of a chat completion
+    static bool messageContent(const nlohmann::json& rawJson, std::string& content)
+    {
+        auto choices = rawJson.find("choices");
+        if (choices == rawJson.end() || !choices->is_array() || choices->empty()) {
+            return false;
+        }
+        const nlohmann::json& choice = choices->front();
+        auto message = choice.find("message");
+        if (message == choice.end() || !message->is_object()) {
+            return false;
+        }
+        auto text = message->find("content");
+        if (text == message->end() || !text->is_string()) {
+            return false;
+        }
+        content = text->get<std::string>();
+        return true;
+    }
+
+    /// The token usage of a chat completion, false if it tells none
+    static bool responseUsage(const nlohmann::json& rawJson, int& promptTokens, int& completionTokens,
+                              int& cachedTokens)
+    {
+        if (!rawJson.contains("usage") || !rawJson["usage"].is_object()) {
+            return false;
+        }
+        const nlohmann::json &usage = rawJson["usage"];
+        promptTokens = usage.value("prompt_tokens", 0);
+        completionTokens = usage.value("completion_tokens", 0);
+        if (usage.contains("prompt_tokens_details") && usage["prompt_tokens_details"].is_object()) {
+            cachedTokens = usage["prompt_tokens_details"].value("cached_tokens", 0);
+        }
+        return true;
+    }
+
+    // a request still hanging at the deadline is cut off
+    static int32_t requestTimeout(double deadline, double now)
+    {
+        return static_cast<int32_t>(std::max(1000.0, deadline - now));
+    }
+
+    bool GPTAgent::requestResponse(const std::string& system, const std::string& prompt, AskModel type, double deadline,
+                                   std::string& response)
     {
-        saveToFile(prompt, 0);
-        callJavaLogger(CHILD_THREAD, "[THREAD]prompt:\n%s\n-----prompt end %d-----", prompt.c_str(), prompt.length());
         callJavaLogger(CHILD_THREAD, "[THREAD]Start Asking...");
-        
-        _conversation.AddUserData(prompt);
-        double beginStamp = 0;
-        double endStamp = 0;
         liboai::Response rawResponse;
-        
-        if (_gpt.auth.SetKey(_apiKey))
+        int promptTokens = 0;
+        int completionTokens = 0;
+        int cachedTokens = 0;
+        int try_times = 0;
+        bool answered = false;
+        std::string model = _model_str;
+        int answeredBy = -1;
+        // before the usage of the answer tells
+        double tokens = _limiter.estimate(type, static_cast<double>(roughTokens(system) + roughTokens(prompt)));
+        double beginStamp = currentStamp();
         {
-            int try_times = 0;
-            beginStamp = currentStamp();
-            while (try_times < 5) {
+            TRACE_SCOPE("llm.request");
+            while (true) {
+                double now = currentStamp();
+                if (now >= deadline) {
+                    callJavaLogger(CHILD_THREAD, "\t\t\t\t[WARNING] deadline of the %s question passed", askModelName(type));
+                    break;
+                }
+                // an allowed request is reported below, it may be the probe of the breaker
+                if (!_resilience.allowRequest(now)) {
+                    callJavaLogger(CHILD_THREAD, "\t\t\t\t[WARNING] GPT backend is unhealthy, don't ask");
+                    break;
+                }
+                double retryAfter = -1.0;
+                bool retryable = true;
+                int backend = -1;
+                int asked = -1;
+                int charged = -1; // the backend whose budget took the tokens of a single request
                 try {
-                    rawResponse = _gpt.ChatCompletion->create(_model_str, _conversation, 0.0);
-                    bool success = _conversation.Update(rawResponse);
-                    if (success) { break; }
+                    if (_replay.replaying()) {
+                        LLMExchange exchange = _replay.replay(type, system + prompt);
+                        response = exchange.response;
+                        promptTokens = exchange.promptTokens;
+                        completionTokens = exchange.completionTokens;
+                        cachedTokens = exchange.cachedTokens;
+                        answered = true;
+                    }
+                    else {
+                        // each retry moves down the fallback chain of the question type
+                        backend = _router.pick(type, try_times, now);
+                        asked = backend;
+                        const LLMBackend& route = _router.backends()[backend];
+                        model = route.model;
+                        if (route.apiKey.empty()) {
+                            callJavaLogger(CHILD_THREAD, "!!!Set key of %s failed!!!", route.name.c_str());
+                            throw std::runtime_error("invalid api key of backend " + route.name);
+                        }
+                        double hedgeDelay = _hedger.delay(type);
+                        if (hedgeDelay >= 0.0) {
+                            // both requests are reported to the router by the race
+                            backend = -1;
+                            answered = hedgedRequest(type, asked, tokens, hedgeDelay, deadline, system, prompt,
+                                                     rawResponse, response, answeredBy);
+                            if (answered) {
+                                model = _router.backends()[answeredBy].model;
+                            }
+                        }
+                        else {
+                            // a cancelled request may still read the body of its question
+                            int body = idleBody();
+                            if (body < 0) {
+                                joinRequests();
+                                body = 0;
+                            }
+                            // the instructions of the question type go first, as a prefix the provider can cache
+                            std::string_view requestBody = _prompt.requestBody(model, system, prompt, body);
+                            _limiter.take(backend, tokens, now);
+                            charged = backend;
+                            rawResponse = _chats[backend]->create_raw(requestBody, route.apiKey,
+                                                                      requestTimeout(deadline, now));
+                            answered = messageContent(rawResponse.raw_json, response);
+                            if (answered) {
+                                answeredBy = backend;
+                                _hedger.observe(type, currentStamp() - now);
+                            }
+                        }
+                        if (!answered) {
+                            callJavaLogger(CHILD_THREAD, "[Exception]: GPT's response has no message");
+                        }
+                    }
+                } catch (const liboai::exception::OpenAIRateLimited& e) {
+                    callJavaLogger(CHILD_THREAD, "[Exception]: %s", e.what());
+                    retryAfter = e.GetRetryAfter();
+                    if (asked >= 0) {
+                        _limiter.limited(asked, currentStamp());
+                    }
+                    // the budget is emptied, nothing to give back
+                    charged = -1;
+                } catch (const liboai::exception::OpenAIException& e) {
+                    callJavaLogger(CHILD_THREAD, "[Exception]: %s, status %ld", e.what(), e.GetStatusCode());
+                    retryAfter = e.GetRetryAfter();
+                    retryable = retryableStatus(e.GetStatusCode());
                 } catch (const std::exception& e) {
                     // Catch any exception from std::exception and its derived classes
                     callJavaLogger(CHILD_THREAD, "[Exception]: %s", e.what());
-                    // try again
-                    callJavaLogger(CHILD_THREAD, "\t\t\t\t[WARNING] GPT chat got an exception, try to ask again in 3 seconds");
-                    std::this_thread::sleep_for(std::chrono::seconds(3));
-                    try_times++;
                 }
+                if (backend >= 0) {
+                    _router.report(backend, type, answered, currentStamp() - now);
+                }
+                if (charged >= 0 && !answered) {
+                    _limiter.release(charged, tokens, currentStamp());
+                }
+                if (answered) {
+                    _resilience.onSuccess();
+                    break;
+                }
+                _resilience.onFailure(currentStamp());
+                try_times++;
+                if (!retryable || try_times >= _resilience.attempts()) {
+                    break;
+                }
+                double delay = _resilience.backoff(try_times, retryAfter);
+                if (currentStamp() + delay >= deadline) {
+                    callJavaLogger(CHILD_THREAD, "\t\t\t\t[WARNING] no time left to retry before the deadline");
+                    break;
+                }
+                // try again
+                callJavaLogger(CHILD_THREAD, "\t\t\t\t[WARNING] GPT chat got an exception, try to ask again in %.1f seconds", delay / 1000.0);
+                std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(delay * 1000.0)));
             }
-            endStamp = currentStamp();
-            if (try_times == 5) {
-                callJavaLogger(CHILD_THREAD, "[ERROR]: error when getting GPT's response");
-                exit(0);
-            }
-            
         }
-        else
-        {
-            callJavaLogger(CHILD_THREAD, "!!!Set key failed!!!");
-            exit(0);
+        double endStamp = currentStamp();
+
+        if (!answered) {
+            return false;
+        }
+
+        if (!_replay.replaying()) {
+            responseUsage(rawResponse.raw_json, promptTokens, completionTokens, cachedTokens);
+            callJavaLogger(CHILD_THREAD, "[THREAD] %s prompt of %d tokens, %d of them cached by the provider",
+                           askModelName(type), promptTokens, cachedTokens);
+            _limiter.settle(answeredBy, type, tokens, promptTokens, completionTokens, rawResponse.headers, endStamp);
         }
-        
-        _cachedConversation++;
-        std::string response = _conversation.GetLastResponse();
 
         double timeCost = (endStamp - beginStamp) / 1000.0;
-        nlohmann::json rawJson = rawResponse.raw_json;
+        LLMMetrics::inst().request(type, endStamp - beginStamp, try_times, promptTokens, completionTokens,
+                                   cachedTokens);
+        if (_replay.mode() == LLMReplay::Mode::RECORD) {
+            _replay.record({type, LLMReplay::promptHash(system + prompt), model, response,
+                            promptTokens, completionTokens, cachedTokens, timeCost});
+        }
 
         using UnderlyingType = typename std::underlying_type<AskModel>::type;
         _interactionFile << std::fixed << std::setprecision(5) <<
                 timeCost << ", " <<
-                _model_str << ", " <<
-                rawJson["usage"]["prompt_tokens"] << ", " <<
-                rawJson["usage"]["completion_tokens"] << ", " <<
+                model << ", " <<
+                promptTokens << ", " <<
+                completionTokens << ", " <<
                 static_cast<UnderlyingType>(type) << std::endl;
 
         callJavaLogger(1, "[THREAD]Get response\n%s\n", response.c_str());
@@ -567,36 +1056,229 @@ namespace fastbotx {
         if (_saveToFile){
             saveToFile(response, 1);
         }
+        return true;
+    }
 
-        if (_cachedConversation > _maxCachedConversation) {
-            if (_conversation.PopFirstUserData() && _conversation.PopFirstResponse()) {
-                callJavaLogger(CHILD_THREAD, "[THREAD] Reach max cached conversation, pop the earliest one");
-                _cachedConversation--;
+    struct RequestLeg {
+        int backend = -1;
+        std::string model;
+        int buffer = -1; // of the body in PromptBuilder
+        std::string_view body;
+        double begin = 0.0;
+        std::atomic<bool> cancel{false};
+        // written by the thread of the request, guarded by RequestRace::mutex
+        bool finished = false;
+        bool answered = false; // the response has a message
+        bool valid = false; // which holds json
+        double latency = 0.0;
+        liboai::Response response;
+        std::string content;
+        std::exception_ptr error;
+
+        double end() const { return begin + latency; }
+    };
+
+    struct RequestRace {
+        std::mutex mutex;
+        std::condition_variable finished;
+        RequestLeg legs[PromptBuilder::Bodies];
+        int started = 0;
+    };
+
+    void GPTAgent::startRequest(const std::shared_ptr<RequestRace>& race, int backend, double deadline,
+                                const std::string& system, const std::string& prompt)
+    {
+        int index = race->started;
+        RequestLeg& leg = race->legs[index];
+        const LLMBackend& route = _router.backends()[backend];
+        leg.backend = backend;
+        leg.model = route.model;
+        if (index > 0 && leg.model == race->legs[0].model) {
+            // the same model is sent the same body
+            leg.buffer = race->legs[0].buffer;
+            leg.body = race->legs[0].body;
+        }
+        else {
+            leg.buffer = index > 0 ? idleBody(race->legs[0].buffer) : idleBody();
+            if (leg.buffer < 0) {
+                // cancelled requests read all of them
+                joinRequests();
+                leg.buffer = 0;
+            }
+            leg.body = _prompt.requestBody(leg.model, system, prompt, leg.buffer);
+        }
+        // idleBody() may have let go of the race when its first request finished meanwhile
+        if (_races.empty() || _races.back() != race) {
+            _races.push_back(race);
+        }
+        {
+            std::lock_guard<std::mutex> lock(race->mutex);
+            race->started++;
+        }
+        leg.begin = currentStamp();
+        const liboai::ChatCompletion* chat = _chats[backend].get();
+        std::string key = route.apiKey;
+        int32_t timeout = requestTimeout(deadline, leg.begin);
+        _requestThreads.emplace_back([race, &leg, chat, key, timeout] {
+            liboai::Response response;
+            std::string content;
+            std::exception_ptr error;
+            bool answered = false;
+            bool valid = false;
+            try {
+                response = chat->create_raw(leg.body, key, timeout, &leg.cancel);
+                answered = messageContent(response.raw_json, content);
+                valid = answered && nlohmann::json::accept(jsonPart(content));
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(race->mutex);
+            leg.finished = true;
+            leg.answered = answered;
+            leg.valid = valid;
+            leg.latency = currentStamp() - leg.begin;
+            leg.response = std::move(response);
+            leg.content = std::move(content);
+            leg.error = error;
+            race->finished.notify_all();
+        });
+    }
+
+    bool GPTAgent::hedgedRequest(AskModel type, int backend, double tokens, double hedgeDelay, double deadline,
+                                 const std::string& system, const std::string& prompt, liboai::Response& rawResponse,
+                                 std::string& response, int& answeredBy)
+    {
+        auto race = std::make_shared<RequestRace>();
+        RequestLeg& first = race->legs[0];
+        RequestLeg& second = race->legs[1];
+        _limiter.take(backend, tokens, currentStamp());
+        startRequest(race, backend, deadline, system, prompt);
+
+        std::unique_lock<std::mutex> lock(race->mutex);
+        race->finished.wait_for(lock, std::chrono::microseconds(static_cast<int64_t>(hedgeDelay * 1000.0)),
+                                [&first] { return first.finished; });
+        bool slow = !first.finished;
+        lock.unlock();
+        int other = _hedger.backendFor(backend);
+        // another model needs a body of its own, which a cancelled request may still read
+        bool bodyIdle = _router.backends()[other].model == first.model || idleBody(first.buffer) >= 0;
+        if (slow && currentStamp() < deadline && bodyIdle && _hedger.spend()) {
+            callJavaLogger(CHILD_THREAD, "[THREAD] no answer to %s after %.0f ms, ask %s as well", askModelName(type),
+                           hedgeDelay, _router.backends()[other].name.c_str());
+            _limiter.take(other, tokens, currentStamp());
+            startRequest(race, other, deadline, system, prompt);
+        }
+        lock.lock();
+
+        // the first answer holding json wins, or else the first answer once all requests are done
+        RequestLeg* winner = nullptr;
+        race->finished.wait(lock, [&race, &winner] {
+            bool done = true;
+            for (int i = 0; i < race->started; i++) {
+                RequestLeg& leg = race->legs[i];
+                if (leg.finished && leg.valid && (!winner || leg.end() < winner->end())) {
+                    winner = &leg;
+                }
+                done = done && leg.finished;
+            }
+            return winner || done;
+        });
+        for (int i = 0; !winner && i < race->started; i++) {
+            RequestLeg& leg = race->legs[i];
+            if (leg.answered && (!winner || leg.end() < winner->end())) {
+                winner = &leg;
+            }
+        }
+        for (int i = 0; i < race->started; i++) {
+            RequestLeg& leg = race->legs[i];
+            if (leg.finished) {
+                _router.report(leg.backend, type, leg.answered, leg.latency);
+            }
+            else {
+                // not waited for, it stops at its next progress check
+                leg.cancel = true;
+            }
+            if (&leg == winner) {
+                // settled by requestResponse
+                continue;
+            }
+            int promptTokens = 0;
+            int completionTokens = 0;
+            int cachedTokens = 0;
+            // an answer that lost still used its tokens, one that failed or was cancelled gives them back
+            if (leg.finished && leg.answered &&
+                responseUsage(leg.response.raw_json, promptTokens, completionTokens, cachedTokens) &&
+                promptTokens + completionTokens > 0) {
+                _limiter.settle(leg.backend, type, tokens, promptTokens, completionTokens, leg.response.headers,
+                                currentStamp());
             }
             else {
-                callJavaLogger(CHILD_THREAD, "[THREAD] Pop conversation failed!");
-            }            
+                _limiter.release(leg.backend, tokens, currentStamp());
+            }
         }
 
-        // Intercept the following string starting from the "{" character
-        size_t pos = response.find('{');
-        if (pos != std::string::npos) {
-            response = response.substr(pos);
+        // how long the first request took, or had run when it lost
+        double firstLatency = first.finished ? first.latency : (winner ? winner->end() : currentStamp()) - first.begin;
+        if (race->started > 1) {
+            bool won = winner == &second;
+            double saved = won ? _hedger.expectedRest(type, firstLatency) : 0.0;
+            LLMMetrics::inst().hedged(type, won, saved);
+            callJavaLogger(CHILD_THREAD, "[THREAD] %s answered by the %s request, about %.0f ms saved",
+                           askModelName(type), won ? "second" : (winner ? "first" : "no"), saved);
         }
-        pos = response.rfind('}');
-        if (pos != std::string::npos) {
-            response = response.substr(0, pos + 1);
+        // a cancelled request took at least as long as it ran, leaving it out would pull the percentile down
+        if (first.answered || !first.finished) {
+            _hedger.observe(type, firstLatency);
         }
 
-        nlohmann::ordered_json jsonResponse;
-        try {
-            jsonResponse = nlohmann::ordered_json::parse(response);
+        if (!winner) {
+            std::exception_ptr error = first.error ? first.error : second.error;
+            lock.unlock();
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            return false;
         }
-        catch (nlohmann::json::parse_error& e) {
-            callJavaLogger(CHILD_THREAD, "[Exception] %s, ask for response again", e.what());
-            return getResponse(prompt, type);
+        rawResponse = std::move(winner->response);
+        response = std::move(winner->content);
+        answeredBy = winner->backend;
+        return true;
+    }
+
+    int GPTAgent::idleBody(int taken)
+    {
+        bool read[PromptBuilder::Bodies] = {};
+        bool running = false;
+        for (const std::shared_ptr<RequestRace>& race : _races) {
+            std::lock_guard<std::mutex> lock(race->mutex);
+            for (int i = 0; i < race->started; i++) {
+                const RequestLeg& leg = race->legs[i];
+                if (!leg.finished) {
+                    read[leg.buffer] = true;
+                    running = true;
+                }
+            }
+        }
+        if (!running) {
+            // the threads have nothing left to do but return
+            joinRequests();
         }
-        return jsonResponse;
+        for (int body = 0; body < static_cast<int>(PromptBuilder::Bodies); body++) {
+            if (body != taken && !read[body]) {
+                return body;
+            }
+        }
+        return -1;
+    }
+
+    void GPTAgent::joinRequests()
+    {
+        for (std::thread& request : _requestThreads) {
+            request.join();
+        }
+        _requestThreads.clear();
+        _races.clear();
     }
 
     void GPTAgent::resetPromise(PromiseIntPtr promInt, PromiseActionPtr promAction)
@@ -605,25 +1287,52 @@ namespace fastbotx {
         _promiseInt = std::move(promInt);
     }
 
+    std::string GPTAgent::getFunctionToTest()
+    {
+        std::lock_guard<std::mutex> lock(_answerMtx);
+        return _targetFunction;
+    }
+
     void GPTAgent::addTestedFunction()
     {
-        _testedFunctions.insert(_targetFunction);
+        std::string function;
+        int mergedStateId;
+        {
+            // a late guide of the LLM thread reads them
+            std::lock_guard<std::mutex> lock(_answerMtx);
+            _testedFunctions.insert(_targetFunction);
+            function = _targetFunction;
+            mergedStateId = _targetMergedStateId;
+        }
         // add update tested function to mergedState(target)
-        MergedStatePtr ms = _mergedStateGraph->findMergedStateById(_targetMergedStateId);
+        MergedStatePtr ms = _mergedStateGraph->findMergedStateById(mergedStateId);
         if (ms) {
-            ms->updateCompletedFunction(_targetFunction);
+            ms->updateCompletedFunction(function);
         }
         else {
-            callJavaLogger(MAIN_THREAD, "Can't find MergedState%d when marking function(%s) as tested", _targetMergedStateId, _targetFunction.c_str());
+            callJavaLogger(MAIN_THREAD, "Can't find MergedState%d when marking function(%s) as tested", mergedStateId, function.c_str());
         }
     }
 
-    void GPTAgent::addExecutedEvent(const std::string& html, int widget_id, ActionPtr act) {
+    void GPTAgent::addExecutedEvent(const std::string& html, int widget_id, ActionPtr act, DescriptionFormat format) {
         std::istringstream stream(html);
         std::string line;
-        std::string target = "id=" + std::to_string(widget_id);
+        std::string target = (format == DescriptionFormat::COMPACT ? "#" : "id=") + std::to_string(widget_id);
         
         while (std::getline(stream, line)) {
+            if (format == DescriptionFormat::COMPACT) {
+                // "<spaces><tag letter>#<id>", the id must not continue with another digit
+                size_t tagPos = line.find_first_not_of(' ');
+                if (tagPos == std::string::npos || line.compare(tagPos + 1, target.size(), target) != 0) {
+                    continue;
+                }
+                size_t idEnd = tagPos + 1 + target.size();
+                if (idEnd >= line.size() || !isdigit(static_cast<unsigned char>(line[idEnd]))) {
+                    _executedFunctions.push_back(act->toDescription(line.substr(tagPos)));
+                    break;
+                }
+                continue;
+            }
             if (line.find(target) != std::string::npos) {
                 std::istringstream line_stream(line);
                 std::string cell;
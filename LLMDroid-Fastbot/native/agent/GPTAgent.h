@@ -7,8 +7,16 @@
 #include <queue>
 #include "MergedState.h"
 #include "prompt.h"
+#include "LLMReplay.h"
+#include "LLMResilience.h"
+#include "LLMRouter.h"
+#include "LLMHedger.h"
+#include "LLMRateLimiter.h"
+#include "QuestionScheduler.h"
+#include "PromptBuilder.h"
 #include <atomic>
 #include <future>
+#include <thread>
 
 #define GPT_3 0
 #define GPT_4 1
@@ -16,29 +24,9 @@
 
 namespace fastbotx {
 
-    typedef std::shared_ptr<std::promise<int>> PromiseIntPtr;
-    typedef std::future<int> FutureInt;
-    typedef std::shared_ptr<std::promise<std::string>> PromiseStrPtr;
-    typedef std::future<std::string> FutureStr;
-    typedef std::shared_ptr<std::promise<ActivityStateActionPtr>> PromiseActionPtr;
-    typedef std::future<ActivityStateActionPtr> FutureAction;
+    // the requests of one hedged question, see GPTAgent::hedgedRequest
+    struct RequestRace;
 
-    enum class AskModel
-    {
-        STATE_OVERVIEW, GRAPH_OVERVIEW, GUIDE, TEST_FUNCTION, GUIDE_FAILURE, REANALYSIS
-    };
-    
-    struct QuestionPayload
-    {
-        AskModel type;
-        MergedStatePtr from = nullptr;
-        std::map<MergedStatePtr, std::set<ActionPtr>> stateMap;
-        int transitCount = 0;
-        ReuseStatePtr reuseState = nullptr;
-        bool flag = false; // GUIDE:guideFailed, TEST_FUNCTION:firstTime
-    };
-    
-    
     /**
      * @brief Responsible for interacting with GPT.
      *
@@ -53,7 +41,7 @@ namespace fastbotx {
 
         /**
          * @brief Add a page to be asked to the queue, called by the main thread.
-         * Lock the queue and push a state to it
+         * Moved into the scheduler, which may coalesce it with the same question already queued
          * 
          * @param state 
          */
@@ -63,7 +51,7 @@ namespace fastbotx {
 
         void resetPromise(PromiseIntPtr promInt, PromiseActionPtr promAction);
 
-        std::string getFunctionToTest() { return _targetFunction; }
+        std::string getFunctionToTest();
         
         /**
          * After askForTestFunction ends and the action is generated, it is called by the main thread.
@@ -74,6 +62,32 @@ namespace fastbotx {
 
         void clearExecutedEvents();
 
+        /// Whether the LLM backend is usable, false while the circuit breaker is open
+        bool available() const { return _resilience.available(currentStamp()); }
+
+        /// How long the main thread waits for the answer of a GUIDE or TEST_FUNCTION question
+        std::chrono::milliseconds answerWait(AskModel type) const;
+
+        /**
+         * @brief Stop waiting for the answer of the GUIDE or TEST_FUNCTION question asked last.
+         * A question still queued is dropped, one being asked is still answered, but the answer is
+         * not handed to the main thread.
+         * @return false if the answer came meanwhile and the future is ready
+         * @note call from main thread
+         */
+        bool abandonAnswer(AskModel type);
+
+        /**
+         * @brief Choose the navigation target without the LLM: the target of a guide the LLM gave too
+         * late, or the most important untested function of the top valued MergedStates
+         * @return the id of the ReuseState to navigate to, -1 if there is none
+         * @note call from main thread
+         */
+        int localGuide();
+
+        /// Whether a late answer said the function under test is done
+        bool takeFunctionDone();
+
     private:
         //std::atomic<int> _questionRemained;
         bool _saveToFile = true;
@@ -84,15 +98,30 @@ namespace fastbotx {
 
         std::string _startPrompt;
         std::string _apiKey;
-        liboai::OpenAI _gpt;
-        liboai::Conversation _conversation;
-        const int _maxCachedConversation = 0;
-        int _cachedConversation = 0;
-        size_t _conversationLen = 0;
-        std::queue<QuestionPayload> _stateQueue;
-        std::queue<QuestionPayload> _lowQueue;
+        liboai::Authorization& _auth = liboai::Authorization::Authorizer();
+        // one per backend of _router, in the same order
+        std::vector<std::unique_ptr<liboai::ChatCompletion>> _chats;
+        // "Routing" in config.json, which model answers which question type
+        LLMRouter _router;
+        // "Hedging" in config.json, which requests are sent a second time when slow
+        LLMHedger _hedger;
+        // "RateLimit" in config.json, paces the questions the main thread does not wait on
+        LLMRateLimiter _limiter;
+        // hedged questions whose cancelled request may still be running, and the threads of their requests
+        std::vector<std::shared_ptr<RequestRace>> _races;
+        std::vector<std::thread> _requestThreads;
+        // the prompt of the question being asked and its request body, used by the child thread only
+        PromptBuilder _prompt;
+        // "Backend" in config.json, records the answers or plays them back instead of asking
+        LLMReplay _replay;
+        // "Resilience" in config.json, retries, deadlines and the circuit breaker of the requests
+        LLMResilience _resilience;
+        // "Scheduler" in config.json, the questions waiting for the child thread
+        QuestionScheduler _scheduler;
         std::mutex _mtx;
-        std::condition_variable _cv;
+
+        // "DescriptionFormat" in config.json, html unless listed
+        std::map<AskModel, DescriptionFormat> _descriptionFormat;
 
         MergedStateGraphPtr _mergedStateGraph;
         std::string _mergedStateGraphString;
@@ -101,11 +130,16 @@ namespace fastbotx {
         PromiseStrPtr _promiseStr;
         PromiseActionPtr _promiseAction;
 
-        std::mutex _questionMtx;
-        int _questionRemained = 0;
+        // the answers the main thread still waits for, guarded by _answerMtx
+        std::mutex _answerMtx;
+        PromiseIntPtr _pendingGuide;
+        PromiseActionPtr _pendingAction;
+        std::pair<int, std::string> _lateGuide{-1, ""}; // MergedState id and function
+        std::string _doneFunction; // a late answer said testing it is over
 
+        // the target and the functions tested are guarded by _answerMtx as well
         std::string _targetFunction; //Gpt in the guide determines the test function
-        int _targetMergedStateId;
+        int _targetMergedStateId = -1;
         std::set<std::string> _testedFunctions; // All functions that have been implemented in the guide
         std::vector<std::string> _executedFunctions;
 
@@ -122,8 +156,15 @@ namespace fastbotx {
          */
         void pageAnalysisLoop();
 
+        /// A reanalysis of a MergedState no longer among the top valued ones is not worth asking
+        bool isStale(const QuestionPayload& payload);
+
+        /// Ask for the overview of payload.from, along with the overviews queued meanwhile
         void askForStateOverview(QuestionPayload& payload);
 
+        /// Description of the MergedState for its overview, cut to fit the prompt
+        std::string overviewDescription(const MergedStatePtr& mergedState, DescriptionFormat format);
+
         void askForGuiding(QuestionPayload& payload);
 
         void askForTestFunction(QuestionPayload& payload);
@@ -134,9 +175,49 @@ namespace fastbotx {
 
         void saveToFile(const std::string& value, int type);
 
-        nlohmann::ordered_json getResponse(const std::string& prompt, AskModel type);
+        /**
+         * @brief Ask the LLM and parse the json in its answer, asking again when it does not parse.
+         * @param system the instructions, the same for every question of the type, sent first so
+         * that the provider can serve them from its prefix cache
+         * @param prompt the pages, states and functions of this question
+         * @return null when no usable answer came before the deadline of the question
+         */
+        nlohmann::ordered_json getResponse(const std::string& system, const std::string& prompt, AskModel type);
+
+        /// Send the prompt with retries and backoff until answered, the deadline or the breaker stop it
+        bool requestResponse(const std::string& system, const std::string& prompt, AskModel type, double deadline,
+                             std::string& response);
+
+        /**
+         * @brief Send the prompt to the backend, and once more if it has not answered after hedgeDelay ms.
+         * The first answer holding json is taken and the other request cancelled.
+         * @param tokens expected to be used by each request, taken from the rate limit
+         * @param answeredBy the backend of the answer taken
+         * @throw the error of the first request when neither answered
+         */
+        bool hedgedRequest(AskModel type, int backend, double tokens, double hedgeDelay, double deadline,
+                           const std::string& system, const std::string& prompt, liboai::Response& rawResponse,
+                           std::string& response, int& answeredBy);
+
+        /// Start the next request of the race on a thread of its own
+        void startRequest(const std::shared_ptr<RequestRace>& race, int backend, double deadline,
+                          const std::string& system, const std::string& prompt);
+
+        /// A request body buffer of _prompt other than taken that no cancelled request still reads, -1 if none
+        int idleBody(int taken = -1);
+
+        /// Wait for the requests of the hedged questions, a cancelled one stops at its next progress check
+        void joinRequests();
     
-        void addExecutedEvent(const std::string& html, int widget_id, ActionPtr act);
+        void addExecutedEvent(const std::string& html, int widget_id, ActionPtr act, DescriptionFormat format);
+
+        /**
+         * @brief Read "DescriptionFormat" of config.json, either "html"/"compact" for all questions
+         * or an object from question type to format, e.g. {"TEST_FUNCTION": "compact"}
+         */
+        void loadDescriptionFormat(const nlohmann::json& config);
+
+        DescriptionFormat descriptionFormatFor(AskModel type) const;
     };
 
 }
@@ -0,0 +1,86 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMHedger_CPP_
+#define LLMHedger_CPP_
+
+#include <algorithm>
+#include <vector>
+#include "LLMHedger.h"
+
+namespace fastbotx {
+
+    void LLMHedger::configure(const nlohmann::json &config, const LLMRouter &router) {
+        this->_types.clear();
+        nlohmann::json types = config.value("Types", nlohmann::json::array({"GUIDE", "TEST_FUNCTION"}));
+        for (auto &name: types) {
+            AskModel type;
+            if (name.is_string() && askModelFromName(name.get<std::string>(), type))
+                this->_types.insert(type);
+            else
+                callJavaLogger(MAIN_THREAD, "[LLMHedger] unknown question type %s", name.dump().c_str());
+        }
+        this->_percentile = std::min(std::max(config.value("Percentile", 90.0), 1.0), 99.0) / 100.0;
+        this->_minDelay = config.value("MinDelay", this->_minDelay / 1000.0) * 1000.0;
+        this->_minSamples = std::max<size_t>(1, config.value("MinSamples", this->_minSamples));
+        this->_window = std::max(this->_minSamples, config.value("Window", this->_window));
+        this->_budget = std::max(0.0, config.value("Budget", this->_budget));
+        this->_backend = -1;
+        if (config.contains("Backend")) {
+            std::string name = config["Backend"].get<std::string>();
+            this->_backend = router.indexOf(name);
+            if (this->_backend < 0)
+                callJavaLogger(MAIN_THREAD, "[LLMHedger] unknown backend %s, send again to the same one", name.c_str());
+        }
+        callJavaLogger(MAIN_THREAD, "[LLMHedger] %zu question types sent again after p%.0f, budget %.0f%%",
+                       this->_types.size(), this->_percentile * 100.0, this->_budget * 100.0);
+    }
+
+    double LLMHedger::delay(AskModel type) {
+        if (this->_types.count(type) == 0)
+            return -1.0;
+        this->_requests++;
+        auto latencies = this->_latencies.find(type);
+        if (latencies == this->_latencies.end() || latencies->second.size() < this->_minSamples)
+            return -1.0;
+        std::vector<double> sorted(latencies->second.begin(), latencies->second.end());
+        auto nth = sorted.begin() + static_cast<long>(this->_percentile * static_cast<double>(sorted.size() - 1));
+        std::nth_element(sorted.begin(), nth, sorted.end());
+        return std::max(this->_minDelay, *nth);
+    }
+
+    bool LLMHedger::spend() {
+        if (static_cast<double>(this->_hedged + 1) > this->_budget * static_cast<double>(this->_requests))
+            return false;
+        this->_hedged++;
+        return true;
+    }
+
+    void LLMHedger::observe(AskModel type, double latency) {
+        if (this->_types.count(type) == 0)
+            return;
+        std::deque<double> &latencies = this->_latencies[type];
+        latencies.push_back(latency);
+        if (latencies.size() > this->_window)
+            latencies.pop_front();
+    }
+
+    double LLMHedger::expectedRest(AskModel type, double elapsed) const {
+        auto latencies = this->_latencies.find(type);
+        if (latencies == this->_latencies.end())
+            return 0.0;
+        // the requests that took longer than elapsed, as this one does
+        double sum = 0.0;
+        int longer = 0;
+        for (double latency: latencies->second) {
+            if (latency > elapsed) {
+                sum += latency;
+                longer++;
+            }
+        }
+        return longer > 0 ? sum / longer - elapsed : 0.0;
+    }
+
+}
+
+#endif //LLMHedger_CPP_
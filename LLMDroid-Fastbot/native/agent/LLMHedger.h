@@ -0,0 +1,66 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMHedger_H_
+#define LLMHedger_H_
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include "LLMRouter.h"
+#include "../thirdpart/json/json.hpp"
+
+namespace fastbotx {
+
+    /**
+     * @brief When a request the main thread waits on is sent a second time, so that one slow
+     * answer does not hold the test up.
+     *
+     * Configured by "Hedging" in config.json, times in seconds:
+     *   {"Types": ["GUIDE", "TEST_FUNCTION"], "Percentile": 90, "MinDelay": 1, "MinSamples": 10,
+     *    "Window": 50, "Budget": 0.1, "Backend": "mini"}
+     *
+     * A request of one of Types that has not answered within the Percentile of the latencies of
+     * its last Window answers, and at least MinDelay, is sent again, to the Backend of "Routing"
+     * if one is named or else to the same backend. The first answer holding json is taken and
+     * the other request is cancelled. Nothing is sent again before MinSamples latencies are
+     * known, and no more than Budget of the requests of the Types are sent twice.
+     *
+     * Without "Hedging" no request is sent twice. Latencies in ms, used by the LLM thread only.
+     */
+    class LLMHedger {
+    public:
+        void configure(const nlohmann::json &config, const LLMRouter &router);
+
+        /// Wait before a request of the type is sent again, negative when it is not, counts the request
+        double delay(AskModel type);
+
+        /// Whether the budget leaves room for one more second request, which is then counted
+        bool spend();
+
+        /// Backend for the second request of one sent to backend
+        int backendFor(int backend) const { return this->_backend >= 0 ? this->_backend : backend; }
+
+        /// Latency of a request of the type that answered, or how long one cancelled before it did had run
+        void observe(AskModel type, double latency);
+
+        /// How much longer a request of the type is expected to take once it ran for elapsed
+        double expectedRest(AskModel type, double elapsed) const;
+
+    private:
+        std::set<AskModel> _types;
+        std::map<AskModel, std::deque<double>> _latencies;
+        double _percentile = 0.9;
+        double _minDelay = 1000.0;
+        size_t _minSamples = 10;
+        size_t _window = 50;
+        double _budget = 0.1;
+        int _backend = -1;
+        uint64_t _requests = 0;
+        uint64_t _hedged = 0;
+    };
+
+}
+
+#endif //LLMHedger_H_
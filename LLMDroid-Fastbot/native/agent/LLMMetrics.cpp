@@ -0,0 +1,265 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMMetrics_CPP_
+#define LLMMetrics_CPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "LLMMetrics.h"
+#include "GPTAgent.h"
+#include "../Tracer.h"
+
+namespace fastbotx {
+
+    static_assert(static_cast<int>(AskModel::REANALYSIS) == 5, "LLMMetrics::Types must cover AskModel");
+
+    void LogHistogram::add(double value) {
+        value = std::max(0.0, value);
+        // zero on its own, (0, 1) next, then SubBuckets to each power of two
+        int bucket = 0;
+        if (value >= 1.0)
+            bucket = std::min(Buckets - 1, 2 + static_cast<int>(std::log2(value) * SubBuckets));
+        else if (value > 0.0)
+            bucket = 1;
+        this->_buckets[bucket]++;
+        this->_min = this->_count == 0 ? value : std::min(this->_min, value);
+        this->_max = this->_count == 0 ? value : std::max(this->_max, value);
+        this->_count++;
+        this->_sum += value;
+    }
+
+    double LogHistogram::percentile(double p) const {
+        if (this->_count == 0)
+            return 0.0;
+        auto rank = static_cast<uint64_t>(std::ceil(p * static_cast<double>(this->_count)));
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (int bucket = 0; bucket < Buckets; bucket++) {
+            seen += this->_buckets[bucket];
+            if (seen >= rank) {
+                double upper = bucket < 2 ? bucket : std::exp2(static_cast<double>(bucket - 1) / SubBuckets);
+                return std::max(this->_min, std::min(upper, this->_max));
+            }
+        }
+        return this->_max;
+    }
+
+    nlohmann::json LogHistogram::toJson() const {
+        return {{"count", this->_count},
+                {"sum",   this->_sum},
+                {"min",   this->_min},
+                {"max",   this->_max},
+                {"p50",   percentile(0.5)},
+                {"p95",   percentile(0.95)},
+                {"p99",   percentile(0.99)}};
+    }
+
+    LLMMetrics &LLMMetrics::inst() {
+        // never destroyed, the LLM thread is detached and may still report at exit
+        static LLMMetrics *metrics = [] {
+            auto created = new LLMMetrics();
+            created->_start = Tracer::now();
+            std::atexit([] { LLMMetrics::inst().finish(); });
+            return created;
+        }();
+        return *metrics;
+    }
+
+    void LLMMetrics::configure(const nlohmann::json &config) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_path = config.value("File", std::string("/sdcard/llm-metrics.json"));
+        this->_interval = static_cast<int64_t>(config.value("Interval", 30.0) * 1000000.0);
+        callJavaLogger(MAIN_THREAD, "[LLMMetrics] snapshot to %s", this->_path.c_str());
+    }
+
+    void LLMMetrics::request(AskModel type, double latency, int retries, int promptTokens, int completionTokens,
+                             int cachedTokens) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        TypeMetrics &metrics = this->_types[static_cast<int>(type)];
+        metrics.latency.add(latency);
+        metrics.retries.add(retries);
+        metrics.promptTokens.add(promptTokens);
+        metrics.completionTokens.add(completionTokens);
+        metrics.cachedTokens.add(cachedTokens);
+        if (cachedTokens > 0)
+            metrics.cacheHits++;
+    }
+
+    void LLMMetrics::question(AskModel type, int64_t enqueued, int64_t begin, int64_t end) {
+        nlohmann::json due;
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            TypeMetrics &metrics = this->_types[static_cast<int>(type)];
+            metrics.queueWait.add(static_cast<double>(begin - enqueued) / 1000.0);
+            // the part of the question the main thread spent waiting
+            if (this->_waitBegin > 0) {
+                int64_t blocked = std::min(end, this->_waitEnd > 0 ? this->_waitEnd : end) -
+                                  std::max(begin, this->_waitBegin);
+                if (blocked > 0) {
+                    metrics.mainBlocked.add(static_cast<double>(blocked) / 1000.0);
+                    this->_mainWaitAttributed += blocked;
+                }
+            }
+            if (!this->_path.empty() && end - this->_lastSnapshot >= this->_interval) {
+                this->_lastSnapshot = end;
+                due = snapshotLocked(end);
+            }
+        }
+        if (!due.is_null())
+            writeSnapshot(due);
+    }
+
+    void LLMMetrics::queued(size_t depth) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_queueDepth.add(static_cast<double>(depth));
+    }
+
+    void LLMMetrics::coalesced(AskModel type) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_types[static_cast<int>(type)].coalesced++;
+    }
+
+    void LLMMetrics::cancelled(AskModel type) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_types[static_cast<int>(type)].cancelled++;
+    }
+
+    void LLMMetrics::abandoned(AskModel type) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_types[static_cast<int>(type)].abandoned++;
+    }
+
+    void LLMMetrics::batched(AskModel type, int64_t enqueued, int64_t begin) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        TypeMetrics &metrics = this->_types[static_cast<int>(type)];
+        metrics.batched++;
+        metrics.queueWait.add(static_cast<double>(begin - enqueued) / 1000.0);
+    }
+
+    void LLMMetrics::hedged(AskModel type, bool won, double saved) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        TypeMetrics &metrics = this->_types[static_cast<int>(type)];
+        metrics.hedged++;
+        if (won) {
+            metrics.hedgeWins++;
+            metrics.hedgeSaved.add(saved);
+        }
+    }
+
+    void LLMMetrics::beginMainWait() {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_waitBegin = Tracer::now();
+        this->_waitEnd = 0;
+    }
+
+    void LLMMetrics::endMainWait() {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_waitEnd = Tracer::now();
+        this->_mainWaitTotal += this->_waitEnd - this->_waitBegin;
+    }
+
+    nlohmann::json LLMMetrics::snapshot() {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        return snapshotLocked(Tracer::now());
+    }
+
+    nlohmann::json LLMMetrics::snapshotLocked(int64_t now) const {
+        nlohmann::json types = nlohmann::json::object();
+        for (int type = 0; type < Types; type++) {
+            const TypeMetrics &metrics = this->_types[type];
+            if (metrics.latency.count() == 0 && metrics.queueWait.count() == 0 && metrics.coalesced == 0 &&
+                metrics.cancelled == 0 && metrics.abandoned == 0 && metrics.batched == 0)
+                continue;
+            // share of the prompt tokens the provider served from its prefix cache
+            double cachedShare = metrics.promptTokens.sum() > 0.0 ?
+                                 metrics.cachedTokens.sum() / metrics.promptTokens.sum() : 0.0;
+            types[askModelName(static_cast<AskModel>(type))] = {
+                    {"calls",            metrics.latency.count()},
+                    {"cacheHits",        metrics.cacheHits},
+                    {"cachedShare",      cachedShare},
+                    {"coalesced",        metrics.coalesced},
+                    {"cancelled",        metrics.cancelled},
+                    {"abandoned",        metrics.abandoned},
+                    {"batched",          metrics.batched},
+                    {"hedged",           metrics.hedged},
+                    {"hedgeWins",        metrics.hedgeWins},
+                    {"hedgeSavedMs",     metrics.hedgeSaved.toJson()},
+                    {"latencyMs",        metrics.latency.toJson()},
+                    {"queueWaitMs",      metrics.queueWait.toJson()},
+                    {"retries",          metrics.retries.toJson()},
+                    {"promptTokens",     metrics.promptTokens.toJson()},
+                    {"completionTokens", metrics.completionTokens.toJson()},
+                    {"cachedTokens",     metrics.cachedTokens.toJson()},
+                    {"mainBlockedMs",    metrics.mainBlocked.toJson()}};
+        }
+        int64_t mainWait = this->_mainWaitTotal;
+        if (this->_waitBegin > 0 && this->_waitEnd == 0)
+            mainWait += now - this->_waitBegin;
+        int64_t unattributed = std::max<int64_t>(0, mainWait - this->_mainWaitAttributed);
+        return {{"uptimeMs",                  static_cast<double>(now - this->_start) / 1000.0},
+                {"mainBlockedMs",             static_cast<double>(mainWait) / 1000.0},
+                {"mainBlockedUnattributedMs", static_cast<double>(unattributed) / 1000.0},
+                {"queueDepth",                this->_queueDepth.toJson()},
+                {"types",                     types}};
+    }
+
+    void LLMMetrics::writeSnapshot(const nlohmann::json &snapshot) {
+        // written aside and renamed, readers never see half a snapshot
+        std::string temporary = this->_path + ".tmp";
+        FILE *file = fopen(temporary.c_str(), "w");
+        if (!file) {
+            BLOGE("can not open llm metrics file %s", temporary.c_str());
+            return;
+        }
+        std::string content = snapshot.dump();
+        fwrite(content.data(), 1, content.size(), file);
+        fclose(file);
+        rename(temporary.c_str(), this->_path.c_str());
+    }
+
+    void LLMMetrics::finish() {
+        nlohmann::json last;
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            if (this->_finished)
+                return;
+            this->_finished = true;
+            last = snapshotLocked(Tracer::now());
+        }
+        if (!this->_path.empty())
+            writeSnapshot(last);
+
+        char line[256];
+        snprintf(line, sizeof(line), "%-15s %6s %9s %9s %9s %9s %7s %10s %10s %7s %10s", "question(ms)", "calls",
+                 "p50", "p95", "p99", "queueP50", "retries", "prompt", "completion", "cached%", "blocked");
+        callJavaLogger(MAIN_THREAD, "[LLMMetrics] %s", line);
+        for (auto &entry: last["types"].items()) {
+            const nlohmann::json &type = entry.value();
+            snprintf(line, sizeof(line), "%-15s %6llu %9.0f %9.0f %9.0f %9.0f %7.0f %10.0f %10.0f %7.1f %10.0f",
+                     entry.key().c_str(), type["calls"].get<unsigned long long>(),
+                     type["latencyMs"]["p50"].get<double>(), type["latencyMs"]["p95"].get<double>(),
+                     type["latencyMs"]["p99"].get<double>(), type["queueWaitMs"]["p50"].get<double>(),
+                     type["retries"]["sum"].get<double>(), type["promptTokens"]["sum"].get<double>(),
+                     type["completionTokens"]["sum"].get<double>(), type["cachedShare"].get<double>() * 100.0,
+                     type["mainBlockedMs"]["sum"].get<double>());
+            callJavaLogger(MAIN_THREAD, "[LLMMetrics] %s", line);
+        }
+        for (auto &entry: last["types"].items()) {
+            const nlohmann::json &type = entry.value();
+            if (type["hedged"].get<uint64_t>() == 0)
+                continue;
+            callJavaLogger(MAIN_THREAD, "[LLMMetrics] %s sent %llu requests twice, the second answered first %llu times, "
+                                        "about %.0f ms of tail latency saved", entry.key().c_str(),
+                           type["hedged"].get<unsigned long long>(), type["hedgeWins"].get<unsigned long long>(),
+                           type["hedgeSavedMs"]["sum"].get<double>());
+        }
+        callJavaLogger(MAIN_THREAD, "[LLMMetrics] main thread blocked %.0f ms on the llm, %.0f ms of it on no question",
+                       last["mainBlockedMs"].get<double>(), last["mainBlockedUnattributedMs"].get<double>());
+    }
+
+}
+
+#endif //LLMMetrics_CPP_
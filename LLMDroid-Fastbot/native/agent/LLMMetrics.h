@@ -0,0 +1,151 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMMetrics_H_
+#define LLMMetrics_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "../thirdpart/json/json.hpp"
+
+namespace fastbotx {
+
+    enum class AskModel;
+
+    /// Count, sum, min, max and approximate percentiles of values >= 0 in constant space,
+    /// with buckets 4 to each power of two (about 19% wide)
+    class LogHistogram {
+    public:
+        void add(double value);
+
+        uint64_t count() const { return this->_count; }
+
+        double sum() const { return this->_sum; }
+
+        /// Upper bound of the bucket holding the p-th value, no more than the max
+        double percentile(double p) const;
+
+        /// {"count", "sum", "min", "max", "p50", "p95", "p99"}
+        nlohmann::json toJson() const;
+
+    private:
+        static const int SubBuckets = 4;
+        static const int Buckets = 2 + 48 * SubBuckets;
+
+        uint32_t _buckets[Buckets]{};
+        uint64_t _count = 0;
+        double _sum = 0.0;
+        double _min = 0.0;
+        double _max = 0.0;
+    };
+
+    /**
+     * @brief Where the time and tokens of the LLM go, per question type: latency, queue wait,
+     * retries, prompt, completion and cached prompt tokens, questions coalesced, dropped or
+     * batched in the queue, requests sent twice and the latency that saved, and how long the
+     * main thread was blocked on the answers.
+     *
+     * A snapshot is written as JSON to the file of "Metrics" in config.json every "Interval"
+     * seconds while questions are answered, and a summary is logged when the process exits.
+     */
+    class LLMMetrics {
+    public:
+        static LLMMetrics &inst();
+
+        /// "Metrics" of config.json: {"File": "/sdcard/llm-metrics.json", "Interval": 30}
+        void configure(const nlohmann::json &config);
+
+        /// A request to the LLM, latency in ms, retries after a failed attempt
+        void request(AskModel type, double latency, int retries, int promptTokens, int completionTokens,
+                     int cachedTokens);
+
+        /// A question done by the LLM thread, enqueued, begun and ended at Tracer::now()
+        void question(AskModel type, int64_t enqueued, int64_t begin, int64_t end);
+
+        /// A question was queued, leaving depth questions in the queue
+        void queued(size_t depth);
+
+        /// A question was merged into the same one already queued
+        void coalesced(AskModel type);
+
+        /// A queued question was dropped as stale
+        void cancelled(AskModel type);
+
+        /// The main thread stopped waiting for the answer and decided without the LLM
+        void abandoned(AskModel type);
+
+        /// A queued question taken at begin to be asked in the request of another one
+        void batched(AskModel type, int64_t enqueued, int64_t begin);
+
+        /// A request was sent a second time, won if the second answered first, saving about saved ms
+        void hedged(AskModel type, bool won, double saved);
+
+        /// The main thread waits on the LLM from now, see LLMMainWait
+        void beginMainWait();
+
+        void endMainWait();
+
+        nlohmann::json snapshot();
+
+        /// Write the snapshot and log the summary, once
+        void finish();
+
+    private:
+        static const int Types = 6;
+
+        struct TypeMetrics {
+            uint64_t cacheHits = 0;
+            uint64_t coalesced = 0;
+            uint64_t cancelled = 0;
+            uint64_t abandoned = 0;
+            uint64_t batched = 0;
+            uint64_t hedged = 0;
+            uint64_t hedgeWins = 0;
+            LogHistogram latency;
+            LogHistogram queueWait;
+            LogHistogram retries;
+            LogHistogram promptTokens;
+            LogHistogram completionTokens;
+            LogHistogram cachedTokens;
+            LogHistogram mainBlocked;
+            LogHistogram hedgeSaved;
+        };
+
+        LLMMetrics() = default;
+
+        nlohmann::json snapshotLocked(int64_t now) const;
+
+        void writeSnapshot(const nlohmann::json &snapshot);
+
+        std::mutex _mutex;
+        TypeMetrics _types[Types];
+        LogHistogram _queueDepth;
+        int64_t _start = 0;
+        std::string _path;
+        int64_t _interval = 30 * 1000000LL;
+        int64_t _lastSnapshot = 0;
+        bool _finished = false;
+
+        // the last main thread wait, _waitEnd is 0 while waiting
+        int64_t _waitBegin = 0;
+        int64_t _waitEnd = 0;
+        int64_t _mainWaitTotal = 0;
+        int64_t _mainWaitAttributed = 0;
+    };
+
+    /// Counts the main thread as blocked on the LLM until the end of the scope
+    class LLMMainWait {
+    public:
+        LLMMainWait() { LLMMetrics::inst().beginMainWait(); }
+
+        ~LLMMainWait() { LLMMetrics::inst().endMainWait(); }
+
+        LLMMainWait(const LLMMainWait &) = delete;
+
+        LLMMainWait &operator=(const LLMMainWait &) = delete;
+    };
+
+}
+
+#endif //LLMMetrics_H_
@@ -0,0 +1,152 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMRateLimiter_CPP_
+#define LLMRateLimiter_CPP_
+
+#include <algorithm>
+#include <cstdlib>
+#include "LLMRateLimiter.h"
+
+namespace fastbotx {
+
+    // weight of the newest usage in the smoothed tokens of a question type
+    static const double UsageWeight = 0.2;
+
+    /// The number a header field starts with, false if there is none
+    static bool headerValue(const std::map<std::string, std::string> &headers, const std::string &field, double &value) {
+        auto found = headers.find(field);
+        if (found == headers.end())
+            return false;
+        const char *begin = found->second.c_str();
+        char *end = nullptr;
+        value = std::strtod(begin, &end);
+        return end != begin && value >= 0.0;
+    }
+
+    static void smooth(std::map<AskModel, double> &smoothed, AskModel type, double value) {
+        auto found = smoothed.find(type);
+        if (found == smoothed.end())
+            smoothed[type] = value;
+        else
+            found->second += UsageWeight * (value - found->second);
+    }
+
+    void LLMRateLimiter::Bucket::refill(double now) {
+        if (this->limit > 0.0 && now > this->updated)
+            this->level = std::min(this->limit, this->level + (now - this->updated) * this->limit / 60000.0);
+        this->updated = now;
+    }
+
+    void LLMRateLimiter::Bucket::spend(double amount, double now) {
+        if (this->limit <= 0.0)
+            return;
+        this->refill(now);
+        this->level = std::min(this->limit, this->level - amount);
+    }
+
+    double LLMRateLimiter::Bucket::waitFor(double amount) const {
+        if (this->limit <= 0.0)
+            return 0.0;
+        // more than the limit goes once the bucket is full
+        amount = std::min(amount, this->limit);
+        return this->level >= amount ? 0.0 : (amount - this->level) * 60000.0 / this->limit;
+    }
+
+    void LLMRateLimiter::Bucket::update(const std::map<std::string, std::string> &headers, const std::string &name,
+                                        double now) {
+        double limit = 0.0;
+        if (!this->configured && headerValue(headers, "x-ratelimit-limit-" + name, limit) && limit > 0.0) {
+            if (this->limit <= 0.0) {
+                callJavaLogger(CHILD_THREAD, "[LLMRateLimiter] the provider allows %.0f %s per minute", limit,
+                               name.c_str());
+                this->level = limit;
+                this->updated = now;
+            }
+            this->limit = limit;
+            this->refill(now);
+        }
+        double remaining = 0.0;
+        if (this->limit > 0.0 && headerValue(headers, "x-ratelimit-remaining-" + name, remaining)) {
+            this->refill(now);
+            this->level = std::min(this->level, remaining);
+        }
+    }
+
+    void LLMRateLimiter::configure(const nlohmann::json &config, size_t backends) {
+        this->_enabled = true;
+        this->_reserve = std::min(std::max(config.value("Reserve", this->_reserve), 0.0), 0.9);
+        Budget budget;
+        budget.requests.limit = std::max(0.0, config.value("RequestsPerMinute", 0.0));
+        budget.tokens.limit = std::max(0.0, config.value("TokensPerMinute", 0.0));
+        budget.requests.configured = budget.requests.limit > 0.0;
+        budget.tokens.configured = budget.tokens.limit > 0.0;
+        // start full
+        budget.requests.level = budget.requests.limit;
+        budget.tokens.level = budget.tokens.limit;
+        this->_budgets.assign(backends, budget);
+        callJavaLogger(MAIN_THREAD, "[LLMRateLimiter] %.0f requests and %.0f tokens per minute (0 from the headers), "
+                                    "%.0f%% kept for the main thread", budget.requests.limit, budget.tokens.limit,
+                       this->_reserve * 100.0);
+    }
+
+    double LLMRateLimiter::wait(int backend, AskModel type, double now) {
+        if (!this->_enabled || mainWaitsFor(type))
+            return 0.0;
+        Budget &budget = this->_budgets[backend];
+        budget.requests.refill(now);
+        budget.tokens.refill(now);
+        auto tokens = this->_tokens.find(type);
+        double needed = tokens != this->_tokens.end() ? tokens->second : 0.0;
+        return std::max(budget.requests.waitFor(1.0 + this->_reserve * budget.requests.limit),
+                        budget.tokens.waitFor(needed + this->_reserve * budget.tokens.limit));
+    }
+
+    double LLMRateLimiter::estimate(AskModel type, double promptTokens) const {
+        auto completion = this->_completion.find(type);
+        return promptTokens + (completion != this->_completion.end() ? completion->second : 0.0);
+    }
+
+    void LLMRateLimiter::take(int backend, double tokens, double now) {
+        if (!this->_enabled)
+            return;
+        Budget &budget = this->_budgets[backend];
+        budget.requests.spend(1.0, now);
+        budget.tokens.spend(tokens, now);
+    }
+
+    void LLMRateLimiter::settle(int backend, AskModel type, double estimated, int promptTokens, int completionTokens,
+                                const std::map<std::string, std::string> &headers, double now) {
+        if (!this->_enabled)
+            return;
+        Budget &budget = this->_budgets[backend];
+        if (promptTokens + completionTokens > 0) {
+            double used = promptTokens + completionTokens;
+            budget.tokens.spend(used - estimated, now);
+            smooth(this->_tokens, type, used);
+            smooth(this->_completion, type, completionTokens);
+        }
+        budget.requests.update(headers, "requests", now);
+        budget.tokens.update(headers, "tokens", now);
+    }
+
+    void LLMRateLimiter::release(int backend, double tokens, double now) {
+        if (!this->_enabled)
+            return;
+        // the request itself still counts, the provider saw it
+        this->_budgets[backend].tokens.spend(-tokens, now);
+    }
+
+    void LLMRateLimiter::limited(int backend, double now) {
+        if (!this->_enabled)
+            return;
+        Budget &budget = this->_budgets[backend];
+        budget.requests.refill(now);
+        budget.tokens.refill(now);
+        budget.requests.level = std::min(budget.requests.level, 0.0);
+        budget.tokens.level = std::min(budget.tokens.level, 0.0);
+    }
+
+}
+
+#endif //LLMRateLimiter_CPP_
@@ -0,0 +1,96 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMRateLimiter_H_
+#define LLMRateLimiter_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "QuestionScheduler.h"
+#include "../thirdpart/json/json.hpp"
+
+namespace fastbotx {
+
+    /**
+     * @brief Paces the requests to stay within the requests and tokens per minute of the provider,
+     * instead of running into 429s when overviews pile up.
+     *
+     * Configured by "RateLimit" in config.json:
+     *   {"RequestsPerMinute": 500, "TokensPerMinute": 200000, "Reserve": 0.2}
+     *
+     * Each backend has a bucket of requests and one of tokens, refilled evenly over a minute up to
+     * the limit. A limit not set is taken from the x-ratelimit-limit-* headers of the answers, and
+     * their x-ratelimit-remaining-* bring a bucket down when the provider counts less left, other
+     * clients of the same key included. A request takes one request and its prompt tokens, about
+     * four characters a token, plus the completion tokens its question type averaged. The usage
+     * of the answer settles the difference, a request that failed or was cancelled gives its
+     * tokens back, and a 429 empties both buckets.
+     *
+     * The question types the main thread waits on are sent whatever the buckets hold, and may run
+     * them into debt. The others stay queued until the buckets hold their request with Reserve of
+     * the limits left over for the blocking ones.
+     *
+     * Without "RateLimit" nothing is paced. Timestamps are currentStamp() milliseconds, used by the
+     * LLM thread only.
+     */
+    class LLMRateLimiter {
+    public:
+        void configure(const nlohmann::json &config, size_t backends);
+
+        bool enabled() const { return this->_enabled; }
+
+        /// Milliseconds before a question of the type may be sent to the backend, 0 if now
+        double wait(int backend, AskModel type, double now);
+
+        /// Tokens a request of the type with a prompt of about promptTokens is expected to use
+        double estimate(AskModel type, double promptTokens) const;
+
+        /// A request expected to use tokens is sent to the backend
+        void take(int backend, double tokens, double now);
+
+        /// The backend answered a request that took estimated tokens with the usage and response headers
+        void settle(int backend, AskModel type, double estimated, int promptTokens, int completionTokens,
+                    const std::map<std::string, std::string> &headers, double now);
+
+        /// A request that took tokens failed or was cancelled, the tokens are given back
+        void release(int backend, double tokens, double now);
+
+        /// The backend answered 429
+        void limited(int backend, double now);
+
+    private:
+        struct Bucket {
+            double limit = 0.0; // per minute, none if 0
+            double level = 0.0; // below 0 while in debt
+            double updated = 0.0;
+            bool configured = false; // the limit is not taken from the headers
+
+            void refill(double now);
+
+            /// Takes amount at now, gives back when negative, nothing while there is no limit
+            void spend(double amount, double now);
+
+            /// Milliseconds until the bucket holds amount
+            double waitFor(double amount) const;
+
+            /// x-ratelimit-limit-<name> and x-ratelimit-remaining-<name> of a response
+            void update(const std::map<std::string, std::string> &headers, const std::string &name, double now);
+        };
+
+        struct Budget {
+            Bucket requests;
+            Bucket tokens;
+        };
+
+        std::vector<Budget> _budgets;
+        // smoothed tokens a request of the type used, prompt and completion
+        std::map<AskModel, double> _tokens;
+        std::map<AskModel, double> _completion;
+        double _reserve = 0.2;
+        bool _enabled = false;
+    };
+
+}
+
+#endif //LLMRateLimiter_H_
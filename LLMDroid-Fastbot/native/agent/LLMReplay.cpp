@@ -0,0 +1,217 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMReplay_CPP_
+#define LLMReplay_CPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include "LLMReplay.h"
+#include "GPTAgent.h"
+
+namespace fastbotx {
+
+    static std::string hashToHex(uint64_t hash) {
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016" PRIx64, hash);
+        return hex;
+    }
+
+    void LLMReplay::configure(const nlohmann::json &config) {
+        std::string mode = config.value("Mode", std::string());
+        this->_path = config.value("File", std::string("/sdcard/llm-record.jsonl"));
+        if (mode == "record") {
+            this->_recordFile.open(this->_path, std::ios::out | std::ios::trunc);
+            if (!this->_recordFile.is_open()) {
+                BLOGE("can not open llm record file %s", this->_path.c_str());
+                return;
+            }
+            this->_mode = Mode::RECORD;
+            callJavaLogger(MAIN_THREAD, "[LLMReplay] record llm answers to %s", this->_path.c_str());
+            return;
+        }
+        if (mode != "replay") {
+            if (!mode.empty())
+                BLOGE("unknown llm backend mode %s, ask the llm", mode.c_str());
+            return;
+        }
+
+        this->_mode = Mode::REPLAY;
+        this->_random.seed(config.value("Seed", 1));
+        this->_failOnMiss = config.value("Miss", std::string("type")) == "fail";
+        if (config.contains("Latency")) {
+            const nlohmann::json &latency = config["Latency"];
+            std::string distribution = latency.value("Distribution", std::string("recorded"));
+            if (distribution == "none")
+                this->_latency = Latency::NONE;
+            else if (distribution == "fixed")
+                this->_latency = Latency::FIXED;
+            else if (distribution == "uniform")
+                this->_latency = Latency::UNIFORM;
+            else if (distribution == "normal")
+                this->_latency = Latency::NORMAL;
+            else if (distribution == "lognormal")
+                this->_latency = Latency::LOGNORMAL;
+            this->_latencyMean = latency.value("Mean", 0.0);
+            this->_latencyStddev = latency.value("Stddev", 0.0);
+            this->_latencyMin = latency.value("Min", 0.0);
+            this->_latencyMax = latency.value("Max", this->_latencyMin);
+            this->_latencyScale = latency.value("Scale", 1.0);
+        }
+        if (config.contains("Faults")) {
+            const nlohmann::json &faults = config["Faults"];
+            this->_errorRate = faults.value("ErrorRate", 0.0);
+            this->_malformedRate = faults.value("MalformedRate", 0.0);
+            this->_timeoutRate = faults.value("TimeoutRate", 0.0);
+            this->_timeoutMs = faults.value("TimeoutMs", 30000);
+        }
+        load();
+    }
+
+    void LLMReplay::load() {
+        std::ifstream file(this->_path);
+        if (!file.is_open()) {
+            BLOGE("can not open llm record file %s, nothing to replay", this->_path.c_str());
+            return;
+        }
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            if (line.empty())
+                continue;
+            try {
+                nlohmann::json entry = nlohmann::json::parse(line);
+                LLMExchange exchange;
+                if (!askModelFromName(entry.value("type", std::string()), exchange.type)) {
+                    BLOGE("llm record line %d: unknown question type", lineNumber);
+                    continue;
+                }
+                exchange.promptHash = std::stoull(entry.value("hash", std::string("0")), nullptr, 16);
+                exchange.model = entry.value("model", std::string());
+                exchange.response = entry.value("response", std::string());
+                exchange.promptTokens = entry.value("prompt_tokens", 0);
+                exchange.completionTokens = entry.value("completion_tokens", 0);
+                exchange.cachedTokens = entry.value("cached_tokens", 0);
+                exchange.latency = entry.value("latency", 0.0);
+                size_t index = this->_exchanges.size();
+                int type = static_cast<int>(exchange.type);
+                this->_byPrompt[{type, exchange.promptHash}].first.push_back(index);
+                this->_byType[type].first.push_back(index);
+                this->_exchanges.push_back(std::move(exchange));
+            } catch (const std::exception &e) {
+                BLOGE("llm record line %d: %s", lineNumber, e.what());
+            }
+        }
+        callJavaLogger(MAIN_THREAD, "[LLMReplay] replay %zu llm answers from %s", this->_exchanges.size(),
+                       this->_path.c_str());
+    }
+
+    void LLMReplay::record(const LLMExchange &exchange) {
+        if (this->_mode != Mode::RECORD)
+            return;
+        nlohmann::json entry;
+        entry["type"] = askModelName(exchange.type);
+        entry["hash"] = hashToHex(exchange.promptHash);
+        entry["model"] = exchange.model;
+        entry["response"] = exchange.response;
+        entry["prompt_tokens"] = exchange.promptTokens;
+        entry["completion_tokens"] = exchange.completionTokens;
+        entry["cached_tokens"] = exchange.cachedTokens;
+        entry["latency"] = exchange.latency;
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        // one line each, flushed, so a killed run keeps what it recorded
+        this->_recordFile << entry.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) << std::endl;
+    }
+
+    double LLMReplay::sampleLatency(const LLMExchange &exchange) {
+        double latency = 0.0;
+        switch (this->_latency) {
+            case Latency::RECORDED:
+                latency = exchange.latency * 1000.0;
+                break;
+            case Latency::NONE:
+                break;
+            case Latency::FIXED:
+                latency = this->_latencyMean;
+                break;
+            case Latency::UNIFORM:
+                latency = this->_latencyMin + (this->_latencyMax - this->_latencyMin) * this->_random.nextDouble();
+                break;
+            case Latency::NORMAL:
+                latency = std::normal_distribution<double>(this->_latencyMean, this->_latencyStddev)(this->_random);
+                break;
+            case Latency::LOGNORMAL: {
+                // parameters of the underlying normal from the mean and deviation of the latency itself
+                double mean = std::max(this->_latencyMean, 1e-3);
+                double variance = this->_latencyStddev * this->_latencyStddev;
+                double sigma2 = std::log(1.0 + variance / (mean * mean));
+                latency = std::lognormal_distribution<double>(std::log(mean) - sigma2 / 2.0,
+                                                              std::sqrt(sigma2))(this->_random);
+                break;
+            }
+        }
+        return std::max(0.0, latency * this->_latencyScale);
+    }
+
+    LLMExchange LLMReplay::replay(AskModel type, const std::string &prompt) {
+        uint64_t hash = promptHash(prompt);
+        LLMExchange exchange;
+        double latency;
+        bool error;
+        bool timeout;
+        bool malformed;
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            int typeKey = static_cast<int>(type);
+            auto recorded = this->_byPrompt.find({typeKey, hash});
+            std::pair<std::vector<size_t>, size_t> *answers = nullptr;
+            if (recorded != this->_byPrompt.end()) {
+                answers = &recorded->second;
+            } else {
+                this->_missed++;
+                auto sameType = this->_byType.find(typeKey);
+                if (this->_failOnMiss || sameType == this->_byType.end()) {
+                    throw std::runtime_error(std::string("no recorded answer for ") + askModelName(type) +
+                                             " prompt " + hashToHex(hash));
+                }
+                answers = &sameType->second;
+                callJavaLogger(CHILD_THREAD, "[LLMReplay] %s prompt %s was not recorded, %d of %d missed",
+                               askModelName(type), hashToHex(hash).c_str(), this->_missed, this->_served + 1);
+            }
+            // in recorded order, over again once all were served
+            exchange = this->_exchanges[answers->first[answers->second % answers->first.size()]];
+            answers->second++;
+            this->_served++;
+            latency = sampleLatency(exchange);
+            double fault = this->_random.nextDouble();
+            error = fault < this->_errorRate;
+            timeout = !error && fault < this->_errorRate + this->_timeoutRate;
+            malformed = !error && !timeout &&
+                        fault < this->_errorRate + this->_timeoutRate + this->_malformedRate;
+        }
+        if (timeout) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(this->_timeoutMs));
+            throw std::runtime_error("injected timeout");
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(latency * 1000.0)));
+        if (error)
+            throw std::runtime_error("injected error");
+        if (malformed) {
+            size_t end = exchange.response.rfind('}');
+            exchange.response = exchange.response.substr(0, end == std::string::npos ? 0 : end);
+        }
+        exchange.promptHash = hash;
+        exchange.latency = latency / 1000.0;
+        return exchange;
+    }
+
+}
+
+#endif //LLMReplay_CPP_
@@ -0,0 +1,110 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMReplay_H_
+#define LLMReplay_H_
+
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Base.h"
+#include "../thirdpart/json/json.hpp"
+
+namespace fastbotx {
+
+    enum class AskModel;
+
+    /// One question to the LLM and its answer, a line of the record file
+    struct LLMExchange {
+        AskModel type;
+        uint64_t promptHash = 0;
+        std::string model;
+        std::string response;
+        int promptTokens = 0;
+        int completionTokens = 0;
+        int cachedTokens = 0; // prompt tokens the provider served from its cache
+        double latency = 0.0; // seconds
+    };
+
+    /**
+     * @brief Records the answers of the LLM and plays them back without network, so runs can be
+     * repeated and measured offline.
+     *
+     * Configured by "Backend" in config.json:
+     *   {"Mode": "record" | "replay", "File": "/sdcard/llm-record.jsonl", "Seed": 1,
+     *    "Miss": "type" | "fail",
+     *    "Latency": {"Distribution": "recorded" | "none" | "fixed" | "uniform" | "normal" | "lognormal",
+     *                "Mean": ms, "Stddev": ms, "Min": ms, "Max": ms, "Scale": 1.0},
+     *    "Faults": {"ErrorRate": 0.0, "MalformedRate": 0.0, "TimeoutRate": 0.0, "TimeoutMs": 30000}}
+     *
+     * A replayed question gets the answers recorded for the same type and prompt, in recorded order.
+     * When the run went elsewhere and the prompt was never recorded, "Miss": "type" serves the
+     * answers recorded for the type in turn, "fail" fails the question.
+     */
+    class LLMReplay {
+    public:
+        enum class Mode {
+            OFF, RECORD, REPLAY
+        };
+
+        void configure(const nlohmann::json &config);
+
+        Mode mode() const { return this->_mode; }
+
+        bool replaying() const { return this->_mode == Mode::REPLAY; }
+
+        static uint64_t promptHash(const std::string &prompt) { return fastHash(prompt); }
+
+        /// Appends the exchange to the record file, when recording
+        void record(const LLMExchange &exchange);
+
+        /**
+         * @brief Answer the question from the record, after the configured latency.
+         * Injected errors and timeouts, and questions that can not be answered, throw
+         * std::runtime_error, like a failed request. An injected malformed answer is cut short
+         * so that it does not parse.
+         */
+        LLMExchange replay(AskModel type, const std::string &prompt);
+
+    private:
+        enum class Latency {
+            RECORDED, NONE, FIXED, UNIFORM, NORMAL, LOGNORMAL
+        };
+
+        Mode _mode = Mode::OFF;
+        std::string _path;
+        std::ofstream _recordFile;
+        std::mutex _mutex;
+
+        std::vector<LLMExchange> _exchanges;
+        // (type, prompt hash) and type alone to the recorded exchanges, with the next one to serve
+        std::map<std::pair<int, uint64_t>, std::pair<std::vector<size_t>, size_t>> _byPrompt;
+        std::map<int, std::pair<std::vector<size_t>, size_t>> _byType;
+        bool _failOnMiss = false;
+        int _served = 0;
+        int _missed = 0;
+
+        FastRandom _random;
+        Latency _latency = Latency::RECORDED;
+        double _latencyMean = 0.0;
+        double _latencyStddev = 0.0;
+        double _latencyMin = 0.0;
+        double _latencyMax = 0.0;
+        double _latencyScale = 1.0;
+        double _errorRate = 0.0;
+        double _malformedRate = 0.0;
+        double _timeoutRate = 0.0;
+        int _timeoutMs = 30000;
+
+        void load();
+
+        /// in milliseconds
+        double sampleLatency(const LLMExchange &exchange);
+    };
+
+}
+
+#endif //LLMReplay_H_
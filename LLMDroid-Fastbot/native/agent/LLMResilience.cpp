@@ -0,0 +1,87 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMResilience_CPP_
+#define LLMResilience_CPP_
+
+#include <algorithm>
+#include <cmath>
+#include "LLMResilience.h"
+
+namespace fastbotx {
+
+    LLMResilience::LLMResilience() : _random(timeRandomSeed()) {
+    }
+
+    void LLMResilience::configure(const nlohmann::json &config) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_deadline = config.value("Deadline", this->_deadline / 1000.0) * 1000.0;
+        this->_attempts = std::max(1, config.value("Attempts", this->_attempts));
+        this->_baseDelay = config.value("BaseDelay", this->_baseDelay / 1000.0) * 1000.0;
+        this->_maxDelay = std::max(this->_baseDelay, config.value("MaxDelay", this->_maxDelay / 1000.0) * 1000.0);
+        this->_parseRetries = std::max(0, config.value("ParseRetries", this->_parseRetries));
+        this->_guideWait = config.value("GuideWait", this->_guideWait / 1000.0) * 1000.0;
+        this->_actionWait = config.value("ActionWait", this->_actionWait / 1000.0) * 1000.0;
+        this->_breakerFailures = std::max(1, config.value("BreakerFailures", this->_breakerFailures));
+        this->_breakerCooldown = config.value("BreakerCooldown", this->_breakerCooldown / 1000.0) * 1000.0;
+        this->_breakerMaxCooldown = std::max(this->_breakerCooldown,
+                                             config.value("BreakerMaxCooldown",
+                                                          this->_breakerMaxCooldown / 1000.0) * 1000.0);
+        this->_cooldown = this->_breakerCooldown;
+        callJavaLogger(MAIN_THREAD, "[LLMResilience] deadline %.0fs, %d attempts, breaker after %d failures",
+                       this->_deadline / 1000.0, this->_attempts, this->_breakerFailures);
+    }
+
+    double LLMResilience::backoff(int retry, double retryAfter) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        // full jitter, retries of questions that failed together do not line up again
+        double ceiling = std::min(this->_maxDelay, this->_baseDelay * std::exp2(std::min(retry - 1, 30)));
+        double delay = ceiling * this->_random.nextDouble();
+        if (retryAfter >= 0.0)
+            delay = std::max(delay, retryAfter * 1000.0);
+        return delay;
+    }
+
+    bool LLMResilience::allowRequest(double now) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        if (this->_breaker == Breaker::CLOSED)
+            return true;
+        // half open while the probe is out, the others wait for its onSuccess or onFailure
+        if (this->_breaker == Breaker::HALF_OPEN || now < this->_openUntil)
+            return false;
+        this->_breaker = Breaker::HALF_OPEN;
+        callJavaLogger(CHILD_THREAD, "[LLMResilience] probe the llm backend");
+        return true;
+    }
+
+    bool LLMResilience::available(double now) const {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        return this->_breaker != Breaker::OPEN || now >= this->_openUntil;
+    }
+
+    void LLMResilience::onSuccess() {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        if (this->_breaker != Breaker::CLOSED)
+            callJavaLogger(CHILD_THREAD, "[LLMResilience] llm backend is back, close the breaker");
+        this->_breaker = Breaker::CLOSED;
+        this->_failures = 0;
+        this->_cooldown = this->_breakerCooldown;
+    }
+
+    void LLMResilience::onFailure(double now) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_failures++;
+        if (this->_breaker == Breaker::HALF_OPEN) {
+            this->_cooldown = std::min(this->_breakerMaxCooldown, this->_cooldown * 2.0);
+        } else if (this->_breaker == Breaker::OPEN || this->_failures < this->_breakerFailures) {
+            return;
+        }
+        this->_breaker = Breaker::OPEN;
+        this->_openUntil = now + this->_cooldown;
+        callJavaLogger(CHILD_THREAD, "[LLMResilience] %d llm requests failed in a row, explore without it for %.0fs",
+                       this->_failures, this->_cooldown / 1000.0);
+    }
+
+}
+
+#endif //LLMResilience_CPP_
@@ -0,0 +1,97 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMResilience_H_
+#define LLMResilience_H_
+
+#include <mutex>
+#include "Base.h"
+#include "../thirdpart/json/json.hpp"
+
+namespace fastbotx {
+
+    /**
+     * @brief How long and how often a question is tried before it is given up, and a circuit
+     * breaker that stops asking while the LLM backend keeps failing.
+     *
+     * Configured by "Resilience" in config.json, times in seconds:
+     *   {"Deadline": 180, "Attempts": 5, "BaseDelay": 1, "MaxDelay": 30, "ParseRetries": 2,
+     *    "BreakerFailures": 5, "BreakerCooldown": 60, "BreakerMaxCooldown": 600,
+     *    "GuideWait": 90, "ActionWait": 30}
+     *
+     * A failed request is retried after a delay drawn uniformly below an exponentially growing
+     * ceiling, never shorter than the Retry-After of the server, until the attempts or the
+     * deadline of the question run out. After BreakerFailures failed requests in a row the
+     * breaker opens: questions fail at once and the agent explores on its own. Once the cooldown
+     * passed one request goes through as a probe, success closes the breaker, failure opens it
+     * again for twice as long, up to BreakerMaxCooldown.
+     *
+     * The main thread waits GuideWait for a navigation target and ActionWait for the next action
+     * of a function test, then decides without the LLM.
+     *
+     * Timestamps are currentStamp() milliseconds. Asked by the LLM thread and, for available(),
+     * by the main thread.
+     */
+    class LLMResilience {
+    public:
+        LLMResilience();
+
+        void configure(const nlohmann::json &config);
+
+        /// When a question asked at now is given up
+        double deadline(double now) const { return now + this->_deadline; }
+
+        int attempts() const { return this->_attempts; }
+
+        int parseRetries() const { return this->_parseRetries; }
+
+        /// Milliseconds the main thread waits for a navigation target
+        double guideWait() const { return this->_guideWait; }
+
+        /// Milliseconds the main thread waits for the next action of a function test
+        double actionWait() const { return this->_actionWait; }
+
+        /// Milliseconds to wait before the retry-th retry (from 1), retryAfter in seconds or negative
+        double backoff(int retry, double retryAfter);
+
+        /**
+         * Whether a request may be sent now, the first one after the cooldown is the probe and no
+         * other is until it reports onSuccess() or onFailure(), which every allowed request must
+         */
+        bool allowRequest(double now);
+
+        /// Whether the backend is thought usable, or due to be probed
+        bool available(double now) const;
+
+        void onSuccess();
+
+        void onFailure(double now);
+
+    private:
+        enum class Breaker {
+            CLOSED, OPEN, HALF_OPEN
+        };
+
+        mutable std::mutex _mutex;
+        FastRandom _random;
+
+        double _deadline = 180000.0;
+        int _attempts = 5;
+        double _baseDelay = 1000.0;
+        double _maxDelay = 30000.0;
+        int _parseRetries = 2;
+        double _guideWait = 90000.0;
+        double _actionWait = 30000.0;
+
+        Breaker _breaker = Breaker::CLOSED; // HALF_OPEN while the probe is out
+        int _breakerFailures = 5;
+        double _breakerCooldown = 60000.0;
+        double _breakerMaxCooldown = 600000.0;
+        int _failures = 0; // failed requests in a row
+        double _cooldown = 60000.0;
+        double _openUntil = 0.0;
+    };
+
+}
+
+#endif //LLMResilience_H_
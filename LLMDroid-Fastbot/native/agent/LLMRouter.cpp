@@ -0,0 +1,187 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMRouter_CPP_
+#define LLMRouter_CPP_
+
+#include <algorithm>
+#include "LLMRouter.h"
+
+namespace fastbotx {
+
+    // fewer requests than this say nothing about the error rate of a backend
+    static const size_t MinSamples = 5;
+
+    // weight of the newest latency in the smoothed one
+    static const double LatencySmoothing = 0.3;
+
+    void LLMRouter::configure(const nlohmann::json &config, const LLMBackend &defaults) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_backends.clear();
+        this->_routes.clear();
+        this->_defaultRoute.clear();
+        this->_maxLatency.clear();
+
+        std::map<std::string, int> indexOf;
+        if (config.contains("Backends") && config["Backends"].is_object()) {
+            for (auto &entry: config["Backends"].items()) {
+                const nlohmann::json &backend = entry.value();
+                indexOf[entry.key()] = static_cast<int>(this->_backends.size());
+                this->_backends.push_back({entry.key(), backend.value("Model", defaults.model),
+                                           backend.value("BaseUrl", defaults.baseUrl),
+                                           backend.value("ApiKey", defaults.apiKey)});
+            }
+        }
+        if (this->_backends.empty())
+            this->_backends.push_back(defaults);
+
+        auto chainOf = [&indexOf](const nlohmann::json &names) {
+            std::vector<int> chain;
+            for (auto &name: names) {
+                auto found = name.is_string() ? indexOf.find(name.get<std::string>()) : indexOf.end();
+                if (found != indexOf.end())
+                    chain.push_back(found->second);
+                else
+                    callJavaLogger(MAIN_THREAD, "[LLMRouter] unknown backend %s", name.dump().c_str());
+            }
+            return chain;
+        };
+        if (config.contains("Routes") && config["Routes"].is_object()) {
+            for (auto &entry: config["Routes"].items()) {
+                AskModel type;
+                if (!askModelFromName(entry.key(), type)) {
+                    callJavaLogger(MAIN_THREAD, "[LLMRouter] unknown question type %s", entry.key().c_str());
+                    continue;
+                }
+                std::vector<int> chain = chainOf(entry.value());
+                if (!chain.empty())
+                    this->_routes[type] = chain;
+            }
+        }
+        if (config.contains("Default"))
+            this->_defaultRoute = chainOf(config["Default"]);
+        if (this->_defaultRoute.empty()) {
+            for (size_t i = 0; i < this->_backends.size(); i++)
+                this->_defaultRoute.push_back(static_cast<int>(i));
+        }
+        if (config.contains("MaxLatency") && config["MaxLatency"].is_object()) {
+            for (auto &entry: config["MaxLatency"].items()) {
+                AskModel type;
+                if (askModelFromName(entry.key(), type) && entry.value().is_number())
+                    this->_maxLatency[type] = entry.value().get<double>() * 1000.0;
+            }
+        }
+        this->_maxErrorRate = config.value("MaxErrorRate", this->_maxErrorRate);
+        this->_window = std::max(MinSamples, config.value("Window", this->_window));
+        this->_recheck = config.value("Recheck", this->_recheck / 1000.0) * 1000.0;
+        this->_health.assign(this->_backends.size(), Health());
+
+        for (const LLMBackend &backend: this->_backends) {
+            callJavaLogger(MAIN_THREAD, "[LLMRouter] backend %s: %s %s", backend.name.c_str(), backend.model.c_str(),
+                           backend.baseUrl.c_str());
+        }
+        for (auto &route: this->_routes) {
+            std::string chain;
+            for (int backend: route.second)
+                chain += (chain.empty() ? "" : ", ") + this->_backends[backend].name;
+            callJavaLogger(MAIN_THREAD, "[LLMRouter] %s -> %s", askModelName(route.first), chain.c_str());
+        }
+    }
+
+    int LLMRouter::indexOf(const std::string &name) const {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        for (size_t i = 0; i < this->_backends.size(); i++) {
+            if (this->_backends[i].name == name)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    int LLMRouter::peek(AskModel type, double now) const {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        return ranked(type, now).front();
+    }
+
+    double LLMRouter::errorRate(const Health &health) const {
+        if (health.failed.size() < MinSamples)
+            return 0.0;
+        return static_cast<double>(health.failures) / static_cast<double>(health.failed.size());
+    }
+
+    bool LLMRouter::degraded(int backend, AskModel type) const {
+        const Health &health = this->_health[backend];
+        if (errorRate(health) > this->_maxErrorRate)
+            return true;
+        auto maxLatency = this->_maxLatency.find(type);
+        auto latency = health.latency.find(type);
+        return maxLatency != this->_maxLatency.end() && latency != health.latency.end() &&
+               latency->second > maxLatency->second;
+    }
+
+    std::vector<int> LLMRouter::ranked(AskModel type, double now) const {
+        auto route = this->_routes.find(type);
+        const std::vector<int> &chain = route != this->_routes.end() ? route->second : this->_defaultRoute;
+
+        std::vector<int> ranked;
+        std::vector<int> degradedOnes;
+        for (int backend: chain) {
+            // one not asked for a while may have recovered
+            if (!degraded(backend, type) || now - this->_health[backend].lastPicked >= this->_recheck)
+                ranked.push_back(backend);
+            else
+                degradedOnes.push_back(backend);
+        }
+        std::stable_sort(degradedOnes.begin(), degradedOnes.end(), [this](int a, int b) {
+            return errorRate(this->_health[a]) < errorRate(this->_health[b]);
+        });
+        ranked.insert(ranked.end(), degradedOnes.begin(), degradedOnes.end());
+        return ranked;
+    }
+
+    int LLMRouter::pick(AskModel type, int attempt, double now) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        auto route = this->_routes.find(type);
+        const std::vector<int> &chain = route != this->_routes.end() ? route->second : this->_defaultRoute;
+
+        std::vector<int> ranked = this->ranked(type, now);
+        int chosen = ranked[attempt % ranked.size()];
+        Health &health = this->_health[chosen];
+        health.rechecking = degraded(chosen, type);
+        health.lastPicked = now;
+        if (chosen != chain.front())
+            callJavaLogger(CHILD_THREAD, "[LLMRouter] attempt %d of %s goes to %s instead of %s", attempt + 1,
+                           askModelName(type), this->_backends[chosen].name.c_str(),
+                           this->_backends[chain.front()].name.c_str());
+        return chosen;
+    }
+
+    void LLMRouter::report(int backend, AskModel type, bool answered, double latency) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        Health &health = this->_health[backend];
+        if (health.rechecking && answered) {
+            // asked although degraded and answered, what it did before is too old to hold against it
+            health.failed.clear();
+            health.failures = 0;
+            health.latency[type] = latency;
+            health.rechecking = false;
+            return;
+        }
+        health.rechecking = false;
+        health.failed.push_back(!answered);
+        if (!answered)
+            health.failures++;
+        if (health.failed.size() > this->_window) {
+            if (health.failed.front())
+                health.failures--;
+            health.failed.pop_front();
+        }
+        if (answered) {
+            auto smoothed = health.latency.find(type);
+            health.latency[type] = smoothed == health.latency.end() ? latency :
+                                   (1.0 - LatencySmoothing) * smoothed->second + LatencySmoothing * latency;
+        }
+    }
+
+}
+
+#endif //LLMRouter_CPP_
@@ -0,0 +1,97 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef LLMRouter_H_
+#define LLMRouter_H_
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "QuestionScheduler.h"
+#include "../thirdpart/json/json.hpp"
+
+namespace fastbotx {
+
+    /// A model behind an OpenAI compatible endpoint, an empty base url is the one of liboai
+    struct LLMBackend {
+        std::string name;
+        std::string model;
+        std::string baseUrl;
+        std::string apiKey;
+    };
+
+    /**
+     * @brief Which model answers which question type, falling back along a chain when one
+     * model is slow or failing.
+     *
+     * Configured by "Routing" in config.json, times in seconds:
+     *   {"Backends": {"mini": {"Model": "gpt-4o-mini"},
+     *                 "strong": {"Model": "gpt-4o", "BaseUrl": "...", "ApiKey": "..."}},
+     *    "Routes": {"GUIDE": ["strong", "mini"], "TEST_FUNCTION": ["mini", "strong"]},
+     *    "Default": ["mini"], "MaxLatency": {"TEST_FUNCTION": 8},
+     *    "MaxErrorRate": 0.5, "Window": 20, "Recheck": 60}
+     *
+     * A backend takes Model, BaseUrl and ApiKey of config.json where it does not set them.
+     * Question types without a route use "Default", or all backends ordered by name.
+     * Without "Routing" there is one backend of Model, BaseUrl and ApiKey.
+     *
+     * A backend is degraded while more than MaxErrorRate of its last Window requests failed, or
+     * while its smoothed latency for the question type is above the MaxLatency of the type. The
+     * first backend of the chain that is not degraded is asked, degraded ones come after the
+     * others, least failing first, and every retry of a question moves one further down. A degraded
+     * backend not asked for Recheck keeps its place in the chain, and its history is forgotten when
+     * it answers.
+     *
+     * Timestamps are currentStamp() milliseconds.
+     */
+    class LLMRouter {
+    public:
+        void configure(const nlohmann::json &config, const LLMBackend &defaults);
+
+        const std::vector<LLMBackend> &backends() const { return this->_backends; }
+
+        /// Index of the backend of that name, -1 if there is none
+        int indexOf(const std::string &name) const;
+
+        /// Index of the backend to send the attempt-th attempt (from 0) of a question to
+        int pick(AskModel type, int attempt, double now);
+
+        /// Index of the backend the first attempt of a question would be sent to now, without picking it
+        int peek(AskModel type, double now) const;
+
+        /// Outcome of a request sent to the backend, latency in ms
+        void report(int backend, AskModel type, bool answered, double latency);
+
+    private:
+        struct Health {
+            std::deque<bool> failed; // last Window requests
+            int failures = 0;
+            std::map<AskModel, double> latency; // smoothed ms per question type
+            double lastPicked = 0.0;
+            bool rechecking = false; // asked while degraded
+        };
+
+        double errorRate(const Health &health) const;
+
+        /// Failing too often, or too slow for the question type
+        bool degraded(int backend, AskModel type) const;
+
+        /// The chain of the question type, the backends not degraded or due to be rechecked first
+        std::vector<int> ranked(AskModel type, double now) const;
+
+        mutable std::mutex _mutex;
+        std::vector<LLMBackend> _backends;
+        std::vector<Health> _health;
+        std::map<AskModel, std::vector<int>> _routes;
+        std::vector<int> _defaultRoute;
+        std::map<AskModel, double> _maxLatency;
+        double _maxErrorRate = 0.5;
+        size_t _window = 20;
+        double _recheck = 60000.0;
+    };
+
+}
+
+#endif //LLMRouter_H_
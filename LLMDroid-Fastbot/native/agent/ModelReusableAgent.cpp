@@ -237,13 +237,12 @@ namespace fastbotx {
             return this->_newState->greedyPickMaxQValue(enableValidValuePriorityFilter);
         }
         BDLOG("%s", "Try to randomly select a value action.");
-        return this->_newState->randomPickAction(enableValidValuePriorityFilter);
+        return this->_newState->randomPickAction(enableValidValuePriorityFilter, this->_random);
     }
 
 
     bool ModelReusableAgent::eGreedy() const {
-        srand((uint32_t) (int) time(nullptr)); // @TODO the random range
-        auto r = static_cast<double>(static_cast<double>(rand() % 100 ) / 100.0L);
+        auto r = static_cast<double>(static_cast<double>(this->_random.nextInt(0, 100)) / 100.0L);
         if (r < this->_epsilon)
             return false;
         return true;
@@ -265,7 +264,7 @@ namespace fastbotx {
             return action;
         }
 
-        action = this->_newState->randomPickUnvisitedAction();
+        action = this->_newState->randomPickUnvisitedAction(this->_random);
         if (nullptr != action) {
             MLOG("select action in unvisited action");
             return action;
@@ -333,7 +332,7 @@ namespace fastbotx {
             BDLOGE("%s", " total weights is 0");
             return nullptr;
         }
-        int randI = randomInt(0, totalWeight);
+        int randI = this->_random.nextInt(0, totalWeight);
         for (auto action: actionsNotInModel) {
             if (randI < action->getPriority()) {
                 return action;
@@ -372,7 +371,7 @@ namespace fastbotx {
                     {
                         // following code is for generating a random value to slight affect the quality value
                         qualityValue = 10.0f * qualityValue;
-                        auto uniform = static_cast<float>(static_cast<float>(randomInt(0, 10)) /
+                        auto uniform = static_cast<float>(static_cast<float>(this->_random.nextInt(0, 10)) /
                                                           10.0f);
                         // random value from uniform distribution should not be 0, or log function will return INF
                         if (uniform < std::numeric_limits<float>::min())
@@ -449,7 +448,7 @@ namespace fastbotx {
             }
             qv += getQValue(action);
             qv /= entropyAlpha;
-            float uniform = static_cast<float>(randomInt(0, 10)) /
+            float uniform = static_cast<float>(this->_random.nextInt(0, 10)) /
                             10.0f; // with this uniform distribution, add a little disturbance to the qv value
 
             // use the uniform distribution and humble gumbel to add some randomness to the qv value
@@ -488,17 +487,22 @@ namespace fastbotx {
     /// by FlatBuffers
     /// \param packageName The package name of the tested application
     void ModelReusableAgent::loadReuseModel(const std::string &packageName) {
-        std::string modelFilePath = STORAGE_PREFIX + packageName + ".fbm";
+        // the stored action hashes depend on HASH_LAYOUT_VERSION, layout 1 keeps the original names
+        std::string layoutSuffix = HASH_LAYOUT_VERSION >= 2 ? ".v" + std::to_string(HASH_LAYOUT_VERSION) : "";
+        std::string modelFilePath = STORAGE_PREFIX + packageName + layoutSuffix + ".fbm";
 
         this->_modelSavePath = modelFilePath;
         if (!this->_modelSavePath.empty()) {
-            this->_defaultModelSavePath = STORAGE_PREFIX + packageName + ".tmp.fbm";
+            this->_defaultModelSavePath = STORAGE_PREFIX + packageName + layoutSuffix + ".tmp.fbm";
         }
         BLOG("begin load model: %s", this->_modelSavePath.c_str());
 
         std::ifstream modelFile(modelFilePath, std::ios::binary | std::ios::in);
         if (modelFile.fail()) {
             BLOG("read model file %s failed, check if file exists!", modelFilePath.c_str());
+            if (!layoutSuffix.empty() && std::ifstream(STORAGE_PREFIX + packageName + ".fbm").good()) {
+                BLOG("a model saved with hash layout 1 exists, set HASH_LAYOUT_VERSION to 1 to reuse it");
+            }
             return;
         }
 
@@ -0,0 +1,82 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef PromptBuilder_CPP_
+#define PromptBuilder_CPP_
+
+#include "PromptBuilder.h"
+
+namespace fastbotx {
+
+    // about the longest prompts asked, a page description of 7000 characters in a batch of 4 and the instructions
+    static const size_t SystemCapacity = 8 * 1024;
+    static const size_t UserCapacity = 32 * 1024;
+    static const size_t BodyCapacity = SystemCapacity + UserCapacity + 4 * 1024;
+
+    PromptText &PromptText::quoted(std::string_view text) {
+        static const char *hex = "0123456789abcdef";
+        this->_text.push_back('"');
+        size_t run = 0; // start of the characters copied as they are
+        for (size_t i = 0; i < text.size(); i++) {
+            auto c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            this->_text.append(text.data() + run, i - run);
+            run = i + 1;
+            switch (c) {
+                case '"':
+                    this->_text.append("\\\"");
+                    break;
+                case '\\':
+                    this->_text.append("\\\\");
+                    break;
+                case '\b':
+                    this->_text.append("\\b");
+                    break;
+                case '\f':
+                    this->_text.append("\\f");
+                    break;
+                case '\n':
+                    this->_text.append("\\n");
+                    break;
+                case '\r':
+                    this->_text.append("\\r");
+                    break;
+                case '\t':
+                    this->_text.append("\\t");
+                    break;
+                default: {
+                    char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+                    this->_text.append(escaped, sizeof(escaped));
+                }
+            }
+        }
+        this->_text.append(text.data() + run, text.size() - run);
+        this->_text.push_back('"');
+        return *this;
+    }
+
+    PromptBuilder::PromptBuilder()
+            : _system(SystemCapacity), _user(UserCapacity), _bodies{PromptText(BodyCapacity), PromptText(BodyCapacity)} {
+    }
+
+    void PromptBuilder::clear() {
+        this->_system.clear();
+        this->_user.clear();
+    }
+
+    std::string_view PromptBuilder::requestBody(std::string_view model, std::string_view system, std::string_view user,
+                                                size_t body) {
+        PromptText &text = this->_bodies[body];
+        text.clear();
+        text << "{\"model\":";
+        text.quoted(model) << ",\"temperature\":0,\"messages\":[{\"role\":\"system\",\"content\":";
+        text.quoted(system) << "},{\"role\":\"user\",\"content\":";
+        text.quoted(user) << "}]}";
+        return text.str();
+    }
+
+}
+
+#endif //PromptBuilder_CPP_
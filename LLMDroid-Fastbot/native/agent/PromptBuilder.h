@@ -0,0 +1,97 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef PromptBuilder_H_
+#define PromptBuilder_H_
+
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace fastbotx {
+
+    /**
+     * @brief Text of a prompt written into a buffer that is reused from question to question.
+     *
+     * clear() keeps the memory, once the buffer has grown to the longest prompt asked, writing a
+     * prompt allocates nothing. JSON sections are written in place and compact by quoted(), without
+     * building a json tree first.
+     */
+    class PromptText {
+    public:
+        explicit PromptText(size_t capacity) { this->_text.reserve(capacity); }
+
+        PromptText(const PromptText &) = delete;
+        PromptText &operator=(const PromptText &) = delete;
+
+        PromptText &operator<<(std::string_view text) {
+            this->_text.append(text.data(), text.size());
+            return *this;
+        }
+
+        PromptText &operator<<(const char *text) { return *this << std::string_view(text); }
+
+        PromptText &operator<<(const std::string &text) { return *this << std::string_view(text); }
+
+        PromptText &operator<<(char c) {
+            this->_text.push_back(c);
+            return *this;
+        }
+
+        template<typename Integer, typename = std::enable_if_t<std::is_integral<Integer>::value>>
+        PromptText &operator<<(Integer value) {
+            char digits[24];
+            auto written = std::to_chars(digits, digits + sizeof(digits), value);
+            this->_text.append(digits, written.ptr);
+            return *this;
+        }
+
+        /// The text as a JSON string, quotes included
+        PromptText &quoted(std::string_view text);
+
+        void clear() { this->_text.clear(); }
+
+        const std::string &str() const { return this->_text; }
+
+        size_t size() const { return this->_text.size(); }
+
+    private:
+        std::string _text;
+    };
+
+    /**
+     * @brief The system and user message of a question and the chat completion request made of them.
+     *
+     * Only the LLM thread asks, one question at a time, so one builder serves all question types.
+     * The request body is rendered into a buffer of its own and handed to curl as it is, a
+     * request sent a second time to another model has a second one.
+     */
+    class PromptBuilder {
+    public:
+        PromptBuilder();
+
+        /// Empties both messages for the next question
+        void clear();
+
+        /// The instructions of the question type, alike for every question of it
+        PromptText &system() { return this->_system; }
+
+        /// The data of this question
+        PromptText &user() { return this->_user; }
+
+        static const size_t Bodies = 2;
+
+        /// Request body of a chat completion in buffer body (below Bodies), valid until the next call for it
+        std::string_view requestBody(std::string_view model, std::string_view system, std::string_view user,
+                                     size_t body = 0);
+
+    private:
+        PromptText _system;
+        PromptText _user;
+        PromptText _bodies[Bodies];
+    };
+
+}
+
+#endif //PromptBuilder_H_
@@ -0,0 +1,208 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef QuestionScheduler_CPP_
+#define QuestionScheduler_CPP_
+
+#include <algorithm>
+#include <cmath>
+#include "QuestionScheduler.h"
+#include "LLMMetrics.h"
+#include "../Tracer.h"
+
+namespace fastbotx {
+
+    void QuestionScheduler::configure(const nlohmann::json &config) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_aging = static_cast<int64_t>(config.value("Aging", 30.0) * 1000000.0);
+        this->_overviewBatch = std::max(1, config.value("OverviewBatch", 4));
+        this->_overviewTokens = std::max(0, config.value("OverviewTokens", 6000));
+        callJavaLogger(MAIN_THREAD, "[QuestionScheduler] aging %.0fs per priority level, up to %zu states per overview",
+                       this->_aging / 1000000.0, this->_overviewBatch);
+    }
+
+    bool mainWaitsFor(AskModel type) {
+        return type == AskModel::GUIDE || type == AskModel::TEST_FUNCTION || type == AskModel::GUIDE_FAILURE;
+    }
+
+    int QuestionScheduler::priorityOf(AskModel type) {
+        if (mainWaitsFor(type))
+            return 0;
+        return type == AskModel::REANALYSIS ? 2 : 1;
+    }
+
+    bool QuestionScheduler::before(const Entry &a, const Entry &b) {
+        // the main thread waits for priority 0, aging never overtakes it
+        if ((a.priority == 0) != (b.priority == 0))
+            return a.priority == 0;
+        return a.rank < b.rank;
+    }
+
+    int QuestionScheduler::findQueued(AskModel type, int mergedStateId) const {
+        for (size_t i = 0; i < this->_entries.size(); i++) {
+            const QuestionPayload &queued = this->_entries[i].payload;
+            if (queued.type == type && queued.from && queued.from->getId() == mergedStateId)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    bool QuestionScheduler::push(QuestionPayload &&payload) {
+        AskModel type = payload.type;
+        size_t depth;
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            int64_t now = Tracer::now();
+            if (payload.from) {
+                int id = payload.from->getId();
+                int queued = findQueued(type, id);
+                if (queued >= 0) {
+                    // the newer payload in the place of the older one
+                    Entry &entry = this->_entries[queued];
+                    payload.enqueuedAt = entry.payload.enqueuedAt;
+                    payload.pushedAt = now;
+                    entry.payload = std::move(payload);
+                    LLMMetrics::inst().coalesced(type);
+                    callJavaLogger(MAIN_THREAD, "[MAIN] %s of MergedState%d already queued, coalesced",
+                                   askModelName(type), id);
+                    return false;
+                }
+                if (type == AskModel::STATE_OVERVIEW) {
+                    int reanalysis = findQueued(AskModel::REANALYSIS, id);
+                    if (reanalysis >= 0) {
+                        this->_entries.erase(this->_entries.begin() + reanalysis);
+                        LLMMetrics::inst().cancelled(AskModel::REANALYSIS);
+                        callJavaLogger(MAIN_THREAD, "[MAIN] REANALYSIS of MergedState%d superseded by overview", id);
+                    }
+                }
+            }
+            payload.enqueuedAt = now;
+            payload.pushedAt = now;
+            int priority = priorityOf(type);
+            this->_entries.push_back({std::move(payload), priority, now + priority * this->_aging});
+            depth = this->_entries.size();
+            LLMMetrics::inst().queued(depth);
+        }
+        callJavaLogger(MAIN_THREAD, "[MAIN] push %s to queue, remains: %zu", askModelName(type), depth);
+        this->_queued.notify_one();
+        return true;
+    }
+
+    bool QuestionScheduler::pop(QuestionPayload &payload, std::chrono::milliseconds timeout,
+                                const std::function<double(AskModel)> &paced) {
+        auto until = std::chrono::steady_clock::now() + timeout;
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        while (true) {
+            if (!this->_queued.wait_until(lock, until, [this] { return !this->_entries.empty(); }))
+                return false;
+            auto next = this->_entries.end();
+            double heldFor = 0.0; // shortest wait of the questions held back
+            for (auto it = this->_entries.begin(); it != this->_entries.end(); ++it) {
+                if (next != this->_entries.end() && !before(*it, *next))
+                    continue;
+                double wait = paced ? paced(it->payload.type) : 0.0;
+                if (wait > 0.0) {
+                    heldFor = heldFor > 0.0 ? std::min(heldFor, wait) : wait;
+                    continue;
+                }
+                next = it;
+            }
+            if (next == this->_entries.end()) {
+                // until the rate limit lets one go, or a question comes that it does not hold back
+                auto refilled = std::chrono::steady_clock::now() +
+                                std::chrono::milliseconds(static_cast<int64_t>(std::ceil(heldFor)));
+                this->_queued.wait_until(lock, std::min(until, refilled));
+                if (std::chrono::steady_clock::now() >= until)
+                    return false;
+                continue;
+            }
+            QuestionPayload taken = std::move(next->payload);
+            this->_entries.erase(next);
+
+            if (taken.from && taken.type == AskModel::REANALYSIS) {
+                // an overview asked since the question was last pushed answers it
+                auto overview = this->_overviewAskedAt.find(taken.from->getId());
+                if (overview != this->_overviewAskedAt.end() && overview->second > taken.pushedAt) {
+                    LLMMetrics::inst().cancelled(taken.type);
+                    callJavaLogger(CHILD_THREAD, "[THREAD] REANALYSIS of MergedState%d superseded by overview",
+                                   taken.from->getId());
+                    if (this->_entries.empty() && this->_asking == 0)
+                        this->_idle.notify_all();
+                    continue;
+                }
+            }
+            asked(taken);
+            this->_asking++;
+            payload = std::move(taken);
+            callJavaLogger(CHILD_THREAD, "[THREAD]pop %s from queue, remains: %zu", askModelName(payload.type),
+                           this->_entries.size());
+            return true;
+        }
+    }
+
+    MergedStatePtr QuestionScheduler::peek(AskModel type) const {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        const Entry *next = nullptr;
+        for (const Entry &entry: this->_entries) {
+            if (entry.payload.type == type && (!next || before(entry, *next)))
+                next = &entry;
+        }
+        return next ? next->payload.from : nullptr;
+    }
+
+    bool QuestionScheduler::take(AskModel type, int mergedStateId, QuestionPayload &payload) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        int queued = findQueued(type, mergedStateId);
+        if (queued < 0)
+            return false;
+        payload = std::move(this->_entries[queued].payload);
+        this->_entries.erase(this->_entries.begin() + queued);
+        asked(payload);
+        return true;
+    }
+
+    void QuestionScheduler::asked(const QuestionPayload &payload) {
+        if (payload.from && payload.type == AskModel::STATE_OVERVIEW)
+            this->_overviewAskedAt[payload.from->getId()] = Tracer::now();
+    }
+
+    bool QuestionScheduler::withdraw(AskModel type, const std::shared_ptr<void> &promise) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        for (auto it = this->_entries.begin(); it != this->_entries.end(); ++it) {
+            const QuestionPayload &queued = it->payload;
+            if (queued.type != type)
+                continue;
+            if ((queued.promiseInt && queued.promiseInt == promise) ||
+                (queued.promiseAction && queued.promiseAction == promise)) {
+                this->_entries.erase(it);
+                LLMMetrics::inst().cancelled(type);
+                callJavaLogger(MAIN_THREAD, "[MAIN] %s no longer waited for, dropped from the queue",
+                               askModelName(type));
+                if (this->_entries.empty() && this->_asking == 0)
+                    this->_idle.notify_all();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void QuestionScheduler::done() {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_asking--;
+        if (this->_entries.empty() && this->_asking == 0)
+            this->_idle.notify_all();
+    }
+
+    bool QuestionScheduler::waitUntilIdle(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        return this->_idle.wait_for(lock, timeout, [this] { return this->_entries.empty() && this->_asking == 0; });
+    }
+
+    size_t QuestionScheduler::depth() const {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        return this->_entries.size();
+    }
+
+}
+
+#endif //QuestionScheduler_CPP_
@@ -0,0 +1,144 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef QuestionScheduler_H_
+#define QuestionScheduler_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "MergedState.h"
+#include "ReuseState.h"
+#include "../thirdpart/json/json.hpp"
+
+namespace fastbotx {
+
+    typedef std::shared_ptr<std::promise<int>> PromiseIntPtr;
+    typedef std::future<int> FutureInt;
+    typedef std::shared_ptr<std::promise<std::string>> PromiseStrPtr;
+    typedef std::future<std::string> FutureStr;
+    typedef std::shared_ptr<std::promise<ActivityStateActionPtr>> PromiseActionPtr;
+    typedef std::future<ActivityStateActionPtr> FutureAction;
+
+    enum class AskModel
+    {
+        STATE_OVERVIEW, GRAPH_OVERVIEW, GUIDE, TEST_FUNCTION, GUIDE_FAILURE, REANALYSIS
+    };
+
+    /// Name of a question type as written in config.json, e.g. "TEST_FUNCTION"
+    const char *askModelName(AskModel type);
+
+    /// The question type of its name in config.json, false if there is none of that name
+    bool askModelFromName(const std::string &name, AskModel &type);
+
+    /// Whether the main thread waits for the answers of the question type
+    bool mainWaitsFor(AskModel type);
+
+    struct QuestionPayload
+    {
+        AskModel type;
+        MergedStatePtr from = nullptr;
+        std::map<MergedStatePtr, std::set<ActionPtr>> stateMap;
+        int transitCount = 0;
+        ReuseStatePtr reuseState = nullptr;
+        bool flag = false; // GUIDE:guideFailed, TEST_FUNCTION:firstTime
+        int64_t enqueuedAt = 0; // Tracer::now() when first queued
+        int64_t pushedAt = 0; // Tracer::now() when last queued, coalesced pushes included
+        // where the main thread waits for the answer, GUIDE and TEST_FUNCTION only
+        PromiseIntPtr promiseInt = nullptr;
+        PromiseActionPtr promiseAction = nullptr;
+    };
+
+    /**
+     * @brief The questions waiting for the LLM thread, in the order they should be asked.
+     *
+     * GUIDE and TEST_FUNCTION block the main thread and are asked first. The others are ranked by
+     * the time they were queued plus "Aging" seconds per priority level (overviews 1, reanalysis 2),
+     * so a reanalysis that waited long enough goes before a newer overview instead of starving.
+     *
+     * A question of the same type about a MergedState that is already queued is coalesced into the
+     * queued one, which keeps its place. An overview of a MergedState cancels the reanalysis queued
+     * for it before, and a reanalysis queued before the last overview of its MergedState was asked
+     * is dropped when it comes up.
+     *
+     * While one overview is being asked, the LLM thread may take the other queued overviews along
+     * with it, up to "OverviewBatch" states and about "OverviewTokens" tokens of descriptions.
+     *
+     * A question the rate limit holds back stays queued, and the next one that may go is taken.
+     *
+     * Pushed by the main thread, popped by the LLM thread.
+     */
+    class QuestionScheduler {
+    public:
+        /// "Scheduler" of config.json: {"Aging": 30, "OverviewBatch": 4, "OverviewTokens": 6000}
+        void configure(const nlohmann::json &config);
+
+        /// Most MergedStates asked about in one overview question
+        size_t overviewBatch() const { return this->_overviewBatch; }
+
+        /// Rough budget for the descriptions of the MergedStates of one overview question
+        size_t overviewTokens() const { return this->_overviewTokens; }
+
+        /// Queue the question, false if it was coalesced into one already queued
+        bool push(QuestionPayload &&payload);
+
+        /// Take the next question, waiting up to timeout for one, false if none came. paced tells how
+        /// many ms a question of a type is held back, called with the queue locked
+        bool pop(QuestionPayload &payload, std::chrono::milliseconds timeout,
+                 const std::function<double(AskModel)> &paced = nullptr);
+
+        /// MergedState of the next queued question of this type, null if none is queued
+        MergedStatePtr peek(AskModel type) const;
+
+        /// Take the queued question of this type about the MergedState, asked along with the last one popped
+        bool take(AskModel type, int mergedStateId, QuestionPayload &payload);
+
+        /// Drop the queued question of the type answering promise, the main thread no longer waits for
+        /// it. False if it is not queued, taken already or never pushed
+        bool withdraw(AskModel type, const std::shared_ptr<void> &promise);
+
+        /// The question taken last was answered or given up
+        void done();
+
+        /// Block until no question is queued or being asked, false if the timeout came first
+        bool waitUntilIdle(std::chrono::milliseconds timeout);
+
+        /// Questions queued, not counting the one being asked
+        size_t depth() const;
+
+    private:
+        struct Entry {
+            QuestionPayload payload;
+            int priority;
+            int64_t rank; // queued at, delayed by its priority
+        };
+
+        static int priorityOf(AskModel type);
+
+        static bool before(const Entry &a, const Entry &b);
+
+        /// Index of the queued question of the same type about the same MergedState, -1 if none
+        int findQueued(AskModel type, int mergedStateId) const;
+
+        /// Note an overview as asked now, for dropping the reanalysis queued before it
+        void asked(const QuestionPayload &payload);
+
+        mutable std::mutex _mutex;
+        std::condition_variable _queued;
+        std::condition_variable _idle;
+        std::vector<Entry> _entries;
+        int _asking = 0;
+        int64_t _aging = 30 * 1000000LL;
+        size_t _overviewBatch = 4;
+        size_t _overviewTokens = 6000;
+        // MergedState id to when its last overview was taken, for dropping stale reanalysis
+        std::map<int, int64_t> _overviewAskedAt;
+    };
+
+}
+
+#endif //QuestionScheduler_H_
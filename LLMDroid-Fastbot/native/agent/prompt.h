@@ -4,6 +4,17 @@
 #include <string>
 
 
+//////////////////////////////////////////////////////////////////////////////
+// Compact description, replaces the HTML description when selected in config.json
+//////////////////////////////////////////////////////////////////////////////
+
+const std::string _compactFormatPrompt = R"(
+Instead of HTML, the description below uses a compact form with the same information. Each line is one element, and a child is indented one space deeper than its parent, so there are no closing tags.
+A line starts with the tag: b (button), c (checkbox), s (scroller), i (input) or p, followed by "#" and the element's id, e.g. "b#12" is the button whose id is 12. Then come ".class", "@resource-id", "content-desc" in double quotes, dir:v, dir:h or dir:vh (scroll direction), and ": text" at the end.
+A line "+N same as above: #a/#b, #c/#d" stands for N more siblings identical to the previous one, listing their ids in the same order as the ids of the previous one.
+)";
+
+
 //////////////////////////////////////////////////////////////////////////////
 // State Overview
 //////////////////////////////////////////////////////////////////////////////
@@ -100,6 +111,72 @@ An example is given below, where "navigate to 'News'" and "navigate to 'My'" are
 }
 )";
 
+// several new pages asked in one question
+const std::string _inputExplanationPrompt_stateBatch = R"(
+This time I will provide the descriptions of several pages at once. Each description is headed by the name of its page, "State" followed by a number, e.g. "State12".
+Do the tasks below for each of these pages separately. If you are asked to rank pages, rank all of these pages together with the other pages given.
+)";
+
+const std::string _anwserFormatPrompt_stateBatch2 = R"(
+Your anwser should be in json form. Here are the key elements to include:
+- "Pages": An object whose keys are the names of the pages, e.g. "State12", and whose values are the analyses of these pages, each including:
+    - "Overview": A string that provides a summary of the page.
+    - "Function List": An object consisting of key-value pairs that list the functions in order of importance. The key is a string describing the function, and the value is an integer representing the element ID, which can be obtained from the 'id' attribute of the elements in the description of that page.
+Note that the key must not be changed!
+An example is given below for two pages, where "navigate to 'News'" and "navigate to 'My'" are the navigation-related functions you believed.
+{
+  "Pages": {
+    "State12": {
+      "Overview": "Main page of the app, providing buttons to navigate to other tabs, and functions for searching and playing videos.",
+      "Function List": {
+        "navigate to 'News'": 29,
+        "navigate to 'My'": 28,
+        "play a video": 15,
+        ...
+      }
+    },
+    "State13": {
+      "Overview": "Settings page of the app, providing switches for notifications and playback.",
+      "Function List": {
+        "turn off notifications": 7,
+        ...
+      }
+    }
+  }
+}
+)";
+
+const std::string _anwserFormatPrompt_stateBatch3 = R"(
+Your anwser should be in json form. Here are the key elements to include:
+- "Pages": An object whose keys are the names of the pages, e.g. "State12", and whose values are the analyses of these pages, each including:
+    - "Overview": A string that provides a summary of the page.
+    - "Function List": An object consisting of key-value pairs that list the functions in order of importance. The key is a string describing the function, and the value is an integer representing the element ID, which can be obtained from the 'id' attribute of the elements in the description of that page.
+- "Top5": An array of integers indicating the indices of the top five most important pages among all the pages, where the index is the number behind "State".
+Note that the key must not be changed!
+An example is given below for two pages, where "navigate to 'News'" and "navigate to 'My'" are the navigation-related functions you believed.
+{
+  "Pages": {
+    "State12": {
+      "Overview": "Main page of the app, providing buttons to navigate to other tabs, and functions for searching and playing videos.",
+      "Function List": {
+        "navigate to 'News'": 29,
+        "navigate to 'My'": 28,
+        "play a video": 15,
+        ...
+      }
+    },
+    "State13": {
+      "Overview": "Settings page of the app, providing switches for notifications and playback.",
+      "Function List": {
+        "turn off notifications": 7,
+        ...
+      }
+    }
+  },
+  "Top5": [1, 12, 3, 2, 7]
+}
+)";
+
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -114,10 +191,10 @@ Below is a list of States you ranked from highest to lowest importance in previo
 
 
 const std::string _requiredOutputPrompt_guide_part1 = R"(
-Based on the information above, please decide: Which State should we go next, and what function would be most appropriate to test in the target State?
+Based on the state information in the user message, please decide: Which State should we go next, and what function would be most appropriate to test in the target State?
 Your main objective should be to explore new pages and enhance code coverage by executing this function.
 Specifically, you can follow these strategies:
-1. Do not select function that has been chosen before:)";
+1. Do not select function that has been chosen before, they are listed after "Functions chosen before".)";
 
 const std::string _requiredOutputPrompt_guide_part2 = R"(
 2. Do not choose functions related to login or registration.
@@ -0,0 +1,116 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef BenchData_CPP_
+#define BenchData_CPP_
+
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include "BenchData.h"
+
+namespace fastbotx {
+    namespace bench {
+
+        static const int ScreenWidth = 1080;
+        static const int ScreenHeight = 2340;
+        // nodes of one list row: the row, its icon, two texts and a button
+        static const int NodesPerRow = 5;
+
+        static void node(std::ostringstream &out, int &index, const char *clazz, const std::string &resourceID,
+                         const std::string &text, bool clickable, int left, int top, int right, int bottom,
+                         bool close = true) {
+            out << "<node index=\"" << index++ << "\" text=\"" << text << "\" resource-id=\"com.example.app:id/"
+                << resourceID << "\" class=\"" << clazz << "\" package=\"com.example.app\" content-desc=\"\" "
+                << "checkable=\"false\" checked=\"false\" clickable=\"" << (clickable ? "true" : "false")
+                << "\" enabled=\"true\" focusable=\"" << (clickable ? "true" : "false")
+                << "\" focused=\"false\" scrollable=\"false\" long-clickable=\"false\" password=\"false\" "
+                << "selected=\"false\" bounds=\"[" << left << "," << top << "][" << right << "," << bottom << "]\""
+                << (close ? "/>" : ">");
+        }
+
+        std::string syntheticTree(int nodes, int variant) {
+            std::ostringstream out;
+            int index = 0;
+            out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+            node(out, index, "android.widget.FrameLayout", "content", "", false, 0, 0, ScreenWidth, ScreenHeight, false);
+            node(out, index, "android.view.ViewGroup", "toolbar", "", false, 0, 0, ScreenWidth, 160, false);
+            node(out, index, "android.widget.ImageButton", "navigate_up", "", true, 0, 0, 160, 160);
+            node(out, index, "android.widget.TextView", "title", "Page " + std::to_string(variant % 3), false,
+                 160, 0, 900, 160);
+            node(out, index, "android.widget.ImageButton", "search", "", true, 920, 0, ScreenWidth, 160);
+            out << "</node>";
+
+            int rows = std::max(1, (nodes - 12) / NodesPerRow);
+            int rowHeight = std::max(20, (ScreenHeight - 400) / rows);
+            node(out, index, "androidx.recyclerview.widget.RecyclerView", "list", "", false, 0, 160, ScreenWidth,
+                 ScreenHeight - 240, false);
+            for (int row = 0; row < rows; row++) {
+                int top = 160 + row * rowHeight;
+                int bottom = top + rowHeight;
+                // a quarter of the rows are other kinds of rows in each variant
+                bool varied = row % 4 == 0;
+                int item = varied ? row + variant * rows : row;
+                node(out, index, "android.view.ViewGroup", varied ? "promo_" + std::to_string(variant) : "item", "",
+                     true, 0, top, ScreenWidth, bottom, false);
+                node(out, index, "android.widget.ImageView", "icon", "", false, 24, top, 24 + rowHeight, bottom);
+                node(out, index, "android.widget.TextView", "item_title", "Item " + std::to_string(item), false,
+                     200, top, 800, top + rowHeight / 2);
+                node(out, index, "android.widget.TextView", "item_summary",
+                     "Summary of item " + std::to_string(item), false, 200, top + rowHeight / 2, 800, bottom);
+                node(out, index, "android.widget.Button", "item_action", "Open", true, 820, top, ScreenWidth, bottom);
+                out << "</node>";
+            }
+            out << "</node>";
+
+            node(out, index, "android.widget.LinearLayout", "bottom_bar", "", false, 0, ScreenHeight - 240,
+                 ScreenWidth, ScreenHeight, false);
+            const char *tabs[] = {"Home", "Explore", "Library", "Profile"};
+            for (int tab = 0; tab < 4; tab++) {
+                node(out, index, "android.widget.TextView", "tab", tabs[tab], true, tab * ScreenWidth / 4,
+                     ScreenHeight - 240, (tab + 1) * ScreenWidth / 4, ScreenHeight);
+            }
+            out << "</node>";
+            out << "</node>";
+            return out.str();
+        }
+
+        const std::vector<std::string> &recordedTrees() {
+            static std::vector<std::string> trees = [] {
+                std::vector<std::string> loaded;
+                const char *directory = std::getenv("FASTBOT_BENCH_TREES");
+                if (!directory)
+                    return loaded;
+                DIR *dir = opendir(directory);
+                if (!dir)
+                    return loaded;
+                std::vector<std::string> paths;
+                while (struct dirent *entry = readdir(dir)) {
+                    std::string name = entry->d_name;
+                    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".xml") == 0)
+                        paths.push_back(std::string(directory) + "/" + name);
+                }
+                closedir(dir);
+                // same order on every run
+                std::sort(paths.begin(), paths.end());
+                for (const std::string &path: paths) {
+                    std::ifstream file(path);
+                    std::stringstream content;
+                    content << file.rdbuf();
+                    loaded.push_back(content.str());
+                }
+                return loaded;
+            }();
+            return trees;
+        }
+
+        bool agentConfigAvailable() {
+            return std::ifstream("/sdcard/config.json").good();
+        }
+
+    }
+}
+
+#endif //BenchData_CPP_
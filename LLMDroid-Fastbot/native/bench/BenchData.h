@@ -0,0 +1,32 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef BenchData_H_
+#define BenchData_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fastbotx {
+    namespace bench {
+
+        /**
+         * A GUI tree shaped like a uiautomator dump of a list page: a toolbar, a list of rows
+         * holding an icon, two texts and a button, and a bottom navigation bar.
+         * @param nodes about how many nodes the tree has
+         * @param variant changes texts and the kind of a quarter of the rows, so the states built from
+         * different variants are similar but not equal
+         */
+        std::string syntheticTree(int nodes, int variant = 0);
+
+        /// Dumps in the directory named by FASTBOT_BENCH_TREES, *.xml, empty if it is not set
+        const std::vector<std::string> &recordedTrees();
+
+        /// The agents read /sdcard/config.json when built and exit without it
+        bool agentConfigAvailable();
+
+    }
+}
+
+#endif //BenchData_H_
@@ -0,0 +1,358 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+/**
+ * Microbenchmarks of the native hot paths, see tools/run_native_bench.sh to run them on a device
+ * and keep the results as JSON baselines.
+ */
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include "BenchData.h"
+#include "utils.hpp"
+#include "Element.h"
+#include "ReuseState.h"
+#include "MergedState.h"
+#include "Graph.h"
+#include "Model.h"
+#include "Preference.h"
+#include "ModelReusableAgent.h"
+#include "PromptBuilder.h"
+#include "ReuseModel_generated.h"
+
+using namespace fastbotx;
+
+namespace {
+
+    // operator new calls, the "allocs" counter of the benchmarks that report it
+    std::atomic<int64_t> allocations{0};
+
+}
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+    const char *BenchActivity = "com.example.app.MainActivity";
+    const char *BenchPackage = "bench";
+
+    stringPtr benchActivity() {
+        static stringPtr activity = std::make_shared<std::string>(BenchActivity);
+        return activity;
+    }
+
+    ReuseStatePtr buildState(int nodes, int variant) {
+        ElementPtr element = Element::createFromXml(bench::syntheticTree(nodes, variant));
+        return ReuseState::create(element, benchActivity());
+    }
+
+    /// An agent whose merged states can be filled without asking the LLM
+    class BenchAgent : public ModelReusableAgent {
+    public:
+        explicit BenchAgent(const ModelPtr &model)
+                : ModelReusableAgent(model, false) {
+            // also moves the model saved in the destructor away from the default path
+            loadReuseModel(BenchPackage);
+        }
+
+        const MergedStateGraphPtr &mergedStateGraph() const { return this->_mergedStateGraph; }
+    };
+
+    /// Agents are kept to the end, the detached LLM thread of an agent still uses it after it is dropped
+    std::shared_ptr<BenchAgent> createAgent() {
+        static std::vector<std::shared_ptr<BenchAgent>> *agents = new std::vector<std::shared_ptr<BenchAgent>>();
+        agents->push_back(std::make_shared<BenchAgent>(Model::create()));
+        return agents->back();
+    }
+
+    std::string benchModelPath() {
+        std::string layoutSuffix = HASH_LAYOUT_VERSION >= 2 ? ".v" + std::to_string(HASH_LAYOUT_VERSION) : "";
+#ifdef __ANDROID__
+        return "/sdcard/fastbot_" + std::string(BenchPackage) + layoutSuffix + ".fbm";
+#else
+        return std::string(BenchPackage) + layoutSuffix + ".fbm";
+#endif
+    }
+
+    /// A reuse model of entries actions, each leading to up to 4 of 40 activities
+    void writeReuseModel(const std::string &path, int entries) {
+        flatbuffers::FlatBufferBuilder builder;
+        std::vector<flatbuffers::Offset<ReuseEntry>> reuseEntries;
+        for (int entry = 0; entry < entries; entry++) {
+            std::vector<flatbuffers::Offset<ActivityTimes>> targets;
+            for (int target = 0; target <= entry % 4; target++) {
+                std::string activity = "com.example.app.Activity" + std::to_string((entry + target) % 40);
+                targets.push_back(CreateActivityTimes(builder, builder.CreateString(activity), 1 + entry % 7));
+            }
+            uint64_t actionHash = 0x9e3779b97f4a7c15ULL * static_cast<uint64_t>(entry + 1);
+            reuseEntries.push_back(CreateReuseEntry(builder, actionHash, builder.CreateVector(targets)));
+        }
+        builder.Finish(CreateReuseModel(builder, builder.CreateVector(reuseEntries)));
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(builder.GetBufferPointer()),
+                   static_cast<std::streamsize>(builder.GetSize()));
+    }
+
+    /// Merged states with an overview and 8 functions, like the top valued ones a guide is asked about
+    std::vector<MergedStatePtr> buildMergedStates(int count) {
+        std::vector<MergedStatePtr> mergedStates;
+        for (int id = 0; id < count; id++) {
+            MergedStatePtr mergedState = std::make_shared<MergedState>(buildState(50, id % 2), id);
+            nlohmann::ordered_json overview;
+            overview["Overview"] = "A list of the songs in playlist " + std::to_string(id) +
+                                   ", each row can be played, liked or shared, the toolbar searches.";
+            for (int function = 0; function < 8; function++) {
+                overview["Function List"]["Play the \"song " + std::to_string(function) + "\" of the list"] = 8 - function;
+            }
+            mergedState->updateFromStateOverview(overview);
+            mergedStates.push_back(mergedState);
+        }
+        return mergedStates;
+    }
+
+    const char *BenchInstructions = "I'm now testing an app called bench on Android.\n"
+                                    "Choose the page and the function to test next, answer in json.\n";
+
+    void reportAllocations(benchmark::State &state, int64_t before) {
+        state.counters["allocs"] = benchmark::Counter(
+                static_cast<double>(allocations.load(std::memory_order_relaxed) - before),
+                benchmark::Counter::kAvgIterations);
+    }
+
+}
+
+static void BM_CreateFromXml(benchmark::State &state) {
+    std::string xml = bench::syntheticTree(static_cast<int>(state.range(0)));
+    for (auto _: state) {
+        benchmark::DoNotOptimize(Element::createFromXml(xml));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * xml.size()));
+}
+BENCHMARK(BM_CreateFromXml)->Arg(50)->Arg(200)->Arg(800);
+
+static void BM_CreateFromXmlRecorded(benchmark::State &state) {
+    const std::vector<std::string> &trees = bench::recordedTrees();
+    if (trees.empty()) {
+        state.SkipWithError("set FASTBOT_BENCH_TREES to a directory of dumped pages");
+        return;
+    }
+    size_t bytes = 0;
+    for (auto _: state) {
+        for (const std::string &xml: trees) {
+            benchmark::DoNotOptimize(Element::createFromXml(xml));
+            bytes += xml.size();
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_CreateFromXmlRecorded);
+
+static void BM_ReuseStateCreate(benchmark::State &state) {
+    ElementPtr element = Element::createFromXml(bench::syntheticTree(static_cast<int>(state.range(0))));
+    for (auto _: state) {
+        benchmark::DoNotOptimize(ReuseState::create(element, benchActivity()));
+    }
+}
+BENCHMARK(BM_ReuseStateCreate)->Arg(50)->Arg(200)->Arg(800);
+
+static void BM_ComputeSimilarity(benchmark::State &state) {
+    int nodes = static_cast<int>(state.range(0));
+    ReuseStatePtr first = buildState(nodes, 0);
+    ReuseStatePtr second = buildState(nodes, 1);
+    for (auto _: state) {
+        benchmark::DoNotOptimize(first->computeSimilarity(second));
+    }
+}
+BENCHMARK(BM_ComputeSimilarity)->Arg(50)->Arg(200)->Arg(800);
+
+static void BM_FindMostSimilar(benchmark::State &state) {
+    if (!bench::agentConfigAvailable()) {
+        state.SkipWithError("the agent needs /sdcard/config.json");
+        return;
+    }
+    std::shared_ptr<BenchAgent> agent = createAgent();
+    auto nop = std::make_shared<Action>(ActionType::NOP);
+    int mergedStates = static_cast<int>(state.range(0));
+    for (int id = 0; id < mergedStates; id++) {
+        ReuseStatePtr root = buildState(120, id);
+        auto mergedState = std::make_shared<MergedState>(root, id);
+        root->setMergedState(mergedState);
+        agent->mergedStateGraph()->addNode(mergedState, nop, false);
+    }
+    // unlike the current merged state, so every merged state is compared
+    ReuseStatePtr page = buildState(200, mergedStates + 1);
+    for (auto _: state) {
+        benchmark::DoNotOptimize(agent->findMostSimilar(page));
+    }
+}
+BENCHMARK(BM_FindMostSimilar)->Arg(10)->Arg(50)->Arg(200);
+
+static void BM_FindPath(benchmark::State &state) {
+    int states = static_cast<int>(state.range(0));
+    GraphPtr graph = std::make_shared<Graph>();
+    std::vector<ReuseStatePtr> added;
+    FastRandom random(static_cast<uint64_t>(states));
+    ReuseStatePtr current;
+    // a random walk over the states, as exploring does, adding an edge from each state to the next one
+    auto moveTo = [&](const ReuseStatePtr &next) {
+        if (current && !current->getActions().empty()) {
+            const auto &actions = current->getActions();
+            current->_actionToPerform = actions[random.nextInt(0, static_cast<int>(actions.size()))];
+        }
+        current = std::dynamic_pointer_cast<ReuseState>(graph->addState(next));
+        return current;
+    };
+    for (int id = 0; id < states; id++) {
+        ReuseStatePtr reuseState = moveTo(buildState(60, id));
+        reuseState->setMergedState(std::make_shared<MergedState>(reuseState, id));
+        added.push_back(reuseState);
+    }
+    for (int step = 0; step < states * 3; step++) {
+        moveTo(added[random.nextInt(0, states)]);
+    }
+    int destination = added[states / 2]->getIdi();
+    for (auto _: state) {
+        benchmark::DoNotOptimize(graph->findPath(destination, false));
+    }
+}
+BENCHMARK(BM_FindPath)->Arg(10)->Arg(20)->Arg(40);
+
+static void BM_StateDescriptionHtml(benchmark::State &state) {
+    int nodes = static_cast<int>(state.range(0));
+    for (auto _: state) {
+        // the html description is cached by the state, describe a fresh one each time
+        state.PauseTiming();
+        ReuseStatePtr reuseState = buildState(nodes, 0);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(reuseState->getStateDescription(DescriptionFormat::HTML));
+    }
+}
+BENCHMARK(BM_StateDescriptionHtml)->Arg(50)->Arg(200)->Arg(800);
+
+static void BM_StateDescriptionCompact(benchmark::State &state) {
+    int nodes = static_cast<int>(state.range(0));
+    for (auto _: state) {
+        // the compact description is cached as well
+        state.PauseTiming();
+        ReuseStatePtr reuseState = buildState(nodes, 0);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(reuseState->getStateDescription(DescriptionFormat::COMPACT));
+    }
+}
+BENCHMARK(BM_StateDescriptionCompact)->Arg(50)->Arg(200)->Arg(800);
+
+static void BM_ResolvePage(benchmark::State &state) {
+    // with the rules of the max.* files on the device, if any
+    PreferencePtr preference = Preference::inst();
+    std::string xml = bench::syntheticTree(static_cast<int>(state.range(0)));
+    for (auto _: state) {
+        // resolving prunes the tree, resolve a fresh one each time
+        state.PauseTiming();
+        ElementPtr element = Element::createFromXml(xml);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(preference->resolvePageAndGetSpecifiedAction(BenchActivity, element));
+    }
+}
+BENCHMARK(BM_ResolvePage)->Arg(50)->Arg(200)->Arg(800);
+
+static void BM_ReuseModelLoad(benchmark::State &state) {
+    if (!bench::agentConfigAvailable()) {
+        state.SkipWithError("the agent needs /sdcard/config.json");
+        return;
+    }
+    writeReuseModel(benchModelPath(), static_cast<int>(state.range(0)));
+    std::shared_ptr<BenchAgent> agent = createAgent();
+    for (auto _: state) {
+        agent->loadReuseModel(BenchPackage);
+    }
+}
+BENCHMARK(BM_ReuseModelLoad)->Arg(1000)->Arg(20000);
+
+static void BM_ReuseModelSave(benchmark::State &state) {
+    if (!bench::agentConfigAvailable()) {
+        state.SkipWithError("the agent needs /sdcard/config.json");
+        return;
+    }
+    writeReuseModel(benchModelPath(), static_cast<int>(state.range(0)));
+    std::shared_ptr<BenchAgent> agent = createAgent();
+    std::string savePath = benchModelPath() + ".saved";
+    for (auto _: state) {
+        agent->saveReuseModel(savePath);
+    }
+}
+BENCHMARK(BM_ReuseModelSave)->Arg(1000)->Arg(20000);
+
+static void BM_PromptStringstream(benchmark::State &state) {
+    // the guide prompt and its request body as they were built before PromptBuilder
+    std::vector<MergedStatePtr> mergedStates = buildMergedStates(static_cast<int>(state.range(0)));
+    liboai::Conversation conversation;
+    int64_t before = allocations.load(std::memory_order_relaxed);
+    for (auto _: state) {
+        std::stringstream system;
+        std::stringstream prompt;
+        system << BenchInstructions;
+        nlohmann::ordered_json states;
+        for (const MergedStatePtr &mergedState: mergedStates) {
+            std::string key = "State" + std::to_string(mergedState->getId());
+            states[key]["Overview"] = mergedState->getOverview();
+            auto functions = mergedState->untestedFunctions();
+            if (functions.size() > 5) {
+                functions.resize(5);
+            }
+            states[key]["FunctionList"] = functions;
+        }
+        prompt << "\n```State Informations\n" << states.dump(4) << "\n```\n";
+        conversation.PopSystemData();
+        conversation.SetSystemData(system.str());
+        conversation.AddUserData(prompt.str());
+        // ChatCompletion::create, which copied the messages into the body, and curl, which copied the body
+        nlohmann::json body;
+        body["model"] = "gpt-4o-mini";
+        body["temperature"] = 0.0;
+        body["messages"] = conversation.GetJSON()["messages"];
+        std::string posted = body.dump();
+        benchmark::DoNotOptimize(std::string(posted));
+        conversation.PopFirstUserData();
+    }
+    reportAllocations(state, before);
+}
+BENCHMARK(BM_PromptStringstream)->Arg(5)->Arg(10);
+
+static void BM_PromptBuilder(benchmark::State &state) {
+    std::vector<MergedStatePtr> mergedStates = buildMergedStates(static_cast<int>(state.range(0)));
+    PromptBuilder builder;
+    int64_t before = allocations.load(std::memory_order_relaxed);
+    for (auto _: state) {
+        builder.clear();
+        builder.system() << BenchInstructions;
+        PromptText &prompt = builder.user();
+        prompt << "\n```State Informations\n{";
+        for (size_t i = 0; i < mergedStates.size(); i++) {
+            if (i > 0) { prompt << ','; }
+            mergedStates[i]->writeOverviewAndTop5(prompt);
+        }
+        prompt << "}\n```\n";
+        benchmark::DoNotOptimize(builder.requestBody("gpt-4o-mini", builder.system().str(), prompt.str()));
+    }
+    reportAllocations(state, before);
+}
+BENCHMARK(BM_PromptBuilder)->Arg(5)->Arg(10);
+
+BENCHMARK_MAIN();
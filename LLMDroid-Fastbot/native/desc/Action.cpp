@@ -66,6 +66,7 @@ namespace fastbotx {
 
     void Action::setPriority(int priority) {
         this->_priority = priority;
+        this->_priorityDirty = false;
     }
 
     std::string Action::toString() const {
@@ -286,6 +287,7 @@ namespace fastbotx {
 
     void ActivityStateAction::visit(time_t timestamp) {
         Node::visit(timestamp);
+        this->markPriorityDirty();
         if (_functionListener) {
             _functionListener->onActionExecuted(shared_from_this());
         }
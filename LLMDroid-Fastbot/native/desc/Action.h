@@ -41,6 +41,12 @@ namespace fastbotx {
 
         int getPriorityByActionType() const;
 
+        /// Whether something the priority depends on changed since setPriority, see
+        /// AbstractAgent::adjustActions
+        bool isPriorityDirty() const { return this->_priorityDirty; }
+
+        void markPriorityDirty() { this->_priorityDirty = true; }
+
         bool isBack() const { return this->_actionType == ActionType::BACK; }
 
         bool isClick() const { return this->_actionType == ActionType::CLICK; }
@@ -93,6 +99,7 @@ namespace fastbotx {
         ActionType _actionType;
         static int _throttle;
         std::string _inputText;
+        bool _priorityDirty{true};
     private:
         float _qValue;
         PropertyIDPrefix(Action);
@@ -138,7 +145,10 @@ class ActivityStateAction : public Action, public std::enable_shared_from_this<A
         bool isValid() const override;
 
         // set target widget without updating hash code
-        void setTarget(WidgetPtr widget) { this->_target = std::move(widget); }
+        void setTarget(WidgetPtr widget) {
+            this->_target = std::move(widget);
+            this->markPriorityDirty();
+        }
 
         OperatePtr toOperate() const override;
 
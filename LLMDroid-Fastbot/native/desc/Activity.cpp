@@ -33,11 +33,9 @@ namespace fastbotx {
         for (auto widget : state->getValuableWidgets())
         {
 //Find based on location hash
-            auto valuableWidget = std::find_if(_valuableWigets.begin(), _valuableWigets.end(), [widget](ValuableWidgetPtr predicate){
-                return widget->getBounds()->hash2() == predicate->hash();
-            });
+            auto valuableWidget = _boundsMap.find(widget->getBounds()->hash2());
 //There is no hash for this position in valuableWidgets
-            if (valuableWidget == _valuableWigets.end())
+            if (valuableWidget == _boundsMap.end())
             {
 //First try to search in the table to see if the component is displaced due to page sliding.
                 auto it = _widgetMap.find(widget->hash());
@@ -52,6 +50,7 @@ namespace fastbotx {
                 {
                     ValuableWidgetPtr newWidget= std::make_shared<ValuableWidget>(widget);
                     _valuableWigets.push_back(newWidget);
+                    _boundsMap[newWidget->hash()] = newWidget;
                     _widgetMap[widget->hash()] = newWidget;
                     MLOG("Activity: add a new valuable widget: %s", widget->toString().c_str());
                 }
@@ -61,8 +60,8 @@ namespace fastbotx {
             {
 //Add widget information to it
                 MLOG("Activity: find valuableWidget through bound's hash");
-                (*valuableWidget)->fillDetails(widget);
-                _widgetMap[widget->hash()] = *valuableWidget;
+                valuableWidget->second->fillDetails(widget);
+                _widgetMap[widget->hash()] = valuableWidget->second;
             }
         }
     }
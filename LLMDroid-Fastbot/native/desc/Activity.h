@@ -68,6 +68,8 @@ namespace fastbotx {
     private:
         std::string _name;
         std::vector<ValuableWidgetPtr> _valuableWigets;
+        // bounds hash (Rect::hash2) => the valuable widget at these bounds
+        std::map<uintptr_t, ValuableWidgetPtr> _boundsMap;
         std::map<uintptr_t, ValuableWidgetPtr> _widgetMap;
         ActivityGraphEdgeSet _edges;
         bool _isVisited;
@@ -37,6 +37,7 @@ namespace fastbotx {
         if (iter != parentOfElement.lock()->_children.end()) {
             parentOfElement.lock()->_childCount--;
             parentOfElement.lock()->_children.erase(iter);
+            parentOfElement.lock()->invalidateHash();
         }
         this->_parent.reset();
     }
@@ -411,7 +412,55 @@ namespace fastbotx {
     }
 
     long Element::hash(bool recursive) {
-        uintptr_t hashcode = 0x1;
+        if (!this->_nodeHashValid) {
+            this->_nodeHash = computeNodeHash();
+            this->_nodeHashValid = true;
+        }
+        if (!recursive) {
+            return this->_nodeHash;
+        }
+        if (!this->_subtreeHashValid) {
+            // post-order: children are settled first, so every node is hashed exactly once
+            uintptr_t hashcode = this->_nodeHash;
+            this->_firstValidText = this->validText.empty() ? nullptr : &this->validText;
+            for (int i = 0; i < this->_children.size(); i++) {
+                const ElementPtr &child = this->_children[i];
+#if HASH_LAYOUT_VERSION >= 2
+                hashcode = fastMix(hashcode ^ static_cast<uintptr_t>(child->hash()), 0x7398c + i);
+#else
+                long childHash = child->hash() << 2;
+                hashcode ^= childHash;
+                // with order
+                hashcode ^= 0x7398c + (std::hash<int>{}(i) << 8);
+#endif
+                if (!this->_firstValidText) {
+                    this->_firstValidText = child->_firstValidText;
+                }
+            }
+            this->_subtreeHash = static_cast<long>(hashcode);
+            this->_subtreeHashValid = true;
+        }
+        return this->_subtreeHash;
+    }
+
+    long Element::computeNodeHash() const {
+        // the remaining attributes read by Widget/RichWidget
+        uintptr_t operateMask = (this->_enabled ? 0x1 : 0) | (this->_checkable ? 0x2 : 0) |
+                                (this->_scrollable ? 0x4 : 0) |
+                                (this->_longClickable ? 0x8 : 0);
+        uintptr_t boundsHash = this->_bounds ? this->_bounds->hash() : 0x1;
+#if HASH_LAYOUT_VERSION >= 2
+        uint64_t hashcode = fastHash(this->_resourceID, 0x1);
+        hashcode = fastHash(this->_classname, hashcode);
+        hashcode = fastHash(this->_packageName, hashcode);
+        hashcode = fastHash(this->_text, hashcode);
+        hashcode = fastHash(this->_contentDesc, hashcode);
+        hashcode = fastHash(this->_activity, hashcode);
+        hashcode = fastHash(this->validText, hashcode);
+        operateMask |= this->_clickable ? 0x10 : 0;
+        hashcode = fastMix(hashcode ^ operateMask, (static_cast<uint64_t>(this->_index) << 32) ^ boundsHash);
+        return static_cast<long>(hashcode);
+#else
         uintptr_t hashcode1 = 127U * std::hash<std::string>{}(this->_resourceID) << 1;
         uintptr_t hashcode2 = std::hash<std::string>{}(this->_classname) << 2;
         uintptr_t hashcode3 = std::hash<std::string>{}(this->_packageName) << 3;
@@ -419,18 +468,32 @@ namespace fastbotx {
         uintptr_t hashcode5 = std::hash<std::string>{}(this->_contentDesc) << 5;
         uintptr_t hashcode6 = std::hash<std::string>{}(this->_activity) << 2;
         uintptr_t hashcode7 = 64U * std::hash<int>{}(this->_clickable) << 6;
+        uintptr_t hashcode8 = 31U * std::hash<uintptr_t>{}(operateMask) << 7;
+        uintptr_t hashcode9 = std::hash<int>{}(this->_index) << 3;
+        uintptr_t hashcode10 = boundsHash << 1;
+        uintptr_t hashcode11 = std::hash<std::string>{}(this->validText) << 5;
+        return static_cast<long>(hashcode1 ^ hashcode2 ^ hashcode3 ^ hashcode4 ^ hashcode5 ^
+                                 hashcode6 ^ hashcode7 ^ hashcode8 ^ hashcode9 ^ hashcode10 ^
+                                 hashcode11);
+#endif
+    }
 
-        hashcode =
-                hashcode1 ^ hashcode2 ^ hashcode3 ^ hashcode4 ^ hashcode5 ^ hashcode6 ^ hashcode7;
-        if (recursive) {
-            for (int i = 0; i < this->_children.size(); i++) {
-                long childHash = this->_children[i]->hash() << 2;
-                hashcode ^= childHash;
-                // with order
-                hashcode ^= 0x7398c + (std::hash<int>{}(i) << 8);
-            }
+    const std::string &Element::getFirstValidText() {
+        static const std::string emptyText;
+        hash(true);
+        return this->_firstValidText ? *this->_firstValidText : emptyText;
+    }
+
+    void Element::invalidateHash() {
+        this->_nodeHashValid = false;
+        std::atomic_store(&this->_htmlFragment, HtmlFragmentPtr());
+        // an ancestor can only hold a valid subtree hash if this one does as well
+        Element *element = this;
+        while (element && element->_subtreeHashValid) {
+            element->_subtreeHashValid = false;
+            auto parent = element->_parent.lock();
+            element = parent.get() != element ? parent.get() : nullptr;
         }
-        return static_cast<long >(hashcode);
     }
 
     void Element::addAction(ActionInState act) {
@@ -506,27 +569,41 @@ namespace fastbotx {
 
     std::string
     Element::toHTML(const std::vector<ElementPtr> &elementToMerge, bool noChild, int actionId) {
-        std::stringstream infoStr;
+        HtmlFragmentPtr fragment = toHTMLFragment(elementToMerge);
+        std::string html;
+        html.reserve(fragment->html.size() + 24);
+        appendHTML(html, *fragment, actionId == -1 ? getId() : actionId, noChild);
+        return html;
+    }
 
-        HTML_CLASS html_class = getHtmlClass();
+    HtmlFragmentPtr Element::toHTMLFragment(const std::vector<ElementPtr> &elementToMerge) {
+        if (elementToMerge.empty()) {
+            HtmlFragmentPtr memoized = std::atomic_load(&this->_htmlFragment);
+            if (memoized) {
+                return memoized;
+            }
+        }
+        auto fragment = std::make_shared<HtmlFragment>();
+        std::string &html = fragment->html;
+        html.reserve(128);
 
-        infoStr << "<" << htmlClass[html_class] << " ";
+        HTML_CLASS html_class = getHtmlClass();
+        fragment->htmlClass = html_class;
 
-        if (html_class != HTML_CLASS::P) {
-            infoStr << "id=" << (actionId == -1 ? getId() : actionId) << " ";
-        }
+        html.append("<").append(htmlClass[html_class]).append(" ");
+        fragment->idPos = html.size();
 
         // Get the view type based on class name
         std::string className = getClassnameTrunc();
         if (!className.empty()) {
-            infoStr << "class=\"" << className << "\" ";
+            html.append("class=\"").append(className).append("\" ");
         }
         else {
             std::string childClassName;
             for (const auto &child: elementToMerge) {
                 childClassName = child->getClassnameTrunc();
                 if (!childClassName.empty()) {
-                    infoStr << "class=\"" << childClassName << "\" ";
+                    html.append("class=\"").append(childClassName).append("\" ");
                     break;
                 }
             }
@@ -535,53 +612,141 @@ namespace fastbotx {
         // resource-id
         std::string resource_id = getResourceIDTrunc();
         if (!resource_id.empty()) {
-            infoStr << "resource-id=\"" << resource_id << "\" ";
+            html.append("resource-id=\"").append(resource_id).append("\" ");
         }
         else {
             std::string childResourceID;
             for (const auto &child: elementToMerge) {
                 childResourceID = child->getResourceIDTrunc();
                 if (!childResourceID.empty()) {
-                    infoStr << "resource-id=\"" << childResourceID << "\" ";
+                    html.append("resource-id=\"").append(childResourceID).append("\" ");
                     break;
                 }
             }
         }
 
         // content-desc(label)
-        std::string description = getContentDesc();
+        const std::string &description = getContentDesc();
         if (!description.empty()) {
-            infoStr << "content-desc=\"" << description << "\" ";
+            html.append("content-desc=\"").append(description).append("\" ");
         }
 
         // Add special attributes
-        infoStr << getHtmlSpecialAttribute(html_class);
+        html.append(getHtmlSpecialAttribute(html_class));
 
-        infoStr << ">";
+        html.append(">");
 
         // text
-        std::string text = getText();
+        const std::string &text = getText();
         bool fatherEmpty = text.empty();
         if (!fatherEmpty) {
-            infoStr << text;
+            html.append(text);
         }
         bool firstFlag = true;
         for (const auto &child: elementToMerge) {
-            std::string childText = child->getText();
+            const std::string &childText = child->getText();
             if (!childText.empty()) {
                 if (firstFlag && fatherEmpty) {
-                    infoStr << childText;
+                    html.append(childText);
                     firstFlag = false;
                 } else {
-                    infoStr << " <br> " << childText;
+                    html.append(" <br> ").append(childText);
                 }
             }
         }
 
-        if (noChild) { infoStr << htmlEndTag[html_class]; }
-        infoStr << "\n";
+        if (elementToMerge.empty()) {
+            std::atomic_store(&this->_htmlFragment, HtmlFragmentPtr(fragment));
+        }
+        return fragment;
+    }
 
-        return infoStr.str();
+    void Element::appendHTML(std::string &out, const HtmlFragment &fragment, int id, bool noChild) {
+        out.append(fragment.html, 0, fragment.idPos);
+        if (fragment.htmlClass != HTML_CLASS::P) {
+            out.append("id=").append(std::to_string(id)).append(" ");
+        }
+        out.append(fragment.html, fragment.idPos, std::string::npos);
+        if (noChild) { out.append(htmlEndTag[fragment.htmlClass]); }
+        out.append("\n");
+    }
+
+    std::string Element::toCompact(const std::vector<ElementPtr> &elementToMerge, int actionId) {
+        HtmlFragmentPtr fragment = toCompactFragment(elementToMerge);
+        std::string line;
+        line.reserve(fragment->html.size() + 8);
+        appendCompact(line, *fragment, actionId == -1 ? getId() : actionId);
+        return line;
+    }
+
+    HtmlFragmentPtr Element::toCompactFragment(const std::vector<ElementPtr> &elementToMerge) {
+        auto fragment = std::make_shared<HtmlFragment>();
+        std::string &line = fragment->html;
+        line.reserve(64);
+
+        HTML_CLASS html_class = getHtmlClass();
+        fragment->htmlClass = html_class;
+        line.append(compactTag[html_class]);
+        fragment->idPos = line.size();
+
+        // same fallbacks to the merged elements as toHTMLFragment
+        std::string className = getClassnameTrunc();
+        for (auto it = elementToMerge.begin(); className.empty() && it != elementToMerge.end(); ++it) {
+            className = (*it)->getClassnameTrunc();
+        }
+        if (!className.empty()) {
+            line.append(" .").append(className);
+        }
+        std::string resource_id = getResourceIDTrunc();
+        for (auto it = elementToMerge.begin(); resource_id.empty() && it != elementToMerge.end(); ++it) {
+            resource_id = (*it)->getResourceIDTrunc();
+        }
+        if (!resource_id.empty()) {
+            line.append(" @").append(resource_id);
+        }
+        const std::string &description = getContentDesc();
+        if (!description.empty()) {
+            line.append(" \"").append(description).append("\"");
+        }
+        if (html_class == HTML_CLASS::SCROLLER) {
+            switch (getScrollType()) {
+                case ScrollType::ALL:
+                    line.append(" dir:vh");
+                    break;
+                case ScrollType::Horizontal:
+                    line.append(" dir:h");
+                    break;
+                case ScrollType::Vertical:
+                    line.append(" dir:v");
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        bool hasText = false;
+        const std::string &text = getText();
+        if (!text.empty()) {
+            line.append(": ").append(text);
+            hasText = true;
+        }
+        for (const auto &child: elementToMerge) {
+            const std::string &childText = child->getText();
+            if (!childText.empty()) {
+                line.append(hasText ? " | " : ": ").append(childText);
+                hasText = true;
+            }
+        }
+        return fragment;
+    }
+
+    void Element::appendCompact(std::string &out, const HtmlFragment &fragment, int id) {
+        out.append(fragment.html, 0, fragment.idPos);
+        if (fragment.htmlClass != HTML_CLASS::P) {
+            out.append("#").append(std::to_string(id));
+        }
+        out.append(fragment.html, fragment.idPos, std::string::npos);
+        out.append("\n");
     }
 }
 #endif //Element_CPP_
@@ -49,6 +49,25 @@ namespace fastbotx {
 
     typedef std::shared_ptr<Xpath> XpathPtr;
 
+    /// An element rendered as html, with its id and closing tag left out so that
+    /// the same fragment can be spliced into the description of any state
+    struct HtmlFragment {
+        std::string html;
+        // where "id=N " belongs, right after "<tag "
+        size_t idPos;
+        HTML_CLASS htmlClass;
+    };
+
+    typedef std::shared_ptr<const HtmlFragment> HtmlFragmentPtr;
+
+    /// How a page is written into LLM prompts
+    enum class DescriptionFormat {
+        // nested html tags, see Element::toHTML
+        HTML,
+        // one line per element, nesting by indentation, see Element::toCompact
+        COMPACT
+    };
+
 
 ///sdcard/max.feedmodel/structure
 ////sdcard/max.tree.pruning
@@ -110,28 +129,56 @@ namespace fastbotx {
         ScrollType getScrollType() const;
 
         // reset properties, in Preference
-        void reSetResourceID(const std::string &resourceID) { this->_resourceID = resourceID; }
+        void reSetResourceID(const std::string &resourceID) {
+            this->_resourceID = resourceID;
+            invalidateHash();
+        }
 
-        void reSetContentDesc(const std::string &content) { this->_contentDesc = content; }
+        void reSetContentDesc(const std::string &content) {
+            this->_contentDesc = content;
+            invalidateHash();
+        }
 
-        void reSetText(const std::string &text) { this->_text = text; }
+        void reSetText(const std::string &text) {
+            this->_text = text;
+            invalidateHash();
+        }
 
-        void reSetIndex(const int &index) { this->_index = index; }
+        void reSetIndex(const int &index) {
+            this->_index = index;
+            invalidateHash();
+        }
 
-        void reSetClassname(const std::string &className) { this->_classname = className; }
+        void reSetClassname(const std::string &className) {
+            this->_classname = className;
+            invalidateHash();
+        }
 
-        void reSetClickable(bool clickable) { this->_clickable = clickable; }
+        void reSetClickable(bool clickable) {
+            this->_clickable = clickable;
+            invalidateHash();
+        }
 
-        void reSetScrollable(bool scrollable) { this->_scrollable = scrollable; }
+        void reSetScrollable(bool scrollable) {
+            this->_scrollable = scrollable;
+            invalidateHash();
+        }
 
-        void reSetEnabled(bool enable) { this->_enabled = enable; }
+        void reSetEnabled(bool enable) {
+            this->_enabled = enable;
+            invalidateHash();
+        }
 
-        void reSetBounds(RectPtr rect) { this->_bounds = std::move(rect); }
+        void reSetBounds(RectPtr rect) {
+            this->_bounds = std::move(rect);
+            invalidateHash();
+        }
 
         void reSetParent(const std::shared_ptr<Element> &parent) { this->_parent = parent; }
 
         void reAddChild(const std::shared_ptr<Element> &child) {
             this->_children.emplace_back(child);
+            invalidateHash();
         }
 
         std::string toJson() const;
@@ -146,8 +193,19 @@ namespace fastbotx {
 
         static std::shared_ptr<Element> createFromXml(const tinyxml2::XMLDocument &doc);
 
+        /// Hash of this node only, or of the whole subtree rooted at it when recursive is true.
+        /// Covers every attribute a Widget is built from, so two subtrees with the same hash
+        /// produce the same widgets. Both values are memoized, the setters above drop the cache.
+        /// \note validText is a plain member: set it before the first call (Preference does).
         long hash(bool recursive = true);
 
+        /// Drop the memoized hashes of this element and of all its ancestors
+        void invalidateHash();
+
+        /// validText of this element, or else the first non-empty one of its offspring in
+        /// document order. Computed by the same pass as hash(true).
+        const std::string &getFirstValidText();
+
         std::string validText;
 
         virtual ~Element();
@@ -162,6 +220,23 @@ namespace fastbotx {
 
         std::string toHTML(const std::vector<ElementPtr>& elementToMerge, bool noChild, int actionId = -1);
 
+        /// Render this element, plus the texts of elementToMerge, without id and closing tag.
+        /// The fragment of an element with nothing to merge is memoized on the element.
+        HtmlFragmentPtr toHTMLFragment(const std::vector<ElementPtr>& elementToMerge);
+
+        /// Append fragment to out, with its id and, if noChild, its closing tag and the line break
+        static void appendHTML(std::string &out, const HtmlFragment &fragment, int id, bool noChild);
+
+        /// One line of the compact description: tag letter, "#id", ".class", "@resource-id",
+        /// "\"content-desc\"", "dir:v|h|vh" and ": text", without closing tags
+        std::string toCompact(const std::vector<ElementPtr>& elementToMerge, int actionId = -1);
+
+        /// toHTMLFragment for the compact description, the id goes right after the tag letter
+        HtmlFragmentPtr toCompactFragment(const std::vector<ElementPtr>& elementToMerge);
+
+        /// Append a compact fragment to out, with its id and the line break
+        static void appendCompact(std::string &out, const HtmlFragment &fragment, int id);
+
         std::string getHtmlSpecialAttribute(HTML_CLASS html_class);
 
         void setId(int id) { _id = id; }
@@ -181,6 +256,8 @@ namespace fastbotx {
 
         void recursiveToXML(tinyxml2::XMLElement *xml, const Element *elm) const;
 
+        long computeNodeHash() const;
+
         std::string _resourceID;
         std::string _classname;
         std::string _packageName;
@@ -211,6 +288,16 @@ namespace fastbotx {
         int _id;
         WidgetPtr _widget;
 
+        // memoized results of hash(false) and hash(true)
+        long _nodeHash{0};
+        long _subtreeHash{0};
+        bool _nodeHashValid{false};
+        bool _subtreeHashValid{false};
+        // points to validText of this element or of an offspring, set with _subtreeHash
+        const std::string *_firstValidText{nullptr};
+        // toHTMLFragment({}), read and written through std::atomic_load/store, as both threads render
+        HtmlFragmentPtr _htmlFragment;
+
         // a construct helper
         static bool _allClickableFalse;
     };
@@ -2,6 +2,7 @@
 #define MergedState_CPP_
 
 #include "MergedState.h"
+#include "PromptBuilder.h"
 
 
 using json = nlohmann::json;
@@ -71,7 +72,7 @@ namespace fastbotx {
         _next.insert(state);
     }
 
-    std::string MergedState::stateDescription()
+    std::string MergedState::stateDescription(DescriptionFormat format)
     {
         // lock
         std::lock_guard<std::mutex> lock(_mergedStateMutex);
@@ -79,7 +80,7 @@ namespace fastbotx {
         std::stringstream ss;
         //ss << "[Root State" << _root->getIdi() << "]:\n";
         ss << "[Activity: " << *(_root->getActivityString()) << "]\n";
-        ss << _root->getStateDescription();
+        ss << _root->getStateDescription(format);
         /*for (ReuseStatePtr state: _states)
         {
             if (state != _root) {
@@ -370,25 +371,40 @@ namespace fastbotx {
         }
     }
 
-    void MergedState::writeOverviewAndTop5Tojson(nlohmann::ordered_json &top5, bool ignoreImportance) {
-        std::string key = "State" + std::to_string(_id);
-        top5[key]["Overview"] = _overview;
-        auto sortedFunctions = sortFunctionsByValue(ignoreImportance);
-        if (sortedFunctions.size() > 5) {
-            sortedFunctions.resize(5);
+    void MergedState::writeOverviewAndTop5(PromptText &prompt, bool ignoreImportance) {
+        prompt << "\"State" << _id << "\":{\"Overview\":";
+        prompt.quoted(_overview) << ",\"FunctionList\":[";
+        // the names are written while the list is locked rather than copied out of it
+        std::lock_guard<std::mutex> lock(_functionListMutex);
+        std::vector<std::pair<int, const std::string*>> functions;
+        functions.reserve(_functionList.size());
+        for (const auto& kvp : _functionList) {
+            if (kvp.second.importance > 0 || ignoreImportance) {
+                functions.emplace_back(kvp.second.importance, &kvp.first);
+            }
+        }
+        size_t count = std::min<size_t>(functions.size(), 5);
+        std::partial_sort(functions.begin(), functions.begin() + count, functions.end(),
+                          [](const std::pair<int, const std::string*>& a, const std::pair<int, const std::string*>& b) {
+                              return a.first > b.first;
+                          });
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0) { prompt << ','; }
+            prompt.quoted(*functions[i].second);
         }
-        top5[key]["FunctionList"] = sortedFunctions;
+        prompt << "]}";
     }
 
-    nlohmann::ordered_json MergedState::toJson() {
-        nlohmann::ordered_json data;
-        data["Overview"] = _overview;
-        std::vector<std::string> functions;
+    void MergedState::writeOverviewAndFunctions(PromptText &prompt) {
+        prompt << "{\"Overview\":";
+        prompt.quoted(_overview) << ",\"Function List\":[";
+        bool first = true;
         for (auto& it: _functionList) {
-            functions.push_back(it.first);
+            if (!first) { prompt << ','; }
+            prompt.quoted(it.first);
+            first = false;
         }
-        data["Function List"] = functions;
-        return data;
+        prompt << "]}";
     }
 
     std::vector<std::string> MergedState::sortFunctionsByValue(bool ignoreImportance) {
@@ -16,6 +16,7 @@ namespace fastbotx {
     typedef std::shared_ptr<MergedState> MergedStatePtr;
     class Graph;
     typedef std::shared_ptr<Graph> GraphPtr;
+    class PromptText;
     // typedef std::shared_ptr<std::queue<ActionPtr>> ActionPath;
     // typedef std::shared_ptr<std::queue<int>> StatePath;    
     // typedef std::pair<ActionPath, StatePath> Path;
@@ -98,7 +99,7 @@ namespace fastbotx {
         MergedStateGraphEdgePtr getUnvisitedEdge();
         
         // call from child thread
-        std::string stateDescription();
+        std::string stateDescription(DescriptionFormat format = DescriptionFormat::HTML);
         // call from child thread
         std::string walk();
         // call from child thread
@@ -134,6 +135,9 @@ namespace fastbotx {
 
         std::set<ReuseStatePtr>& getReuseStates() { return _states; }
 
+        /// Html fragments shared by the descriptions of all states in this MergedState
+        const HtmlFragmentCachePtr &getFragmentCache() { return _fragmentCache; }
+
         int getNavigationValue() { return _navigationValue; }
 
         /**
@@ -150,12 +154,14 @@ namespace fastbotx {
         /**
          * write overview,
          * and top5 functions in _functionList
-         * @param top5 the target json object to write into
+         * @param prompt where to write "State<id>":{"Overview":...,"FunctionList":[...]}, a member of a
+         * json object
          * @note call from child thread
          */
-        void writeOverviewAndTop5Tojson(nlohmann::ordered_json& top5, bool ignoreImportance = false);
+        void writeOverviewAndTop5(PromptText& prompt, bool ignoreImportance = false);
 
-        nlohmann::ordered_json toJson();
+        /// Write {"Overview":...,"Function List":[...]} to the prompt
+        void writeOverviewAndFunctions(PromptText& prompt);
 
         /**
          * set function to new state's widgets,
@@ -173,6 +179,9 @@ namespace fastbotx {
          */
         bool hasUntestedFunctions();
 
+        /// Untested functions, the most important first
+        std::vector<std::string> untestedFunctions() { return sortFunctionsByValue(false); }
+
         bool needReanalysed();
 
         ReuseStatePtr getTargetState(std::string function);
@@ -232,6 +241,8 @@ namespace fastbotx {
         int _navigationCount = 0;
 
         bool _needReanalysed = false;
+
+        HtmlFragmentCachePtr _fragmentCache = std::make_shared<HtmlFragmentCache>();
     };
 
     
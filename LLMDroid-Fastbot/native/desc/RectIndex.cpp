@@ -0,0 +1,97 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef RectIndex_CPP_
+#define RectIndex_CPP_
+
+#include <algorithm>
+#include "RectIndex.h"
+
+namespace fastbotx {
+
+    // a rect covering more cells than this, e.g. from bounds far off screen, is not filed
+    static const long MaxCellsPerRect = 4096;
+
+    RectIndex::RectIndex(int cellSize)
+            : _cellSize(std::max(cellSize, 1)) {
+    }
+
+    int RectIndex::cellOf(int coordinate) const {
+        // round towards negative infinity, so cells do not overlap around 0
+        int cell = coordinate / this->_cellSize;
+        if (coordinate < 0 && cell * this->_cellSize != coordinate)
+            cell--;
+        return cell;
+    }
+
+    uint64_t RectIndex::cellKey(int column, int row) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(column)) << 32) |
+               static_cast<uint32_t>(row);
+    }
+
+    void RectIndex::insert(int item, const Rect &rect) {
+        if (rect.left > rect.right || rect.top > rect.bottom)
+            return;
+        size_t entry = this->_entries.size();
+        this->_entries.push_back({item, rect});
+        int firstColumn = cellOf(rect.left), lastColumn = cellOf(rect.right);
+        int firstRow = cellOf(rect.top), lastRow = cellOf(rect.bottom);
+        long cellCount = (static_cast<long>(lastColumn) - firstColumn + 1) *
+                         (static_cast<long>(lastRow) - firstRow + 1);
+        if (cellCount > MaxCellsPerRect) {
+            this->_oversized.push_back(entry);
+            return;
+        }
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            for (int row = firstRow; row <= lastRow; row++) {
+                this->_cells[cellKey(column, row)].push_back(entry);
+            }
+        }
+    }
+
+    void RectIndex::clear() {
+        this->_entries.clear();
+        this->_cells.clear();
+        this->_oversized.clear();
+    }
+
+    void RectIndex::query(const Point &point, std::vector<int> &items) const {
+        if (this->_entries.empty())
+            return;
+        size_t first = items.size();
+        auto cell = this->_cells.find(cellKey(cellOf(point.x), cellOf(point.y)));
+        if (cell != this->_cells.end()) {
+            // a rect is filed once per cell, so a single cell holds no duplicates
+            for (size_t entry: cell->second) {
+                if (this->_entries[entry].rect.contains(point))
+                    items.push_back(this->_entries[entry].item);
+            }
+        }
+        for (size_t entry: this->_oversized) {
+            if (this->_entries[entry].rect.contains(point))
+                items.push_back(this->_entries[entry].item);
+        }
+        std::sort(items.begin() + static_cast<long>(first), items.end());
+        items.erase(std::unique(items.begin() + static_cast<long>(first), items.end()), items.end());
+    }
+
+    bool RectIndex::contains(const Point &point) const {
+        if (this->_entries.empty())
+            return false;
+        auto cell = this->_cells.find(cellKey(cellOf(point.x), cellOf(point.y)));
+        if (cell != this->_cells.end()) {
+            for (size_t entry: cell->second) {
+                if (this->_entries[entry].rect.contains(point))
+                    return true;
+            }
+        }
+        for (size_t entry: this->_oversized) {
+            if (this->_entries[entry].rect.contains(point))
+                return true;
+        }
+        return false;
+    }
+
+}
+
+#endif //RectIndex_CPP_
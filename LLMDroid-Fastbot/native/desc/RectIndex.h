@@ -0,0 +1,59 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef RectIndex_H_
+#define RectIndex_H_
+
+#include <vector>
+#include <unordered_map>
+#include "Base.h"
+
+namespace fastbotx {
+
+    /**
+     * @brief Uniform grid over rects for point queries. Each rect is filed in the
+     * cells it covers, so a query only tests the rects filed in the cell of its point
+     * instead of every rect. Rects are inclusive of their edges, like Rect::contains.
+     */
+    class RectIndex {
+    public:
+        /// \param cellSize side of a grid cell in pixels
+        explicit RectIndex(int cellSize = 128);
+
+        /// \param item number reported back by queries for this rect
+        /// \param rect ignored if inverted, i.e. left > right or top > bottom
+        void insert(int item, const Rect &rect);
+
+        void clear();
+
+        bool empty() const { return this->_entries.empty(); }
+
+        size_t size() const { return this->_entries.size(); }
+
+        /// Append the items whose rect contains point, ascending and each once
+        void query(const Point &point, std::vector<int> &items) const;
+
+        /// Whether any rect contains point
+        bool contains(const Point &point) const;
+
+    private:
+        struct Entry {
+            int item;
+            Rect rect;
+        };
+
+        int cellOf(int coordinate) const;
+
+        static uint64_t cellKey(int column, int row);
+
+        int _cellSize;
+        std::vector<Entry> _entries;
+        // cell => entries whose rect covers it
+        std::unordered_map<uint64_t, std::vector<size_t>> _cells;
+        // entries covering too many cells to file, tested on every query
+        std::vector<size_t> _oversized;
+    };
+
+}
+
+#endif //RectIndex_H_
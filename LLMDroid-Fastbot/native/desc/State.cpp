@@ -59,7 +59,7 @@ namespace fastbotx {
         StatePtr sharedPtr = std::shared_ptr<State>(new State(std::move(activityName)));
         sharedPtr->buildFromElement(nullptr, std::move(elem));
         uintptr_t activityHash =
-                (std::hash<std::string>{}(*(sharedPtr->_activity.get())) * 31U) << 5;
+                (hashString(*(sharedPtr->_activity.get())) * 31U) << 5;
         WidgetPtrSet mergedWidgets;
         int mergedWidgetCount = sharedPtr->mergeWidgetAndStoreMergedOnes(mergedWidgets);
         if (mergedWidgetCount != 0) {
@@ -144,6 +144,8 @@ namespace fastbotx {
         // }
         this->_mergedWidgets.clear();
         _hasNoDetail = true;
+        // saturation depends on the merged widgets
+        _hasActionPriorities = false;
     }
 
     void State::fillDetails(const std::shared_ptr<State> &copy) {
@@ -174,6 +176,7 @@ namespace fastbotx {
 
         }
         _hasNoDetail = false;
+        _hasActionPriorities = false;
     }
 
     std::string State::toString() const {
@@ -232,41 +235,45 @@ namespace fastbotx {
         return retA;
     }
 
-    ActivityStateActionPtr State::randomPickAction(const ActionFilterPtr &filter) const {
-        return this->randomPickAction(filter, true);
-    }
-
     ActivityStateActionPtr
-    State::randomPickAction(const ActionFilterPtr &filter, bool includeBack) const {
-        int total = this->countActionPriority(filter, includeBack);
-        if (total == 0)
-            return nullptr;
-        srand((uint32_t) (int) time(
-                nullptr)); //// this->_hashcode); // srand with hash, one sequence
-        int index = rand() % total;
-        return pickAction(filter, includeBack, index);
+    State::randomPickAction(const ActionFilterPtr &filter, FastRandom &random) const {
+        return this->randomPickAction(filter, true, random);
     }
 
     ActivityStateActionPtr
-    State::pickAction(const ActionFilterPtr &filter, bool includeBack, int index) const {
-        int ii = index;
-        for (auto action: this->_actions) {
+    State::randomPickAction(const ActionFilterPtr &filter, bool includeBack,
+                            FastRandom &random) const {
+        // one pass over the actions records the running total of priorities, the pick is then
+        // a binary search in it instead of a second pass through the filter
+        std::vector<const ActivityStateActionPtr *> candidates;
+        std::vector<int> totals;
+        candidates.reserve(this->_actions.size());
+        totals.reserve(this->_actions.size());
+        int total = 0;
+        for (const auto &action: this->_actions) {
             if (!includeBack && action->isBack())
                 continue;
-            if (filter->include(action)) {
-                int p = filter->getPriority(action);
-                if (p > ii)
-                    return action;
-                else
-                    ii = ii - p;
+            if (!filter->include(action))
+                continue;
+            int p = filter->getPriority(action);
+            if (p <= 0) {
+                BDLOG("Error: Action should has a positive priority, but we get %d", p);
+                continue;
             }
+            total += p;
+            candidates.push_back(&action);
+            totals.push_back(total);
         }
-        BDLOG("%s", "ERROR: action filter is unstable");
-        return nullptr;
+        if (total == 0)
+            return nullptr;
+        int index = random.nextInt(0, total);
+        auto picked = std::upper_bound(totals.begin(), totals.end(), index);
+        return *candidates[picked - totals.begin()];
     }
 
-    ActivityStateActionPtr State::randomPickUnvisitedAction() const {
-        ActivityStateActionPtr action = this->randomPickAction(enableValidUnvisitedFilter, false);
+    ActivityStateActionPtr State::randomPickUnvisitedAction(FastRandom &random) const {
+        ActivityStateActionPtr action = this->randomPickAction(enableValidUnvisitedFilter, false,
+                                                               random);
         if (action == nullptr && enableValidUnvisitedFilter->include(getBackAction())) {
             action = getBackAction();
         }
@@ -55,9 +55,10 @@ namespace fastbotx {
 
         ActivityStateActionPtr greedyPickMaxQValue(const ActionFilterPtr &filter) const;
 
-        ActivityStateActionPtr randomPickUnvisitedAction() const;
+        ActivityStateActionPtr randomPickUnvisitedAction(FastRandom &random) const;
 
-        ActivityStateActionPtr randomPickAction(const ActionFilterPtr &filter) const;
+        /// Pick an action the filter includes, with a chance proportional to its filter priority
+        ActivityStateActionPtr randomPickAction(const ActionFilterPtr &filter, FastRandom &random) const;
 
         ActivityStateActionPtr resolveAt(ActivityStateActionPtr action, time_t t);
 
@@ -67,6 +68,12 @@ namespace fastbotx {
 
         void setPriority(int p) { this->_priority = p; }
 
+        /// Whether the priorities of all actions and the total in getPriority are set, so that
+        /// adjustActions only needs to update the actions whose priority is dirty
+        bool hasActionPriorities() const { return this->_hasActionPriorities; }
+
+        void setHasActionPriorities(bool has) { this->_hasActionPriorities = has; }
+
         bool operator<(const State &state) const;
 
         bool operator==(const State &state) const;
@@ -99,17 +106,10 @@ namespace fastbotx {
         ///
         /// \param filter
         /// \param includeBack
+        /// \param random
         /// \return
         ActivityStateActionPtr
-        randomPickAction(const ActionFilterPtr &filter, bool includeBack) const;
-
-        ///
-        /// \param filter
-        /// \param includeBack
-        /// \param index
-        /// \return
-        ActivityStateActionPtr
-        pickAction(const ActionFilterPtr &filter, bool includeBack, int index) const;
+        randomPickAction(const ActionFilterPtr &filter, bool includeBack, FastRandom &random) const;
 
 
         uintptr_t _hashcode{}; //
@@ -120,6 +120,7 @@ namespace fastbotx {
         WidgetPtrVecMap _mergedWidgets; //
 
         bool _hasNoDetail; //
+        bool _hasActionPriorities{}; //
         static RectPtr _sameRootBounds; //
         ActivityStateActionPtr _backAction; //
     private:
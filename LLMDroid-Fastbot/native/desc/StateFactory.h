@@ -16,8 +16,10 @@ namespace fastbotx {
     class StateFactory {
     public:
 
+        /// \param previous state of the previous page, lets unchanged parts of the page be reused
         static StatePtr
-        createState(AlgorithmType agentT, const stringPtr &activity, const ElementPtr &element);
+        createState(AlgorithmType agentT, const stringPtr &activity, const ElementPtr &element,
+                    const StatePtr &previous = nullptr);
     };
 }
 #endif /* SateFactory_H_ */
@@ -3,18 +3,49 @@
 
 #include "Element.h"
 #include <stack>
+#include <mutex>
+#include <unordered_map>
 
 namespace fastbotx {
 
+    /**
+     * @brief Html fragments of elements, keyed by the node hashes of the element and of the
+     * elements merged into it. States of one MergedState share a cache, as they mostly
+     * consist of the same elements.
+     * @note accessed from both the main and the child thread
+     */
+    class HtmlFragmentCache {
+    public:
+        /// The cached fragment, rendered and added when there is none
+        HtmlFragmentPtr get(const ElementPtr &element, const std::vector<ElementPtr> &elementToMerge,
+                            DescriptionFormat format = DescriptionFormat::HTML);
+
+        /// The cached fragment, nullptr when there is none
+        HtmlFragmentPtr find(const ElementPtr &element, const std::vector<ElementPtr> &elementToMerge,
+                             DescriptionFormat format = DescriptionFormat::HTML);
+
+        size_t size();
+
+    private:
+        static uint64_t key(const ElementPtr &element, const std::vector<ElementPtr> &elementToMerge,
+                            DescriptionFormat format);
+
+        std::mutex _mutex;
+        std::unordered_map<uint64_t, HtmlFragmentPtr> _fragments;
+    };
+
+    typedef std::shared_ptr<HtmlFragmentCache> HtmlFragmentCachePtr;
+
 
     class StateStructure {
     public:
         /**
          * @brief Generate a string describing the page to gpt, obtained by traversing the ElementInState node
+         * @note written once per format, by whichever of the main and the child thread asks first
          *
          * @return std::string string describing the page to gpt
          */
-        std::string generateStateDescription(int id);
+        std::string generateStateDescription(int id, DescriptionFormat format = DescriptionFormat::HTML);
 
         const ElementPtr findElement(const uintptr_t target);
 
@@ -31,7 +62,7 @@ namespace fastbotx {
 
         const ElementPtr getFirst();
 
-        bool shouldMerge(const ElementPtr father, const ElementPtr child);
+        bool shouldMerge(const ElementPtr &father, const ElementPtr &child);
 
         ElementPtr _rootElement;
 
@@ -44,19 +75,71 @@ namespace fastbotx {
         */
         ElementPtr findElementById(int id);
 
+        /// Share the fragments of this state with the other states of its MergedState
+        void setFragmentCache(const HtmlFragmentCachePtr &cache)
+        {
+            std::lock_guard<std::mutex> lock(_descriptionMutex);
+            _fragmentCache = cache;
+            _borrowedCache = nullptr;
+        }
+
+        /// Look fragments up in the cache of a MergedState this state may not belong to, without
+        /// adding to it, until setFragmentCache() is called
+        void borrowFragmentCache(const HtmlFragmentCachePtr &cache)
+        {
+            std::lock_guard<std::mutex> lock(_descriptionMutex);
+            _borrowedCache = cache;
+        }
+
     private:
+        // guards the descriptions while they are written, tabCount and the fragment caches
+        std::mutex _descriptionMutex;
         std::string _stateDescription;
+        std::string _compactDescription;
         std::stack<ElementPtr> _stack;
         // Record the depth of recursive traversal, used to represent the structure between components
         int tabCount = 0;
         std::set<ElementPtr> _elements;
+        HtmlFragmentCachePtr _fragmentCache;
+        HtmlFragmentCachePtr _borrowedCache;
 
         /**
          * Generate description of an element 
          * call generateElementInfo and generateActionList inside
          * the result contains '\\n' at the end
         */
-        void generateElementDescription(const ElementPtr target, int& actionId, int depth, int& count);
+        void generateElementDescription(const ElementPtr &target, int& actionId, int depth, int& count,
+                                        std::vector<ElementPtr> &elementToMerge);
+
+        /**
+         * Follow the chain of single <p> children below target and fill elementToMerge
+         * @param mergeAll whether the children of the chain end may be merged when there are several
+         * @param elementToMerge reused for every element of one description, only needed until the element
+         * itself is written
+         * @return the end of the chain, whose children that are not merged are written as children of target
+        */
+        ElementPtr collectElementToMerge(const ElementPtr &target, bool mergeAll, std::vector<ElementPtr> &elementToMerge);
+
+        bool isMergedChild(const ElementPtr &chainEnd, const ElementPtr &child, bool mergeAll);
+
+        /// Fragment of target from the cache of the MergedState, or borrowed, or rendered
+        HtmlFragmentPtr fragmentOf(const ElementPtr &target, const std::vector<ElementPtr> &elementToMerge,
+                                   DescriptionFormat format);
+
+        void appendElement(const ElementPtr &target, bool noChild, const std::vector<ElementPtr> &elementToMerge);
+
+        /**
+         * Compact counterpart of generateStateDescription: one line per element indented by its
+         * depth, consecutive siblings that only differ in ids collapsed into a "+N same as above" line
+        */
+        std::string generateCompactDescription();
+
+        /// \return signature of the subtree as written, without ids, 0 if it was cut off
+        uint64_t generateCompactElement(const ElementPtr &target, int depth, int &count,
+                                        std::vector<ElementPtr> &elementToMerge);
+
+        uint64_t generateCompactChildren(const ElementPtr &chainEnd, bool mergeAll, int depth, int &count,
+                                         std::vector<ElementPtr> &elementToMerge);
 
         /**
          * @brief generates a list of actions that can be performed by a given Element.
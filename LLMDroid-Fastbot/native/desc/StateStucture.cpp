@@ -46,13 +46,10 @@ namespace fastbotx {
 
     void StateStructure::addTab()
     {
-        for (int i = 0; i < this->tabCount; i++)
-        {
-            this->_stateDescription.append("\t");
-        }
+        this->_stateDescription.append(this->tabCount, '\t');
     }
 
-    bool StateStructure::shouldMerge(const ElementPtr father, const ElementPtr child)
+    bool StateStructure::shouldMerge(const ElementPtr &father, const ElementPtr &child)
     {
         if ((child->getChildren()).empty() && 
             child->getHtmlClass() == HTML_CLASS::P && 
@@ -78,105 +75,160 @@ namespace fastbotx {
         return (found != _elements.end()) ? *found : nullptr;
     }
 
-    std::string StateStructure::generateStateDescription(int id)
+    uint64_t HtmlFragmentCache::key(const ElementPtr &element, const std::vector<ElementPtr> &elementToMerge,
+                                    DescriptionFormat format)
     {
-        if (!_stateDescription.empty()) { return _stateDescription; }
-        // begining of a state
-        int actionId = 0;
-        this->tabCount = 0;
-        this->_stateDescription = "";
-        std::vector<ElementPtr> elementToMerge;
-        std::vector<ElementPtr> elementNotMerge;
-        std::vector<ElementPtr> checkList(1, _rootElement);
-        while (!checkList.empty()) {
-            ElementPtr element = checkList[0];
-            checkList.erase(checkList.begin());
-            std::vector<ElementPtr> children = element->getChildren();
-            //callJavaLogger(MAIN_THREAD, "element to check: %s, child size: %d", element->toHTML().c_str(), children.size());
+        // node hashes are memoized while the state is built, so the key costs nothing
+        uint64_t key = fastMix(static_cast<uint64_t>(element->hash(false)),
+                               (elementToMerge.size() << 1) | (format == DescriptionFormat::COMPACT ? 1 : 0));
+        for (const auto &child : elementToMerge) {
+            key = fastMix(key ^ static_cast<uint64_t>(child->hash(false)), 0x9e3779b97f4a7c15ULL);
+        }
+        return key;
+    }
+
+    HtmlFragmentPtr HtmlFragmentCache::get(const ElementPtr &element, const std::vector<ElementPtr> &elementToMerge,
+                                           DescriptionFormat format)
+    {
+        uint64_t key = HtmlFragmentCache::key(element, elementToMerge, format);
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _fragments.find(key);
+        if (found != _fragments.end()) {
+            return found->second;
+        }
+        HtmlFragmentPtr fragment = format == DescriptionFormat::COMPACT
+                                   ? element->toCompactFragment(elementToMerge)
+                                   : element->toHTMLFragment(elementToMerge);
+        _fragments.emplace(key, fragment);
+        return fragment;
+    }
+
+    HtmlFragmentPtr HtmlFragmentCache::find(const ElementPtr &element, const std::vector<ElementPtr> &elementToMerge,
+                                            DescriptionFormat format)
+    {
+        uint64_t key = HtmlFragmentCache::key(element, elementToMerge, format);
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _fragments.find(key);
+        return found != _fragments.end() ? found->second : nullptr;
+    }
+
+    size_t HtmlFragmentCache::size()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _fragments.size();
+    }
+
+    ElementPtr StateStructure::collectElementToMerge(const ElementPtr &target, bool mergeAll,
+                                                     std::vector<ElementPtr> &elementToMerge)
+    {
+        elementToMerge.clear();
+        ElementPtr element = target;
+        while (true) {
+            const std::vector<ElementPtr> &children = element->getChildren();
             if (children.size() == 1 && children[0]->getHtmlClass() == HTML_CLASS::P) {
-                //callJavaLogger(MAIN_THREAD, "merge element above's child");
                 elementToMerge.push_back(children[0]);
-                checkList.push_back(children[0]);
+                element = children[0];
+                continue;
             }
-            else {
-                for (const auto& child : element->getChildren())
-                {
-                    if (shouldMerge(element, child)) {
-                        elementToMerge.push_back(child);
-                    }
-                    else {
-                        elementNotMerge.push_back(child);
-                    }
+            for (const auto &child : children) {
+                if (isMergedChild(element, child, mergeAll)) {
+                    elementToMerge.push_back(child);
                 }
             }
+            return element;
+        }
+    }
+
+    bool StateStructure::isMergedChild(const ElementPtr &chainEnd, const ElementPtr &child, bool mergeAll)
+    {
+        // below the root, an element with several children keeps all of them
+        return (mergeAll || chainEnd->getChildren().size() <= 1) && shouldMerge(chainEnd, child);
+    }
+
+    HtmlFragmentPtr StateStructure::fragmentOf(const ElementPtr &target, const std::vector<ElementPtr> &elementToMerge,
+                                               DescriptionFormat format)
+    {
+        if (this->_fragmentCache) {
+            return this->_fragmentCache->get(target, elementToMerge, format);
         }
+        // the borrowed cache only keeps the fragments of the states of its own MergedState
+        HtmlFragmentPtr fragment = this->_borrowedCache ? this->_borrowedCache->find(target, elementToMerge, format)
+                                                        : nullptr;
+        if (fragment) {
+            return fragment;
+        }
+        return format == DescriptionFormat::COMPACT ? target->toCompactFragment(elementToMerge)
+                                                    : target->toHTMLFragment(elementToMerge);
+    }
+
+    void StateStructure::appendElement(const ElementPtr &target, bool noChild,
+                                       const std::vector<ElementPtr> &elementToMerge)
+    {
+        HtmlFragmentPtr fragment = fragmentOf(target, elementToMerge, DescriptionFormat::HTML);
+        Element::appendHTML(this->_stateDescription, *fragment, target->getId(), noChild);
+    }
+
+    std::string StateStructure::generateStateDescription(int id, DescriptionFormat format)
+    {
+        std::lock_guard<std::mutex> lock(this->_descriptionMutex);
+        if (format == DescriptionFormat::COMPACT) { return generateCompactDescription(); }
+        if (!_stateDescription.empty()) { return _stateDescription; }
+        // begining of a state
+        int actionId = 0;
+        this->tabCount = 0;
+        this->_stateDescription.clear();
+        // a line is rarely longer than this, one allocation covers most pages
+        this->_stateDescription.reserve(this->_elements.size() * 96 + 64);
+        // one list for every element of this description, the compact one may be written meanwhile
+        std::vector<ElementPtr> elementToMerge;
+        ElementPtr chainEnd = collectElementToMerge(_rootElement, true, elementToMerge);
         // root element
-        this->_stateDescription.append(this->_rootElement->toHTML(elementToMerge, false, -1));
+        appendElement(this->_rootElement, false, elementToMerge);
         //this->_stateDescription.append(generateActionList(this->_rootElement));
         this->tabCount++;
         // child element
         int depth = 1;
         int count = 1;
-        for (const auto &child: elementNotMerge)
+        for (const auto &child: chainEnd->getChildren())
         {
-            generateElementDescription(child, actionId, depth, count);
+            if (!isMergedChild(chainEnd, child, true)) {
+                generateElementDescription(child, actionId, depth, count, elementToMerge);
+            }
         }
         // end of a state
         this->_stateDescription.append(htmlEndTag[_rootElement->getHtmlClass()]).append("\n");
         return this->_stateDescription;
     };
 
-    void StateStructure::generateElementDescription(const ElementPtr target, int& actionId, int depth, int& count)
+    void StateStructure::generateElementDescription(const ElementPtr &target, int& actionId, int depth, int& count,
+                                                    std::vector<ElementPtr> &elementToMerge)
     {
         if (depth >= 25 || count >= 100) {
             callJavaLogger(MAIN_THREAD, "[StateStructure] depth: %d, count: %d, stop generating", depth, count);
             return;
         }
         addTab();
-        std::vector<ElementPtr> elementToMerge;
-        std::vector<ElementPtr> elementNotMerge;
-        std::vector<ElementPtr> checkList(1, target);
-
-        while (!checkList.empty()) {
-            ElementPtr element = checkList[0];
-            checkList.erase(checkList.begin());
-            std::vector<ElementPtr> children = element->getChildren();
-            //callJavaLogger(MAIN_THREAD, "element to check: %s, child size: %d", element->toHTML().c_str(), children.size());
-            if (children.size() == 1 && children[0]->getHtmlClass() == HTML_CLASS::P) {
-                //callJavaLogger(MAIN_THREAD, "merge element above's child");
-                elementToMerge.push_back(children[0]);
-                checkList.push_back(children[0]);
-            }
-            else {
-                if (children.size() > 1) {
-                    for (const auto& child : children) {
-                        elementNotMerge.push_back(child);
-                    }
-                }
-                else {
-                    for (const auto& child : children)
-                    {
-                        if (shouldMerge(element, child)) {
-                            elementToMerge.push_back(child);
-                        }
-                        else {
-                            elementNotMerge.push_back(child);
-                        }
-                    }
-                }
+        ElementPtr chainEnd = collectElementToMerge(target, false, elementToMerge);
+        bool noChild = true;
+        for (const auto &child: chainEnd->getChildren())
+        {
+            if (!isMergedChild(chainEnd, child, false)) {
+                noChild = false;
+                break;
             }
         }
-        bool noChild = elementNotMerge.empty();
         // Write the text part of the element
         count++;
-        this->_stateDescription.append(target->toHTML(elementToMerge, noChild, -1));
+        appendElement(target, noChild, elementToMerge);
         // Write the executable action for this element
         // this->_stateDescription.append(generateActionList(target));
         // recursion
         this->tabCount++;
-        for (const auto &child: elementNotMerge)
+        for (const auto &child: chainEnd->getChildren())
         {
-            generateElementDescription(child, actionId, depth + 1, count);
+            if (!isMergedChild(chainEnd, child, false)) {
+                generateElementDescription(child, actionId, depth + 1, count, elementToMerge);
+            }
         }
         this->tabCount--;
         if (!noChild) {
@@ -185,6 +237,95 @@ namespace fastbotx {
         }        
     }
 
+    std::string StateStructure::generateCompactDescription()
+    {
+        if (!_compactDescription.empty()) { return _compactDescription; }
+        this->_compactDescription.reserve(this->_elements.size() * 48 + 64);
+        std::vector<ElementPtr> elementToMerge;
+        ElementPtr chainEnd = collectElementToMerge(_rootElement, true, elementToMerge);
+        HtmlFragmentPtr fragment = fragmentOf(_rootElement, elementToMerge, DescriptionFormat::COMPACT);
+        Element::appendCompact(this->_compactDescription, *fragment, _rootElement->getId());
+        int count = 1;
+        generateCompactChildren(chainEnd, true, 1, count, elementToMerge);
+        return this->_compactDescription;
+    }
+
+    uint64_t StateStructure::generateCompactElement(const ElementPtr &target, int depth, int &count,
+                                                    std::vector<ElementPtr> &elementToMerge)
+    {
+        if (depth >= 25 || count >= 100) {
+            callJavaLogger(MAIN_THREAD, "[StateStructure] depth: %d, count: %d, stop generating", depth, count);
+            return 0;
+        }
+        this->_compactDescription.append(depth, ' ');
+        ElementPtr chainEnd = collectElementToMerge(target, false, elementToMerge);
+        HtmlFragmentPtr fragment = fragmentOf(target, elementToMerge, DescriptionFormat::COMPACT);
+        count++;
+        Element::appendCompact(this->_compactDescription, *fragment, target->getId());
+        uint64_t children = generateCompactChildren(chainEnd, false, depth + 1, count, elementToMerge);
+        return fastMix(fastHash(fragment->html), children);
+    }
+
+    uint64_t StateStructure::generateCompactChildren(const ElementPtr &chainEnd, bool mergeAll, int depth, int &count,
+                                                     std::vector<ElementPtr> &elementToMerge)
+    {
+        std::string &out = this->_compactDescription;
+        uint64_t signature = 0;
+        uint64_t runSignature = 0;
+        // ids of the collapsed rows, "/" between the ids of one row, ", " between rows
+        std::string runIds;
+        int runLength = 0;
+        auto flushRun = [&](size_t position) {
+            if (runLength > 0) {
+                std::string line(depth, ' ');
+                line.append("+").append(std::to_string(runLength)).append(" same as above");
+                if (!runIds.empty()) {
+                    line.append(": ").append(runIds);
+                }
+                line.append("\n");
+                out.insert(position, line);
+            }
+            runIds.clear();
+            runLength = 0;
+        };
+        for (const auto &child: chainEnd->getChildren())
+        {
+            if (isMergedChild(chainEnd, child, mergeAll)) {
+                continue;
+            }
+            size_t start = out.size();
+            int countBefore = count;
+            uint64_t childSignature = generateCompactElement(child, depth, count, elementToMerge);
+            signature = fastMix(signature ^ childSignature, 0x7398c);
+            if (childSignature != 0 && childSignature == runSignature) {
+                // keep only the ids of a repeated row, every line starts with indentation and a tag letter
+                std::string rowIds;
+                size_t lineStart = start;
+                while (lineStart < out.size()) {
+                    size_t hashPos = out.find_first_not_of(' ', lineStart) + 1;
+                    size_t lineEnd = out.find('\n', lineStart);
+                    if (hashPos < lineEnd && out[hashPos] == '#') {
+                        size_t idEnd = out.find_first_not_of("0123456789", hashPos + 1);
+                        rowIds.append(rowIds.empty() ? "" : "/").append(out, hashPos, idEnd - hashPos);
+                    }
+                    lineStart = lineEnd + 1;
+                }
+                if (!rowIds.empty()) {
+                    runIds.append(runIds.empty() ? "" : ", ").append(rowIds);
+                }
+                runLength++;
+                out.resize(start);
+                count = countBefore;
+            }
+            else {
+                flushRun(start);
+                runSignature = childSignature;
+            }
+        }
+        flushRun(out.size());
+        return signature;
+    }
+
     std::string StateStructure::generateActionList(const ElementPtr target)
     {
         std::string actionList = "\n";
@@ -48,7 +48,7 @@ namespace fastbotx {
 
             this->_text = this->_text.substr(0, cutLength);
             if (!overMaxLen)
-                this->_hashcode ^= (0x79b9 + (std::hash<std::string>{}(this->_text) << 5));
+                this->_hashcode ^= (0x79b9 + (hashString(this->_text) << 5));
         }
 
         if (STATE_WITH_INDEX) {
@@ -128,8 +128,8 @@ namespace fastbotx {
             this->_info = this->_contextDesc;
         }
         // compute for only 1 time
-        uintptr_t hashcode1 = std::hash<std::string>{}(this->_clazz);
-        uintptr_t hashcode2 = std::hash<std::string>{}(this->_resourceID);
+        uintptr_t hashcode1 = hashString(this->_clazz);
+        uintptr_t hashcode2 = hashString(this->_resourceID);
         uintptr_t hashcode3 = std::hash<int>{}(this->_operateMask);
         uintptr_t hashcode4 = std::hash<int>{}(scrollType);
         uintptr_t hashcode5 = std::hash<int>{}(this->_bounds->right - this->_bounds->left);
@@ -257,11 +257,26 @@ namespace fastbotx {
     }
 
 
-    std::string Widget::toHTML(std::vector<ElementPtr> elementToMerge, bool noChild, int actionId)
+    std::shared_ptr<Widget> Widget::cloneFor(std::shared_ptr<Widget> parent, const ElementPtr &element) const
+    {
+        auto widget = std::make_shared<Widget>(*this);
+        widget->_parent = std::move(parent);
+        widget->_element = element;
+        // function is assigned per state by MergedState
+        widget->_function.clear();
+        return widget;
+    }
+
+    std::string Widget::toHTML(const std::vector<ElementPtr> &elementToMerge, bool noChild, int actionId)
     {
         return _element->toHTML(elementToMerge, noChild, actionId);
     }
 
+    std::string Widget::toCompact(int actionId)
+    {
+        return _element->toCompact({}, actionId);
+    }
+
 }
 
 #endif //Widget_CPP_
@@ -63,7 +63,9 @@ namespace fastbotx {
 
         std::string getDescriptionInfo();
 
-        std::string toHTML(std::vector<ElementPtr> elementToMerge = {}, bool noChild = true, int actionId = -1);
+        std::string toHTML(const std::vector<ElementPtr> &elementToMerge = {}, bool noChild = true, int actionId = -1);
+
+        std::string toCompact(int actionId = -1);
 
         void setFunction(std::string function) { _function =  function; }
 
@@ -71,6 +73,12 @@ namespace fastbotx {
 
         uintptr_t getMyHashcode() { return _myHashcode; }
 
+        /// Copy this widget for an identical element of another page, skipping the rebuild.
+        /// \param parent parent widget in the new page
+        /// \param element the element in the new page this widget is bound to
+        /// \return the copy, bound to parent and element
+        virtual std::shared_ptr<Widget> cloneFor(std::shared_ptr<Widget> parent, const ElementPtr &element) const;
+
     protected:
         Widget();
 
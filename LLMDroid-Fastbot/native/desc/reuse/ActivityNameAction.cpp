@@ -23,7 +23,7 @@ namespace fastbotx {
     ActivityNameAction::ActivityNameAction(const std::shared_ptr<State> state, stringPtr activity, const WidgetPtr &widget,
                                            ActionType act)
             : ActivityStateAction(state, widget, act), _activity(std::move(activity)) {
-        uintptr_t activityHashCode = std::hash<std::string>{}(*(_activity.get()));
+        uintptr_t activityHashCode = hashString(*(_activity.get()));
         uintptr_t actionHashCode = std::hash<int>{}(this->getActionType());
         uintptr_t targetHash = nullptr != widget ? widget->hash() : 0x1;
 
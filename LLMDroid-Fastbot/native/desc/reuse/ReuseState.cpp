@@ -59,8 +59,15 @@ namespace fastbotx {
     }
 
     void ReuseState::buildFromElement(WidgetPtr parentWidget, ElementPtr elem) {
-        buildBoundingBox(elem);
         auto element = std::dynamic_pointer_cast<Element>(elem);
+        if (!this->_reusableSubtrees.empty()) {
+            auto reusable = this->_reusableSubtrees.find(element->hash());
+            if (reusable != this->_reusableSubtrees.end() && reusable->second->getWidget()) {
+                reuseFromElement(parentWidget, element, reusable->second);
+                return;
+            }
+        }
+        buildBoundingBox(elem);
         WidgetPtr widget = std::make_shared<Widget>(parentWidget, element);
         element->setWidget(widget);
         this->_widgets.emplace_back(widget);
@@ -76,20 +83,66 @@ namespace fastbotx {
         }
     }
 
+    void ReuseState::reuseFromElement(WidgetPtr parentWidget, ElementPtr element, ElementPtr origin) {
+        buildBoundingBox(element);
+        WidgetPtr widget = origin->getWidget()->cloneFor(parentWidget, element);
+        element->setWidget(widget);
+        this->_widgets.emplace_back(widget);
+        this->_stateStructure._elementMap.insert(std::make_pair(widget->hash(), element));
+        this->_stateStructure.insertElement(element);
+        this->_reusedWidgetCount++;
+        // same subtree hash, so the children line up one by one
+        const auto &children = element->getChildren();
+        const auto &originChildren = origin->getChildren();
+        for (size_t i = 0; i < children.size(); i++) {
+            if (i < originChildren.size() && originChildren[i]->getWidget()) {
+                reuseFromElement(widget, children[i], originChildren[i]);
+            }
+            else {
+                buildFromElement(widget, children[i]);
+            }
+        }
+    }
+
+    bool ReuseState::isSamePage(const ElementPtr &element, const stringPtr &activityName) {
+        ElementPtr root = this->_stateStructure._rootElement;
+        return root && !hasNoDetail() && *(this->_activity) == *activityName
+               && root->hash() == element->hash();
+    }
+
 /// @brief according to the element, or XML of this page, and the activity name,
 ///        create a state and the actions in this page according to the widgets inside this page.
 /// @param element XML of this page
 /// @param activityName activity name of this page
-/// @return a newly created ReuseState according to this page
-    ReuseStatePtr ReuseState::create(const ElementPtr &element, const stringPtr &activityName) {
+/// @param previous state of the previous page, used to skip the unchanged parts of this page
+/// @return a newly created ReuseState according to this page, or previous if the page is unchanged
+    ReuseStatePtr ReuseState::create(const ElementPtr &element, const stringPtr &activityName,
+                                     const ReuseStatePtr &previous) {
+        // An identical page builds an identical hash, which Graph::addState would resolve
+        // to the previous state anyway
+        if (previous && previous->isSamePage(element, activityName)) {
+            BLOG("page unchanged, reuse state %d", previous->getIdi());
+            return previous;
+        }
         ReuseStatePtr statePointer = std::shared_ptr<ReuseState>(new ReuseState(activityName));//std::make_shared<ReuseState>(activityName);
-        statePointer->buildState(element);
+        statePointer->buildState(element, previous);
         return statePointer;
     }
 
-    void ReuseState::buildState(const ElementPtr &element) {
+    void ReuseState::buildState(const ElementPtr &element, const ReuseStatePtr &previous) {
         this->_stateStructure._rootElement = element;
+        if (previous && !previous->hasNoDetail() && previous->_stateStructure._rootElement) {
+            // the root is always rebuilt as a RichWidget, so only index its descendants
+            previous->_stateStructure._rootElement->recursiveDoElements([this](const ElementPtr &elm) {
+                this->_reusableSubtrees.emplace(elm->hash(), elm);
+            });
+        }
         buildStateFromElement(nullptr, element);
+        if (previous) {
+            BLOG("build state: %d widgets reused from state %d, %d rebuilt", this->_reusedWidgetCount,
+                 previous->getIdi(), (int) this->_widgets.size() - this->_reusedWidgetCount);
+        }
+        this->_reusableSubtrees.clear();
         mergeWidgetsInState();
         buildHashForState();
         buildActionForState();
@@ -98,7 +151,7 @@ namespace fastbotx {
     void ReuseState::buildHashForState() {
         //build hash
         std::string activityString = *(_activity.get());
-        uintptr_t activityHash = (std::hash<std::string>{}(activityString) * 31U) << 5;
+        uintptr_t activityHash = (hashString(activityString) * 31U) << 5;
         activityHash ^= (combineHash<Widget>(_widgets, STATE_WITH_WIDGET_ORDER) << 1);
         _hashcode = activityHash;
     }
@@ -154,9 +207,17 @@ namespace fastbotx {
         }
     }
 
-    const std::string ReuseState::getStateDescription()
+    void ReuseState::setMergedState(MergedStatePtr mergedState)
+    {
+        _mergedState = mergedState;
+        if (mergedState) {
+            _stateStructure.setFragmentCache(mergedState->getFragmentCache());
+        }
+    }
+
+    const std::string ReuseState::getStateDescription(DescriptionFormat format)
     {
-        return this->_stateStructure.generateStateDescription(this->_id);
+        return this->_stateStructure.generateStateDescription(this->_id, format);
     }
 
     void ReuseState::addSubSequentState(ReuseStatePtr state)
@@ -10,6 +10,7 @@
 #include "State.h"
 #include "RichWidget.h"
 #include <vector>
+#include <unordered_map>
 #include "../StateStructure.h"
 #include "../ValuableWidget.h"
 #include "MergedState.h"
@@ -31,11 +32,20 @@ namespace fastbotx {
         //This class is for build a state which holds all RichWidgets and their associated actions and so on.
 class ReuseState : public State, public std::enable_shared_from_this<ReuseState> {
     public:
+        /**
+         * Build the state of a page.
+         * If the previous page is given, the page is diffed against it: an unchanged page returns
+         * the previous state itself, and widgets of unchanged subtrees are copied instead of rebuilt.
+         * @param element root element of the page, already resolved by Preference
+         * @param activityName activity of the page
+         * @param previous the state returned by Graph::addState for the previous page, may be nullptr
+         */
         static std::shared_ptr<ReuseState>
-        create(const ElementPtr &element, const stringPtr &activityName);
+        create(const ElementPtr &element, const stringPtr &activityName,
+               const std::shared_ptr<ReuseState> &previous = nullptr);
 
         //custom
-        const std::string getStateDescription();
+        const std::string getStateDescription(DescriptionFormat format = DescriptionFormat::HTML);
         void addSubSequentState(std::shared_ptr<ReuseState> state);
         void addPreviousState(StatePtr state);
         float computeSimilarity(std::shared_ptr<ReuseState> state);
@@ -58,7 +68,10 @@ class ReuseState : public State, public std::enable_shared_from_this<ReuseState>
 
         std::vector<WidgetPtr> getValuableWidgets() {return _valuableWidgets;}
         
-        void setMergedState(MergedStatePtr mergedState) { _mergedState = mergedState; }
+        void setMergedState(MergedStatePtr mergedState);
+
+        /// Html fragments to look up when the description is written before the MergedState is set
+        void borrowFragmentCache(const HtmlFragmentCachePtr &cache) { _stateStructure.borrowFragmentCache(cache); }
         MergedStatePtr getMergedState() { return _mergedState; }
 
         //mini graph
@@ -123,13 +136,25 @@ class ReuseState : public State, public std::enable_shared_from_this<ReuseState>
 
         ReuseState();
 
-        virtual void buildState(const ElementPtr &element);
+        virtual void buildState(const ElementPtr &element, const std::shared_ptr<ReuseState> &previous);
 
         virtual void buildBoundingBox(const ElementPtr &element);
 
     private:
         void buildFromElement(WidgetPtr parentWidget, ElementPtr elem) override;
 
+        /**
+         * Copy the widgets of origin's subtree onto the identical subtree rooted at element
+         * @param origin element of the previous page with the same Element::hash(true)
+        */
+        void reuseFromElement(WidgetPtr parentWidget, ElementPtr element, ElementPtr origin);
+
+        /**
+         * whether the page is exactly the one this state was built from
+         * @note call from main thread
+        */
+        bool isSamePage(const ElementPtr &element, const stringPtr &activityName);
+
         /**
          *using widget's hash and actionType to find action in _actions
          *@param widgetHash
@@ -146,6 +171,10 @@ class ReuseState : public State, public std::enable_shared_from_this<ReuseState>
         //std::vector<StatePtr> _preivousStates;
         //ActivityStateActionPtrVec _actionsToHere;
         std::vector<WidgetPtr> _valuableWidgets;
+
+        // subtree hash => element of the previous page, only alive while building
+        std::unordered_map<long, ElementPtr> _reusableSubtrees;
+        int _reusedWidgetCount = 0;
         
     };
 
@@ -18,32 +18,19 @@ namespace fastbotx {
 
     RichWidget::RichWidget(WidgetPtr parent, const ElementPtr &element)
             : Widget(std::move(parent), element) {
-        uintptr_t hashcode1 = std::hash<std::string>{}(this->_clazz);
-        uintptr_t hashcode2 = std::hash<std::string>{}(this->_resourceID);
+        uintptr_t hashcode1 = hashString(this->_clazz);
+        uintptr_t hashcode2 = hashString(this->_resourceID);
         uintptr_t hashcode3 = 0x1;
         for (int i: this->getActions()) {
             hashcode3 ^= (127U * std::hash<int>{}(i));
         }
         this->_widgetHashcode = ((hashcode1 ^ (hashcode2 << 4)) >> 2) ^ ((127U * hashcode3 << 1));
-        std::string elementText = this->getValidTextFromWidgetAndChildren(element);
+        const std::string &elementText = element->getFirstValidText();
         if (!elementText.empty())
-            this->_widgetHashcode ^= (0x79b9 + (std::hash<std::string>{}(elementText) << 1));
+            this->_widgetHashcode ^= (0x79b9 + (hashString(elementText) << 1));
 
     }
 
-    std::string RichWidget::getValidTextFromWidgetAndChildren(const ElementPtr &element) const {
-        std::string txt = element->validText;
-        if (txt.empty()) {
-            for (const auto &child: element->getChildren()) {
-                txt = this->getValidTextFromWidgetAndChildren(child);
-                if (!txt.empty()) {
-                    return txt;
-                }
-            }
-        }
-        return txt;
-    }
-
     RichWidget::RichWidget()
             : Widget() {
 
@@ -53,6 +40,14 @@ namespace fastbotx {
         return getActHashCode();
     }
 
+    WidgetPtr RichWidget::cloneFor(WidgetPtr parent, const ElementPtr &element) const {
+        auto widget = std::make_shared<RichWidget>(*this);
+        widget->_parent = std::move(parent);
+        widget->_element = element;
+        widget->_function.clear();
+        return widget;
+    }
+
 
 }
 
@@ -26,16 +26,12 @@ namespace fastbotx {
 
         uintptr_t getActHashCode() const { return this->_widgetHashcode; }
 
+        WidgetPtr cloneFor(WidgetPtr parent, const ElementPtr &element) const override;
+
     protected:
         RichWidget();
 
         uintptr_t _widgetHashcode{};
-
-    private:
-        /// Get Element valid text. If parent widget are not clickable, get children's valid text
-        /// \param element
-        /// \return valid text from widget or its children or offspring.
-        std::string getValidTextFromWidgetAndChildren(const ElementPtr &element) const;
     };
 
 }
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <regex>
 #include "utils.hpp"
+#include "Tracer.h"
 #include "Preference.h"
 #include "../thirdpart/json/json.hpp"
 
@@ -105,6 +106,8 @@ namespace fastbotx {
         this->_resMapping.clear();
         this->_blackWidgetActions.clear();
         this->_treePrunings.clear();
+        this->_blackWidgetsByActivity.clear();
+        this->_treePruningsByActivity.clear();
         this->_inputTexts.clear();
         this->_blackList.clear();
         std::queue<ActionPtr> empty;
@@ -226,17 +229,28 @@ namespace fastbotx {
         return "";
     }
 
+    /// Per page state of resolvePage: the rules for the page activity, and the elements each
+    /// black widget rule matched while resolveElement walked the tree
+    struct Preference::PageResolution {
+        const Element *root{};
+        RuleSet *blackWidgets{};
+        RuleSet *treePrunings{};
+        // black widget rule => its bounds scaled to the page, null if it has none
+        std::vector<RectPtr> rejectRects;
+        // the bounds above, filed under their rule
+        RectIndex rejectRectIndex;
+        // black widget rule => elements matching its xpath, and elements centered in its bounds
+        std::vector<std::vector<ElementPtr>> xpathMatches;
+        std::vector<std::vector<ElementPtr>> rectMatches;
+        std::vector<int> matchedRules;
+    };
+
     /// Before exploring page, prune the UI tree of this page if possible
     /// \param activity
     /// \param rootXML
     void Preference::resolvePage(const std::string &activity, const ElementPtr &rootXML) {
-        // cache page texts
-        this->cachePageTexts(rootXML);
-
         BDLOG("preference resolve page: %s black widget %lu tree pruning %lu", activity.c_str(),
               this->_blackWidgetActions.size(), this->_treePrunings.size());
-        // deMixResMapping
-        this->deMixResMapping(rootXML);
 
         // get root size
         if (nullptr == this->_rootScreenSize
@@ -252,42 +266,37 @@ namespace fastbotx {
         if (!this->_rootScreenSize || this->_rootScreenSize->isEmpty()) {
             BLOGE("%s", "No root size in current page");
         }
-        // recursively resolve black widgets
-        this->resolveBlackWidgets(rootXML, activity);
-        // recursively deal all rootXML tree
-        this->resolveElement(rootXML, activity);
-
-    }
-
-    void Preference::resolveElement(const ElementPtr &element, const std::string &activity) {
-        // resolve tree pruning
-        if (element)
-            this->resolveTreePruning(element, activity);
-        // pruning Valid Texts
-        if (this->_pruningValidTexts && element)
-            this->pruningValidTexts(element);
-        if (element) {
-            for (const auto &child: element->getChildren()) {
-                this->resolveElement(child, activity);
-            }
-        }
-    }
 
-    void Preference::resolveBlackWidgets(const ElementPtr &rootXML, const std::string &activity) {
-        // black widgets
-        if (!this->_blackWidgetActions.empty()) {
-            for (const CustomActionPtr &blackWidgetAction: this->_blackWidgetActions) {
-                if (!activity.empty() && blackWidgetAction->activity != activity)
-                    continue;
-                XpathPtr xpath = blackWidgetAction->xpath;
+        PageResolution resolution;
+        resolution.root = rootXML.get();
+        if (activity.empty()) {
+            resolution.blackWidgets = &this->_allBlackWidgets;
+        } else {
+            auto blackWidgetsIter = this->_blackWidgetsByActivity.find(activity);
+            if (blackWidgetsIter != this->_blackWidgetsByActivity.end())
+                resolution.blackWidgets = &blackWidgetsIter->second;
+        }
+        if (resolution.blackWidgets && resolution.blackWidgets->rules.empty())
+            resolution.blackWidgets = nullptr;
+        if (resolution.blackWidgets && nullptr == this->_rootScreenSize) {
+            BLOGE("black widget match failed %s", "No root node in current page");
+            resolution.blackWidgets = nullptr;
+        }
+        auto treePruningsIter = this->_treePruningsByActivity.find(activity);
+        if (treePruningsIter != this->_treePruningsByActivity.end())
+            resolution.treePrunings = &treePruningsIter->second;
+
+        if (resolution.blackWidgets) {
+            size_t ruleCount = resolution.blackWidgets->rules.size();
+            resolution.rejectRects.resize(ruleCount);
+            resolution.xpathMatches.resize(ruleCount);
+            resolution.rectMatches.resize(ruleCount);
+            for (size_t rule = 0; rule < ruleCount; rule++) {
                 // read the bounds of black widget from the config
-                std::vector<float> bounds = blackWidgetAction->bounds;
-                bool hasBoundingBox = bounds.size() >= 4;
-                if (nullptr == this->_rootScreenSize) {
-                    BLOGE("black widget match failed %s", "No root node in current page");
-                    return;
-                }
-                if (hasBoundingBox && bounds[1] <= 1.1 && bounds[3] <= 1.1) {
+                std::vector<float> bounds = resolution.blackWidgets->rules[rule]->bounds;
+                if (bounds.size() < 4)
+                    continue;
+                if (bounds[1] <= 1.1 && bounds[3] <= 1.1) {
                     int rootWidth = this->_rootScreenSize->right;// - rootSize->left;
                     int rootHeight = this->_rootScreenSize->bottom;// - rootSize->top;
                     bounds[0] = bounds[0] * static_cast<float>(rootWidth);
@@ -295,95 +304,160 @@ namespace fastbotx {
                     bounds[2] = bounds[2] * static_cast<float>(rootWidth);
                     bounds[3] = bounds[3] * static_cast<float>(rootHeight);
                 }
-                bool xpathExistsInPage;
-                std::vector<ElementPtr> xpathElements;
-                if (xpath) {
-                    this->findMatchedElements(xpathElements, xpath, rootXML);
-                    BDLOG("find black widget %s  %d", xpath->toString().c_str(),
-                          (int) xpathElements.size());
+                resolution.rejectRects[rule] = std::make_shared<Rect>(bounds[0], bounds[1],
+                                                                      bounds[2], bounds[3]);
+                resolution.rejectRectIndex.insert(static_cast<int>(rule), *resolution.rejectRects[rule]);
+            }
+        }
+
+        // one pass over the tree evaluates every rule
+        this->resolveElement(rootXML, resolution);
+        if (resolution.blackWidgets)
+            this->resolveBlackWidgets(rootXML, activity, resolution);
+    }
+
+    void Preference::resolveElement(const ElementPtr &element, PageResolution &resolution) {
+        if (!element)
+            return;
+        // cache page texts
+        this->cachePageText(element);
+        // deMixResMapping
+        this->deMixResMapping(element);
+        // black widgets are matched against the page before it is pruned
+        if (resolution.blackWidgets) {
+            resolution.matchedRules.clear();
+            resolution.blackWidgets->index.match(*element, resolution.matchedRules);
+            for (int rule: resolution.matchedRules) {
+                resolution.xpathMatches[rule].push_back(element);
+            }
+            if (element.get() != resolution.root && !resolution.rejectRectIndex.empty()) {
+                resolution.matchedRules.clear();
+                resolution.rejectRectIndex.query(element->getBounds()->center(),
+                                                 resolution.matchedRules);
+                for (int rule: resolution.matchedRules) {
+                    resolution.rectMatches[rule].push_back(element);
                 }
-                xpathExistsInPage = xpath && !xpathElements.empty();
-                std::vector<RectPtr> cachedRects;  // cache black widgets
-
-                if (xpathExistsInPage && !hasBoundingBox) {
-                    BLOG("black widget xpath %s, has no bounds matched %d nodes",
-                         xpath->toString().c_str(), (int) xpathElements.size());
-                    for (const auto &matchedElement: xpathElements) {
-                        BLOG("black widget, delete node: %s depends xpath",
-                             matchedElement->getResourceID().c_str());
-                        cachedRects.push_back(matchedElement->getBounds());
-                        matchedElement->deleteElement();
-                    }
+            }
+        }
+        // resolve tree pruning
+        if (resolution.treePrunings)
+            this->resolveTreePruning(element, resolution);
+        // pruning Valid Texts
+        if (this->_pruningValidTexts)
+            this->pruningValidTexts(element);
+        for (const auto &child: element->getChildren()) {
+            this->resolveElement(child, resolution);
+        }
+    }
+
+    /// Whether element is still in the tree of root, or was deleted with one of its ancestors
+    static bool isAttachedTo(const ElementPtr &element, const Element *root) {
+        ElementPtr current = element;
+        while (current.get() != root) {
+            current = current->getParent().lock();
+            if (!current)
+                return false;
+        }
+        return true;
+    }
+
+    void Preference::resolveBlackWidgets(const ElementPtr &rootXML, const std::string &activity,
+                                         PageResolution &resolution) {
+        // rules are applied in order, so a rule only sees what the rules before it left in the page
+        const CustomActionPtrVec &rules = resolution.blackWidgets->rules;
+        // cache black widgets of every rule, for checkPointIsInBlackRects
+        BlackWidgetRects &blackWidgetRects = this->_cachedBlackWidgetRects[activity];
+        std::vector<RectPtr> &cachedRects = blackWidgetRects.rects;
+        cachedRects.clear();
+        blackWidgetRects.index.clear();
+        for (size_t rule = 0; rule < rules.size(); rule++) {
+            const CustomActionPtr &blackWidgetAction = rules[rule];
+            XpathPtr xpath = blackWidgetAction->xpath;
+            const RectPtr &rejectRect = resolution.rejectRects[rule];
+            bool hasBoundingBox = nullptr != rejectRect;
+            std::vector<ElementPtr> xpathElements;
+            for (const auto &matchedElement: resolution.xpathMatches[rule]) {
+                if (isAttachedTo(matchedElement, rootXML.get()))
+                    xpathElements.push_back(matchedElement);
+            }
+            if (xpath) {
+                BDLOG("find black widget %s  %d", xpath->toString().c_str(),
+                      (int) xpathElements.size());
+            }
+            bool xpathExistsInPage = xpath && !xpathElements.empty();
+
+            if (xpathExistsInPage && !hasBoundingBox) {
+                BLOG("black widget xpath %s, has no bounds matched %d nodes",
+                     xpath->toString().c_str(), (int) xpathElements.size());
+                for (const auto &matchedElement: xpathElements) {
+                    BLOG("black widget, delete node: %s depends xpath",
+                         matchedElement->getResourceID().c_str());
+                    cachedRects.push_back(matchedElement->getBounds());
+                    matchedElement->deleteElement();
                 }
-                else if (xpathExistsInPage || (!xpath && hasBoundingBox)) {
-                    RectPtr rejectRect = std::make_shared<Rect>(bounds[0], bounds[1], bounds[2],
-                                                                bounds[3]);
-                    cachedRects.push_back(rejectRect);
-                    std::vector<ElementPtr> elementsInRejectRect;
-                    rootXML->recursiveElements([&rejectRect](const ElementPtr &child) -> bool {
-                        return rejectRect->contains(child->getBounds()->center());
-                    }, elementsInRejectRect);
-                    BLOG("black widget xpath %s, with bounds matched %d nodes",
-                         xpath ? xpath->toString().c_str() : "none",
-                         (int) elementsInRejectRect.size());
-                    for (const auto &elementInRejectRect: elementsInRejectRect) {
-                        if (elementInRejectRect) {
-                            BLOG("black widget, delete node: %s depends xpath",
-                                 elementInRejectRect->getResourceID().c_str());
-                            elementInRejectRect->deleteElement();
-                        }
-                    }
+            }
+            else if (xpathExistsInPage || (!xpath && hasBoundingBox)) {
+                cachedRects.push_back(rejectRect);
+                std::vector<ElementPtr> elementsInRejectRect;
+                for (const auto &elementInRejectRect: resolution.rectMatches[rule]) {
+                    if (isAttachedTo(elementInRejectRect, rootXML.get()))
+                        elementsInRejectRect.push_back(elementInRejectRect);
+                }
+                BLOG("black widget xpath %s, with bounds matched %d nodes",
+                     xpath ? xpath->toString().c_str() : "none",
+                     (int) elementsInRejectRect.size());
+                for (const auto &elementInRejectRect: elementsInRejectRect) {
+                    BLOG("black widget, delete node: %s depends xpath",
+                         elementInRejectRect->getResourceID().c_str());
+                    elementInRejectRect->deleteElement();
                 }
-                this->_cachedBlackWidgetRects[activity] = cachedRects;
             }
         }
+        for (size_t rect = 0; rect < cachedRects.size(); rect++) {
+            blackWidgetRects.index.insert(static_cast<int>(rect), *cachedRects[rect]);
+        }
     }
 
     bool Preference::checkPointIsInBlackRects(const std::string &activity, int pointX, int pointY) {
-        bool isInsideBlackList;
+        bool isInsideBlackList = false;
         auto iter = this->_cachedBlackWidgetRects.find(activity);
-        isInsideBlackList = iter != this->_cachedBlackWidgetRects.end();
-        if (isInsideBlackList) {
-            const Point p(pointX, pointY);
-            for (const auto &rect: iter->second) {
-                if (rect->contains(p)) {
-                    isInsideBlackList = true;
-                    break;
-                }
-            }
+        if (iter != this->_cachedBlackWidgetRects.end()) {
+            isInsideBlackList = iter->second.index.contains(Point(pointX, pointY));
         }
         BLOG("check point [%d, %d] is %s in black widgets", pointX, pointY,
              isInsideBlackList ? "" : "not");
         return isInsideBlackList;
     }
 
-    void Preference::resolveTreePruning(const ElementPtr &elem, const std::string &activity) {
-        if (!this->_treePrunings.empty()) {
-            for (const auto &prun: this->_treePrunings) {
-                if (prun->activity != activity)
-                    continue;
-                XpathPtr xpath = prun->xpath;
-                std::vector<ElementPtr> xpathElemts;
-                if (!xpath)
-                    continue;
-                if (elem->matchXpathSelector(xpath)) {
-                    BLOG("pruning node %s for xpath: %s", elem->getResourceID().c_str(),
-                         xpath->toString().c_str());
-                    bool resetResid = 0 != InvalidProperty.compare(prun->resourceID);
-                    bool resetContent = 0 != InvalidProperty.compare(prun->contentDescription);
-                    bool resettext = 0 != InvalidProperty.compare(prun->text);
-                    bool resetclassname = 0 != InvalidProperty.compare(prun->classname);
-
-                    if (resetResid)
-                        elem->reSetResourceID(prun->resourceID);
-                    if (resetContent)
-                        elem->reSetContentDesc(prun->contentDescription);
-                    if (resettext)
-                        elem->reSetText(prun->text);
-                    if (resetclassname)
-                        elem->reSetClassname(prun->classname);
-                }
-            }
+    void Preference::resolveTreePruning(const ElementPtr &elem, PageResolution &resolution) {
+        RuleSet &treePrunings = *resolution.treePrunings;
+        // a rule resetting properties can make the rules after it match or miss, so look the
+        // element up again after each, continuing after the rule applied last
+        int lastApplied = -1;
+        while (true) {
+            resolution.matchedRules.clear();
+            treePrunings.index.match(*elem, resolution.matchedRules);
+            auto next = std::upper_bound(resolution.matchedRules.begin(),
+                                         resolution.matchedRules.end(), lastApplied);
+            if (next == resolution.matchedRules.end())
+                break;
+            lastApplied = *next;
+            const CustomActionPtr &prun = treePrunings.rules[lastApplied];
+            BLOG("pruning node %s for xpath: %s", elem->getResourceID().c_str(),
+                 prun->xpath->toString().c_str());
+            bool resetResid = 0 != InvalidProperty.compare(prun->resourceID);
+            bool resetContent = 0 != InvalidProperty.compare(prun->contentDescription);
+            bool resettext = 0 != InvalidProperty.compare(prun->text);
+            bool resetclassname = 0 != InvalidProperty.compare(prun->classname);
+
+            if (resetResid)
+                elem->reSetResourceID(prun->resourceID);
+            if (resetContent)
+                elem->reSetContentDesc(prun->contentDescription);
+            if (resettext)
+                elem->reSetText(prun->text);
+            if (resetclassname)
+                elem->reSetClassname(prun->classname);
         }
     }
 
@@ -413,10 +487,6 @@ namespace fastbotx {
             BDLOG("%s", "set valid Text  set clickable true");
             element->reSetClickable(true);
         }
-
-        for (const auto &child: element->getChildren()) {
-            pruningValidTexts(child);
-        }
     }
 
 /// According to the given xpath selector, match and return the satisfied elements inside UI page
@@ -438,21 +508,17 @@ namespace fastbotx {
         }
     }
 
-    void Preference::deMixResMapping(const ElementPtr &rootXML) {
-        if (!rootXML || this->_resMixedMapping.empty())
+    void Preference::deMixResMapping(const ElementPtr &element) {
+        if (!element || this->_resMixedMapping.empty())
             return;
-        std::string stringOfResourceID = rootXML->getResourceID();
+        const std::string &stringOfResourceID = element->getResourceID();
         if (!stringOfResourceID.empty()) {
             auto iterator = this->_resMixedMapping.find(stringOfResourceID);
             if (iterator != this->_resMixedMapping.end()) {
-                rootXML->reSetResourceID((*iterator).second);
                 BDLOG("de-mixed %s as %s", stringOfResourceID.c_str(), (*iterator).second.c_str());
+                element->reSetResourceID((*iterator).second);
             }
         }
-
-        for (const auto &child: rootXML->getChildren()) {
-            deMixResMapping(child);
-        }
     }
 
     void Preference::loadMixResMapping(const std::string &resourceMappingPath) {
@@ -516,6 +582,7 @@ namespace fastbotx {
             loadWhiteBlackList();
             loadTreePruning();
             loadInputTexts();
+            compileRules();
         }
         catch (std::exception &ex) {
             BLOGE("load configs Error! %s", ex.what());
@@ -526,6 +593,11 @@ namespace fastbotx {
 #define MaxRandomPickSTR  "max.randomPickFromStringList"
 #define InputFuzzSTR "max.doinputtextFuzzing"
 #define ListenMode "max.listenMode"
+#define RandomSeedSTR "max.randomSeed"
+#define LogFileSTR "max.logFile"
+#define StagnationDetectorSTR "max.stagnationDetector"
+#define CoverageReplaySTR "max.coverageReplay"
+#define TraceFileSTR "max.traceFile"
 
     void Preference::loadBaseConfig() {
         LOGI("pref init checking curr packageName is offset: %s", Preference::PackageName.c_str());
@@ -550,22 +622,34 @@ namespace fastbotx {
             } else if (ListenMode == key_value[0]) {
                 BDLOG("set %s", ListenMode);
                 this->setListenMode("true" == key_value[1]);
+            } else if (RandomSeedSTR == key_value[0]) {
+                this->_randomSeed = std::strtoull(key_value[1].c_str(), nullptr, 10);
+                BLOG("set %s %llu", RandomSeedSTR, (unsigned long long) this->_randomSeed);
+            } else if (LogFileSTR == key_value[0]) {
+                BLOG("set %s %s", LogFileSTR, key_value[1].c_str());
+                AsyncLogger::inst().setFile(key_value[1]);
+            } else if (StagnationDetectorSTR == key_value[0]) {
+                BLOG("set %s %s", StagnationDetectorSTR, key_value[1].c_str());
+                this->_stagnationDetector = key_value[1];
+            } else if (CoverageReplaySTR == key_value[0]) {
+                BLOG("set %s %s", CoverageReplaySTR, key_value[1].c_str());
+                this->_coverageReplayPath = key_value[1];
+            } else if (TraceFileSTR == key_value[0]) {
+                BLOG("set %s %s", TraceFileSTR, key_value[1].c_str());
+                Tracer::inst().enable(key_value[1]);
             }
         }
     }
 
 #define PageTextsMaxCount 300
 
-    void Preference::cachePageTexts(const ElementPtr &rootElement) {
+    void Preference::cachePageText(const ElementPtr &element) {
         if (this->_pageTextsCache.size() > PageTextsMaxCount) {
             this->_pageTextsCache.erase(this->_pageTextsCache.begin(),
                                         this->_pageTextsCache.begin() + 20);
         }
-        if (rootElement && !rootElement->getText().empty()) {
-            this->_pageTextsCache.push_back(rootElement->getText());
-        }
-        for (const auto &childElement: rootElement->getChildren()) {
-            this->cachePageTexts(childElement);
+        if (element && !element->getText().empty()) {
+            this->_pageTextsCache.push_back(element->getText());
         }
     }
 
@@ -709,6 +793,28 @@ namespace fastbotx {
         }
     }
 
+    void Preference::RuleSet::add(const CustomActionPtr &rule) {
+        this->index.add(static_cast<int>(this->rules.size()), rule->xpath);
+        this->rules.push_back(rule);
+    }
+
+    /// Index the rules by activity and by the values their xpath selectors compare, so resolvePage
+    /// looks up the rules an element matches instead of testing every rule on every element
+    void Preference::compileRules() {
+        this->_blackWidgetsByActivity.clear();
+        this->_allBlackWidgets = RuleSet();
+        this->_treePruningsByActivity.clear();
+        for (const CustomActionPtr &blackWidgetAction: this->_blackWidgetActions) {
+            this->_blackWidgetsByActivity[blackWidgetAction->activity].add(blackWidgetAction);
+            this->_allBlackWidgets.add(blackWidgetAction);
+        }
+        for (const CustomActionPtr &prun: this->_treePrunings) {
+            this->_treePruningsByActivity[prun->activity].add(prun);
+        }
+        BLOG("compiled %d black widgets and %d tree prunings for %d and %d activities",
+             (int) this->_blackWidgetActions.size(), (int) this->_treePrunings.size(),
+             (int) this->_blackWidgetsByActivity.size(), (int) this->_treePruningsByActivity.size());
+    }
 
     std::string Preference::loadFileContent(const std::string &fileAbsolutePath) {
         std::string retStr;
@@ -15,6 +15,8 @@
 #include "Action.h"
 #include "DeviceOperateWrapper.h"
 #include "Element.h"
+#include "XpathRuleIndex.h"
+#include "RectIndex.h"
 
 
 namespace fastbotx {
@@ -59,7 +61,6 @@ namespace fastbotx {
 
     typedef std::shared_ptr<CustomEvent> CustomEventPtr;
     typedef std::vector<CustomEventPtr> CustomEventPtrVec;
-    typedef std::map<std::string, std::vector<RectPtr>> StringRectsMap;
 
     class Preference {
     public:
@@ -91,6 +92,21 @@ namespace fastbotx {
 
         int getForceMaxBlockStateTimes() const { return this->_forceMaxBlockStateTimes; }
 
+        /// max.randomSeed of max.config, 0 if not set
+        uint64_t getRandomSeed() const { return this->_randomSeed; }
+
+        /// max.stagnationDetector of max.config: window, ewma or cusum, empty if not set
+        const std::string &getStagnationDetector() const { return this->_stagnationDetector; }
+
+        /// max.coverageReplay of max.config: a recorded coverage curve to replay, empty if not set
+        const std::string &getCoverageReplayPath() const { return this->_coverageReplayPath; }
+
+        /// Custom events and black widget rects are matched against the current page,
+        /// so no page may skip resolvePageAndGetSpecifiedAction
+        bool resolvesEveryPage() const {
+            return !this->_customEvents.empty() || !this->_blackWidgetActions.empty();
+        }
+
         ~Preference();
 
     protected:
@@ -98,18 +114,23 @@ namespace fastbotx {
         ///after the activity matches, resolve the black widgets, tree pruning, valid texts
         void resolvePage(const std::string &activity, const ElementPtr &rootXML);
 
-        void deMixResMapping(const ElementPtr &rootXML);
+        // not recursive
+        void deMixResMapping(const ElementPtr &element);
 
         bool patchActionBounds(const CustomActionPtr &action, const ElementPtr &);
 
-        // recursive resolve the elems, than resolve the black widgets, tree pruning, valid texts
-        void resolveElement(const ElementPtr &element, const std::string &activity);
+        struct PageResolution;
 
-        // recursive
-        void resolveBlackWidgets(const ElementPtr &rootXML, const std::string &activity);
+        // recursive, resolve the elems in one pass: texts, resource ids, tree pruning, valid texts,
+        // and collect the elements black widget rules match
+        void resolveElement(const ElementPtr &element, PageResolution &resolution);
+
+        // delete the black widgets collected by resolveElement, rule by rule
+        void resolveBlackWidgets(const ElementPtr &rootXML, const std::string &activity,
+                                 PageResolution &resolution);
 
         //  not recursive
-        void resolveTreePruning(const ElementPtr &elem, const std::string &activity);
+        void resolveTreePruning(const ElementPtr &elem, PageResolution &resolution);
 
         // not recursive
         void pruningValidTexts(const ElementPtr &element);
@@ -119,7 +140,8 @@ namespace fastbotx {
         findMatchedElements(std::vector<ElementPtr> &outElements, const XpathPtr &xpathSelector,
                             const ElementPtr &elementXML);
 
-        void cachePageTexts(const ElementPtr &rootElement);
+        // not recursive
+        void cachePageText(const ElementPtr &element);
 
         void loadConfigs();
 
@@ -135,6 +157,9 @@ namespace fastbotx {
 
         void loadTreePruning();
 
+        // build the rule sets below from _blackWidgetActions and _treePrunings
+        void compileRules();
+
     private:
 
         static std::shared_ptr<Preference> _preferenceInst;
@@ -155,6 +180,21 @@ namespace fastbotx {
         CustomActionPtrVec _blackWidgetActions;
         CustomActionPtrVec _treePrunings;
 
+        /// Rules of one activity, in the order of the config file, with their xpath selectors
+        /// indexed under their position in rules
+        struct RuleSet {
+            CustomActionPtrVec rules;
+            XpathRuleIndex index;
+
+            void add(const CustomActionPtr &rule);
+        };
+
+        // activity => black widget rules of it, and every rule for pages without an activity
+        std::map<std::string, RuleSet> _blackWidgetsByActivity;
+        RuleSet _allBlackWidgets;
+        // activity => tree pruning rules of it
+        std::map<std::string, RuleSet> _treePruningsByActivity;
+
         std::map<std::string, std::string> _resMapping;
         std::map<std::string, std::string> _resMixedMapping;
 
@@ -166,11 +206,20 @@ namespace fastbotx {
         bool _skipAllActionsFromModel;
         bool _forceUseTextModel{};
         int _forceMaxBlockStateTimes{};
+        uint64_t _randomSeed{};
+        std::string _stagnationDetector;
+        std::string _coverageReplayPath;
         RectPtr _rootScreenSize;
 
         static std::string loadFileContent(const std::string &fileAbsolutePath);
 
-        StringRectsMap _cachedBlackWidgetRects;
+        /// Black widget rects of the last page of an activity, indexed for checkPointIsInBlackRects
+        struct BlackWidgetRects {
+            std::vector<RectPtr> rects;
+            RectIndex index;
+        };
+
+        std::map<std::string, BlackWidgetRects> _cachedBlackWidgetRects;
 
     public:
         static std::string InvalidProperty;
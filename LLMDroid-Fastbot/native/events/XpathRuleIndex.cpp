@@ -0,0 +1,84 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef XpathRuleIndex_CPP_
+#define XpathRuleIndex_CPP_
+
+#include <algorithm>
+#include "XpathRuleIndex.h"
+
+namespace fastbotx {
+
+    void XpathRuleIndex::add(int rule, const XpathPtr &xpath) {
+        if (!xpath)
+            return;
+        size_t entry = this->_xpaths.size();
+        this->_rules.push_back(rule);
+        this->_xpaths.push_back(xpath);
+        this->_reportedFor.push_back(0);
+        if (xpath->operationAND) {
+            if (!xpath->resourceID.empty())
+                this->_byResourceID[xpath->resourceID].push_back(entry);
+            else if (!xpath->text.empty())
+                this->_byText[xpath->text].push_back(entry);
+            else if (!xpath->contentDescription.empty())
+                this->_byContentDesc[xpath->contentDescription].push_back(entry);
+            else if (!xpath->clazz.empty())
+                this->_byClass[xpath->clazz].push_back(entry);
+            else
+                this->_unanchored.push_back(entry);
+            return;
+        }
+        // an OR selector without any of these never matches
+        if (!xpath->resourceID.empty())
+            this->_byResourceID[xpath->resourceID].push_back(entry);
+        if (!xpath->text.empty())
+            this->_byText[xpath->text].push_back(entry);
+        if (!xpath->contentDescription.empty())
+            this->_byContentDesc[xpath->contentDescription].push_back(entry);
+        if (!xpath->clazz.empty())
+            this->_byClass[xpath->clazz].push_back(entry);
+    }
+
+    void XpathRuleIndex::lookup(const ValueEntriesMap &index, const std::string &value,
+                                const Element &element, std::vector<int> &rules) {
+        if (index.empty() || value.empty())
+            return;
+        auto found = index.find(value);
+        if (found == index.end())
+            return;
+        for (size_t entry: found->second) {
+            if (this->_reportedFor[entry] == this->_stamp)
+                continue;
+            const XpathPtr &xpath = this->_xpaths[entry];
+            if (!xpath->operationAND || element.matchXpathSelector(xpath)) {
+                this->_reportedFor[entry] = this->_stamp;
+                rules.push_back(this->_rules[entry]);
+            }
+        }
+    }
+
+    void XpathRuleIndex::match(const Element &element, std::vector<int> &rules) {
+        if (this->_xpaths.empty())
+            return;
+        // a fresh stamp per element instead of clearing _reportedFor
+        if (++this->_stamp == 0) {
+            std::fill(this->_reportedFor.begin(), this->_reportedFor.end(), 0);
+            this->_stamp = 1;
+        }
+        size_t first = rules.size();
+        lookup(this->_byResourceID, element.getResourceID(), element, rules);
+        lookup(this->_byText, element.getText(), element, rules);
+        lookup(this->_byContentDesc, element.getContentDesc(), element, rules);
+        lookup(this->_byClass, element.getClassname(), element, rules);
+        for (size_t entry: this->_unanchored) {
+            if (element.matchXpathSelector(this->_xpaths[entry])) {
+                rules.push_back(this->_rules[entry]);
+            }
+        }
+        std::sort(rules.begin() + static_cast<long>(first), rules.end());
+    }
+
+}
+
+#endif //XpathRuleIndex_CPP_
@@ -0,0 +1,54 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef XpathRuleIndex_H_
+#define XpathRuleIndex_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Element.h"
+
+namespace fastbotx {
+
+    /**
+     * @brief Xpath selectors of preference rules, compiled into lookup tables on the values
+     * they compare. Element::matchXpathSelector only tests for equality, so an element finds
+     * every rule it may match with one hash lookup per attribute, however many rules there are.
+     */
+    class XpathRuleIndex {
+    public:
+        /// \param rule number of the rule, reported back by match
+        /// \param xpath selector of the rule, ignored if null
+        void add(int rule, const XpathPtr &xpath);
+
+        bool empty() const { return this->_xpaths.empty(); }
+
+        /// Append the numbers of the rules matching element, ascending and each once
+        void match(const Element &element, std::vector<int> &rules);
+
+    private:
+        typedef std::unordered_map<std::string, std::vector<size_t>> ValueEntriesMap;
+
+        void lookup(const ValueEntriesMap &index, const std::string &value, const Element &element,
+                    std::vector<int> &rules);
+
+        std::vector<int> _rules;
+        std::vector<XpathPtr> _xpaths;
+        // entry => stamp of the last element it was reported for, so OR rules are reported once
+        std::vector<unsigned> _reportedFor;
+        unsigned _stamp = 0;
+
+        // attribute value => entries comparing it. An OR selector is filed under every value it
+        // has, an AND selector only under its most selective one and checked on a hit.
+        ValueEntriesMap _byResourceID;
+        ValueEntriesMap _byText;
+        ValueEntriesMap _byContentDesc;
+        ValueEntriesMap _byClass;
+        // AND selectors on index alone, checked on every element
+        std::vector<size_t> _unanchored;
+    };
+
+}
+
+#endif //XpathRuleIndex_H_
@@ -266,6 +266,30 @@ liboai::Response liboai::ChatCompletion::create(const std::string& model, const
 	return res;
 }
 
+liboai::Response liboai::ChatCompletion::create_raw(std::string_view body, std::optional<std::string> key, std::optional<int32_t> timeout, const std::atomic<bool>* cancel) const& noexcept(false) {
+	netimpl::components::Header headers = this->auth_.GetAuthorizationHeaders();
+	if (key) {
+		headers["Authorization"] = "Bearer " + key.value();
+	}
+
+	Response res;
+	res = this->Request(
+		Method::HTTP_POST, this->openai_root_, "/chat/completions", "application/json",
+		std::move(headers),
+		netimpl::components::BodyView {
+			body
+		},
+		netimpl::components::Cancellation {
+			cancel
+		},
+		this->auth_.GetProxies(),
+		this->auth_.GetProxyAuth(),
+		timeout ? netimpl::components::Timeout{ timeout.value() } : this->auth_.GetMaxTimeout()
+	);
+
+	return res;
+}
+
 liboai::FutureResponse liboai::ChatCompletion::create_async(const std::string& model, const Conversation& conversation, std::optional<float> temperature, std::optional<float> top_p, std::optional<uint16_t> n, std::optional<std::function<bool(std::string, intptr_t)>> stream, std::optional<std::vector<std::string>> stop, std::optional<uint16_t> max_tokens, std::optional<float> presence_penalty, std::optional<float> frequency_penalty, std::optional<std::unordered_map<std::string, int8_t>> logit_bias, std::optional<std::string> user) const& noexcept(false) {
 	liboai::JsonConstructor jcon;
 	jcon.push_back("model", model);
@@ -1,5 +1,7 @@
 #include "../include/core/netimpl.h"
 #include "../../Base.h"
+#include <algorithm>
+#include <cctype>
 
 liboai::netimpl::CurlHolder::CurlHolder() {
 	std::lock_guard<std::mutex> lock{ this->curl_easy_get_mutex_() };
@@ -272,7 +274,7 @@ liboai::Response liboai::netimpl::Session::BuildResponseObject() {
 	#endif	
 
 	// fill status line and reason
-	this->ParseResponseHeader(this->header_string_, &this->status_line, &this->reason);
+	this->ParseResponseHeader(this->header_string_, &this->status_line, &this->reason, &this->header_fields);
 
 	#if defined(LIBOAI_DEBUG)
 		_liboai_dbg(
@@ -324,7 +326,8 @@ liboai::Response liboai::netimpl::Session::BuildResponseObject() {
 		std::move(this->status_line),
 		std::move(this->reason),
 		this->status_code,
-		this->elapsed
+		this->elapsed,
+		std::move(this->header_fields)
 	};
 }
 
@@ -618,7 +621,7 @@ liboai::Response liboai::netimpl::Session::Download(std::ofstream& file) {
 	return CompleteDownload();
 }
 
-void liboai::netimpl::Session::ParseResponseHeader(const std::string& headers, std::string* status_line, std::string* reason) {
+void liboai::netimpl::Session::ParseResponseHeader(const std::string& headers, std::string* status_line, std::string* reason, std::map<std::string, std::string>* fields) {
     std::vector<std::string> lines;
     std::istringstream stream(headers);
     {
@@ -630,6 +633,10 @@ void liboai::netimpl::Session::ParseResponseHeader(const std::string& headers, s
 
     for (std::string& line : lines) {
         if (line.substr(0, 5) == "HTTP/") {
+            // only the fields of the final response count, not those of redirects or 100 Continue
+            if (fields != nullptr) {
+                fields->clear();
+            }
             // set the status_line if it was given
             if ((status_line != nullptr) || (reason != nullptr)) {
                 line.resize(std::min<size_t>(line.size(), line.find_last_not_of("\t\n\r ") + 1));
@@ -658,6 +665,12 @@ void liboai::netimpl::Session::ParseResponseHeader(const std::string& headers, s
                 std::string value = line.substr(found + 1);
                 value.erase(0, value.find_first_not_of("\t "));
                 value.resize(std::min<size_t>(value.size(), value.find_last_not_of("\t\n\r ") + 1));
+                if (fields != nullptr) {
+                    std::string name = line.substr(0, found);
+                    std::transform(name.begin(), name.end(), name.begin(),
+                                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                    (*fields)[name] = std::move(value);
+                }
             }
         }
     }
@@ -731,6 +744,31 @@ void liboai::netimpl::Session::SetBody(components::Body&& body) {
 	ErrorCheck(e, 2, "liboai::netimpl::Session::SetBody()");
 }
 
+void liboai::netimpl::Session::SetOption(const components::BodyView& body) {
+	this->SetBodyView(body);
+}
+
+void liboai::netimpl::Session::SetBodyView(const components::BodyView& body) {
+	// holds error codes - all init to OK to prevent errors
+	// when checking unset values
+	CURLcode e[2]; memset(e, CURLcode::CURLE_OK, sizeof(e));
+
+	// curl reads the caller's buffer in place, CURLOPT_POSTFIELDSIZE_LARGE
+	// makes it independent of a terminating null
+	this->hasBody = true;
+	e[0] = curl_easy_setopt(this->curl_, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.data.length()));
+	e[1] = curl_easy_setopt(this->curl_, CURLOPT_POSTFIELDS, body.data.data());
+
+	#if defined(LIBOAI_DEBUG)
+		_liboai_dbg(
+			"[dbg] [@%s] Set CURLOPT_POSTFIELDSIZE_LARGE and CURLOPT_POSTFIELDS for Session (0x%p) to %lld and \"%.*s\".\n",
+			__func__, this, static_cast<curl_off_t>(body.data.length()), static_cast<int>(body.data.length()), body.data.data()
+		);
+	#endif
+
+	ErrorCheck(e, 2, "liboai::netimpl::Session::SetBodyView()");
+}
+
 void liboai::netimpl::Session::SetOption(const components::Multipart& multipart) {
 	this->SetMultipart(multipart);
 }
@@ -1031,6 +1069,11 @@ size_t liboai::netimpl::components::writeFunction(char* ptr, size_t size, size_t
 	return size;
 }
 
+int liboai::netimpl::components::cancelFunction(const std::atomic<bool>* flag, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+	// non-zero aborts the transfer with CURLE_ABORTED_BY_CALLBACK
+	return flag->load(std::memory_order_relaxed) ? 1 : 0;
+}
+
 size_t liboai::netimpl::components::writeFileFunction(char* ptr, size_t size, size_t nmemb, std::ofstream* file) {
 	#if defined(LIBOAI_DEBUG)
 		_liboai_dbg(
@@ -1355,6 +1398,29 @@ void liboai::netimpl::Session::SetWriteCallback(components::WriteCallback&& writ
 	}
 }
 
+void liboai::netimpl::Session::SetOption(const components::Cancellation& cancellation) {
+	this->SetCancellation(cancellation);
+}
+
+void liboai::netimpl::Session::SetCancellation(const components::Cancellation& cancellation) {
+	if (cancellation.flag) {
+		CURLcode e[3]; memset(e, CURLcode::CURLE_OK, sizeof(e));
+
+		e[0] = curl_easy_setopt(this->curl_, CURLOPT_XFERINFOFUNCTION, components::cancelFunction);
+		e[1] = curl_easy_setopt(this->curl_, CURLOPT_XFERINFODATA, cancellation.flag);
+		e[2] = curl_easy_setopt(this->curl_, CURLOPT_NOPROGRESS, 0L);
+
+		#if defined(LIBOAI_DEBUG)
+			_liboai_dbg(
+				"[dbg] [@%s] Set cancellation flag 0x%p for Session (0x%p).\n",
+				__func__, cancellation.flag, this
+			);
+		#endif
+
+		ErrorCheck(e, 3, "liboai::netimpl::Session::SetCancellation()");
+	}
+}
+
 liboai::netimpl::components::Proxies::Proxies(const std::initializer_list<std::pair<const std::string, std::string>>& hosts)
 	: hosts_{ hosts } {}
 
@@ -1,17 +1,18 @@
 #include "../include/core/response.h"
 #include "../../Base.h"
+#include <cstdlib>
 
 liboai::Response::Response(const liboai::Response& other) noexcept
 	: status_code(other.status_code), elapsed(other.elapsed), status_line(other.status_line),
-	content(other.content), url(other.url), reason(other.reason), raw_json(other.raw_json) {}
+	content(other.content), url(other.url), reason(other.reason), raw_json(other.raw_json), headers(other.headers) {}
 
 liboai::Response::Response(liboai::Response&& other) noexcept
 	: status_code(other.status_code), elapsed(other.elapsed), status_line(std::move(other.status_line)),
-	content(std::move(other.content)), url(std::move(other.url)), reason(std::move(other.reason)), raw_json(std::move(other.raw_json)) {}
+	content(std::move(other.content)), url(std::move(other.url)), reason(std::move(other.reason)), raw_json(std::move(other.raw_json)), headers(std::move(other.headers)) {}
 
-liboai::Response::Response(std::string&& url, std::string&& content, std::string&& status_line, std::string&& reason, long status_code, double elapsed) noexcept(false) 
+liboai::Response::Response(std::string&& url, std::string&& content, std::string&& status_line, std::string&& reason, long status_code, double elapsed, std::map<std::string, std::string>&& headers) noexcept(false) 
 	: status_code(status_code), elapsed(elapsed), status_line(std::move(status_line)),
-	content(std::move(content)), url(url), reason(std::move(reason))
+	content(std::move(content)), url(url), reason(std::move(reason)), headers(std::move(headers))
 {
 	try {
 		if (!this->content.empty()) {
@@ -46,6 +47,7 @@ liboai::Response& liboai::Response::operator=(const liboai::Response& other) noe
 	this->url = other.url;
 	this->reason = other.reason;
 	this->raw_json = other.raw_json;
+	this->headers = other.headers;
 
 	return *this;
 }
@@ -58,6 +60,7 @@ liboai::Response& liboai::Response::operator=(liboai::Response&& other) noexcept
 	this->url = std::move(other.url);
 	this->reason = std::move(other.reason);
 	this->raw_json = std::move(other.raw_json);
+	this->headers = std::move(other.headers);
 
 	return *this;
 }
@@ -72,14 +75,18 @@ void liboai::Response::CheckResponse() const noexcept(false) {
 		throw liboai::exception::OpenAIRateLimited(
 			!this->reason.empty() ? this->reason : "Rate limited",
 			liboai::exception::EType::E_RATELIMIT,
-			"liboai::Response::CheckResponse()"
+			"liboai::Response::CheckResponse()",
+			this->status_code,
+			this->RetryAfter()
 		);
 	}
 	else if (this->status_code == 0) {
 		throw liboai::exception::OpenAIException(
 			"A connection error occurred",
 			liboai::exception::EType::E_CONNECTIONERROR,
-			"liboai::Response::CheckResponse()"
+			"liboai::Response::CheckResponse()",
+			this->status_code,
+			this->RetryAfter()
 		);
 	}
 	else if (this->status_code < 200 || this->status_code >= 300) {
@@ -88,14 +95,18 @@ void liboai::Response::CheckResponse() const noexcept(false) {
 				throw liboai::exception::OpenAIException(
 					this->raw_json["error"]["message"].get<std::string>(),
 					liboai::exception::EType::E_APIERROR,
-					"liboai::Response::CheckResponse()"
+					"liboai::Response::CheckResponse()",
+					this->status_code,
+					this->RetryAfter()
 				);
 			}
 			catch (nlohmann::json::parse_error& e) {
 				throw liboai::exception::OpenAIException(
 					e.what(),
 					liboai::exception::EType::E_FAILURETOPARSE,
-					"liboai::Response::CheckResponse()"
+					"liboai::Response::CheckResponse()",
+					this->status_code,
+					this->RetryAfter()
 				);
 			}
 		}
@@ -104,8 +115,28 @@ void liboai::Response::CheckResponse() const noexcept(false) {
 			throw liboai::exception::OpenAIException(
 				!this->reason.empty() ? this->reason : "An unknown error occurred",
 				liboai::exception::EType::E_BADREQUEST,
-				"liboai::Response::CheckResponse()"
+				"liboai::Response::CheckResponse()",
+				this->status_code,
+				this->RetryAfter()
 			);
 		}
 	}
+}
+
+double liboai::Response::RetryAfter() const noexcept {
+	// retry-after may also be an HTTP date, only the delay in seconds is understood
+	auto parse = [](const std::string& value, double scale) -> double {
+		char* end = nullptr;
+		double delay = std::strtod(value.c_str(), &end);
+		return (end != value.c_str() && delay >= 0.0) ? delay * scale : -1.0;
+	};
+	auto found = this->headers.find("retry-after-ms");
+	if (found != this->headers.end()) {
+		double delay = parse(found->second, 0.001);
+		if (delay >= 0.0) {
+			return delay;
+		}
+	}
+	found = this->headers.find("retry-after");
+	return found != this->headers.end() ? parse(found->second, 1.0) : -1.0;
 }
\ No newline at end of file
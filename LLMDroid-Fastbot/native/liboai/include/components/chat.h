@@ -292,6 +292,36 @@ namespace liboai {
 				std::optional<std::string> user = std::nullopt
 			) const& noexcept(false);
 
+			/*
+				@brief Creates a completion from a request body the
+					caller has already serialized, such as
+					{"model":...,"messages":[...]}. The body is handed
+					to curl as is, without being parsed or copied, so
+					it must stay valid until the call returns.
+
+					Key and timeout apply to this request only, so
+					requests sent at the same time from several threads
+					do not have to share those of the Authorizer.
+
+				@param *body             The JSON request body.
+				@param key               The API key of this request instead
+										 of the one set in the Authorizer.
+				@param timeout           The timeout of this request in
+										 milliseconds instead of the one set
+										 in the Authorizer.
+				@param cancel            Aborts the request once set from another
+										 thread, it then throws E_CURLERROR.
+
+				@returns A liboai::Response object containing the
+					data in JSON format.
+			*/
+			LIBOAI_EXPORT liboai::Response create_raw(
+				std::string_view body,
+				std::optional<std::string> key = std::nullopt,
+				std::optional<int32_t> timeout = std::nullopt,
+				const std::atomic<bool>* cancel = nullptr
+			) const & noexcept(false);
+
 		private:
 			Authorization& auth_ = Authorization::Authorizer();
 	};
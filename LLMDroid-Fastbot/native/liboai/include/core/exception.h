@@ -41,11 +41,13 @@ namespace liboai {
 			public:
 				OpenAIException() = default;
 				OpenAIException(const OpenAIException& rhs) noexcept
-					: data_(rhs.data_), error_type_(rhs.error_type_), locale_(rhs.locale_) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+					: data_(rhs.data_), error_type_(rhs.error_type_), locale_(rhs.locale_), status_code_(rhs.status_code_), retry_after_(rhs.retry_after_) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
 				OpenAIException(OpenAIException&& rhs) noexcept
-					: data_(std::move(rhs.data_)), error_type_(rhs.error_type_), locale_(std::move(rhs.locale_)) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+					: data_(std::move(rhs.data_)), error_type_(rhs.error_type_), locale_(std::move(rhs.locale_)), status_code_(rhs.status_code_), retry_after_(rhs.retry_after_) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
 				OpenAIException(std::string_view data, EType error_type, std::string_view locale) noexcept
 					: data_(data), error_type_(error_type), locale_(locale) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+				OpenAIException(std::string_view data, EType error_type, std::string_view locale, long status_code, double retry_after) noexcept
+					: data_(data), error_type_(error_type), locale_(locale), status_code_(status_code), retry_after_(retry_after) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
 
 				const char* what() const noexcept override {
 					return this->fmt_str_.c_str();
@@ -55,20 +57,35 @@ namespace liboai {
 					return _etype_strs_[static_cast<uint8_t>(type)];
 				}
 
+				/*
+					@brief HTTP status code of the failed response, 0 if none was received.
+				*/
+				long GetStatusCode() const noexcept { return this->status_code_; }
+
+				/*
+					@brief Seconds the server asked to wait before retrying
+						(Retry-After), negative if it did not say.
+				*/
+				double GetRetryAfter() const noexcept { return this->retry_after_; }
+
 			private:
 				EType error_type_;
 				std::string data_, locale_, fmt_str_;
+				long status_code_ = 0;
+				double retry_after_ = -1.0;
 		};
 
 		class OpenAIRateLimited : public std::exception {
 			public:
 				OpenAIRateLimited() = default;
 				OpenAIRateLimited(const OpenAIRateLimited& rhs) noexcept
-					: data_(rhs.data_), error_type_(rhs.error_type_), locale_(rhs.locale_) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+					: data_(rhs.data_), error_type_(rhs.error_type_), locale_(rhs.locale_), status_code_(rhs.status_code_), retry_after_(rhs.retry_after_) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
 				OpenAIRateLimited(OpenAIRateLimited&& rhs) noexcept
-					: data_(std::move(rhs.data_)), error_type_(rhs.error_type_), locale_(std::move(rhs.locale_)) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+					: data_(std::move(rhs.data_)), error_type_(rhs.error_type_), locale_(std::move(rhs.locale_)), status_code_(rhs.status_code_), retry_after_(rhs.retry_after_) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
 				OpenAIRateLimited(std::string_view data, EType error_type, std::string_view locale) noexcept
 					: data_(data), error_type_(error_type), locale_(locale) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
+				OpenAIRateLimited(std::string_view data, EType error_type, std::string_view locale, long status_code, double retry_after) noexcept
+					: data_(data), error_type_(error_type), locale_(locale), status_code_(status_code), retry_after_(retry_after) { this->fmt_str_ = (this->locale_ + ": " + this->data_ + " (" + this->GetETypeString(this->error_type_) + ")"); }
 
 				const char* what() const noexcept override {
 					return this->fmt_str_.c_str();
@@ -78,9 +95,22 @@ namespace liboai {
 					return _etype_strs_[static_cast<uint8_t>(type)];
 				}
 
+				/*
+					@brief HTTP status code of the failed response, 0 if none was received.
+				*/
+				long GetStatusCode() const noexcept { return this->status_code_; }
+
+				/*
+					@brief Seconds the server asked to wait before retrying
+						(Retry-After), negative if it did not say.
+				*/
+				double GetRetryAfter() const noexcept { return this->retry_after_; }
+
 			private:
 				EType error_type_;
 				std::string data_, locale_, fmt_str_;
+				long status_code_ = 0;
+				double retry_after_ = -1.0;
 		};
 	}
 }
\ No newline at end of file
@@ -38,10 +38,12 @@
 	#define LIBOAI_EXPORT __declspec(dllexport)
 #endif
 
+#include <atomic>
 #include <fstream>
 #include <optional>	
 #include <mutex>
 #include <future>
+#include <map>
 #include <sstream>
 #include <curl/curl.h>
 #include "response.h"
@@ -296,6 +298,18 @@ namespace liboai {
 					}
 			};
 
+			/*
+				@brief A request body owned by the caller. Unlike Body,
+					it is neither copied into the component nor by curl,
+					so the viewed data must outlive the request.
+			*/
+			class BodyView final {
+				public:
+					explicit BodyView(std::string_view body) : data(body) {}
+
+					std::string_view data;
+			};
+
 			struct Buffer final {
 				using data_t = const unsigned char*;
 
@@ -599,9 +613,24 @@ namespace liboai {
 					intptr_t userdata{};
 					std::function<bool(std::string data, intptr_t userdata)> callback;
 			};
+			/*
+				@brief Aborts a request once the flag is set, from
+					another thread. curl checks it at least once a
+					second while waiting and more often while data
+					flows, the request then throws E_CURLERROR.
+			*/
+			class Cancellation final {
+				public:
+					Cancellation() = default;
+					explicit Cancellation(const std::atomic<bool>* p_flag) : flag(p_flag) {}
+
+					const std::atomic<bool>* flag = nullptr;
+			};
+
 			size_t writeUserFunction(char* ptr, size_t size, size_t nmemb, const WriteCallback* write);
 			size_t writeFunction(char* ptr, size_t size, size_t nmemb, std::string* data);
 			size_t writeFileFunction(char* ptr, size_t size, size_t nmemb, std::ofstream* file);
+			int cancelFunction(const std::atomic<bool>* flag, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
 		}
 
 		/*
@@ -641,7 +670,7 @@ namespace liboai {
 				void PrepareDelete();
 				void PrepareDownload(std::ofstream& file);
 
-				void ParseResponseHeader(const std::string& headers, std::string* status_line, std::string* reason);
+				void ParseResponseHeader(const std::string& headers, std::string* status_line, std::string* reason, std::map<std::string, std::string>* fields = nullptr);
 
 				void SetOption(const components::Url& url);
 				void SetUrl(const components::Url& url);
@@ -651,6 +680,9 @@ namespace liboai {
 				void SetOption(components::Body&& body);
 				void SetBody(components::Body&& body);
 
+				void SetOption(const components::BodyView& body);
+				void SetBodyView(const components::BodyView& body);
+
 				void SetOption(const components::Multipart& multipart);
 				void SetMultipart(const components::Multipart& multipart);
 				void SetOption(components::Multipart&& multipart);
@@ -682,8 +714,12 @@ namespace liboai {
 				void SetOption(components::WriteCallback&& write);
 				void SetWriteCallback(components::WriteCallback&& write);
 
+				void SetOption(const components::Cancellation& cancellation);
+				void SetCancellation(const components::Cancellation& cancellation);
+
 				long status_code = 0; double elapsed = 0.0;
 				std::string status_line{}, content{}, url_str{}, reason{};
+				std::map<std::string, std::string> header_fields{};
 			
 				// internally-used members...
 				curl_slist* headers = nullptr;
@@ -24,6 +24,7 @@
 #include <iostream>
 #include <optional>
 #include <future>
+#include <map>
 #include <nlohmann/json.hpp>
 #include "exception.h"
 
@@ -72,7 +73,8 @@ namespace liboai {
 				std::string&& status_line,
 				std::string&& reason,
 				long status_code,
-				double elapsed
+				double elapsed,
+				std::map<std::string, std::string>&& headers = {}
 			) noexcept(false);
 			
 			Response& operator=(const liboai::Response& other) noexcept;
@@ -97,6 +99,8 @@ namespace liboai {
 			long status_code = 0; double elapsed = 0.0;
 			std::string status_line{}, content{}, url{}, reason{};
 			nlohmann::json raw_json{};
+			// response header fields by lowercase name
+			std::map<std::string, std::string> headers{};
 
 		private:
 			/*
@@ -104,6 +108,12 @@ namespace liboai {
 					for errors and throw exceptions if necessary.
 			*/
 			LIBOAI_EXPORT void CheckResponse() const noexcept(false);
+
+			/*
+				@brief Seconds to wait before retrying as asked by the
+					retry-after-ms or retry-after header, negative if absent.
+			*/
+			double RetryAfter() const noexcept;
 	};
 	using FutureResponse = std::future<liboai::Response>;
 }
@@ -10,6 +10,7 @@
 #include "Model.h"
 #include "StateFactory.h"
 #include "../utils.hpp"
+#include "../Tracer.h"
 #include <ctime>
 #include <iostream>
 
@@ -39,12 +40,36 @@ namespace fastbotx {
     std::string Model::getOperate(const std::string &descContent, const std::string &activity,
                                   const std::string &deviceID) //the entry for getting a new operation
     {
+        TRACE_SCOPE("step");
+        double startTimestamp = currentStamp();
+        // custom events and black widgets have to see every page, don't skip any of them
+        bool usePageCache = !this->_preference || !this->_preference->resolvesEveryPage();
+        uint64_t fingerprint = 0;
+        if (usePageCache) {
+            fingerprint = PageCache::fingerprint(descContent, activity);
+            StatePtr cachedState = this->_pageCache.find(fingerprint);
+            if (cachedState && !cachedState->hasNoDetail()) {
+                this->_pageCache.recordHit(currentStamp() - startTimestamp);
+                OperatePtr operate = getOperateOpt(nullptr, cachedState, activity, deviceID);
+                return operate->toString();
+            }
+        }
+
         const std::string &descContentCopy = descContent;
-        ElementPtr elem = Element::createFromXml(
-                descContentCopy); // get the xml object with tinyxml2
+        ElementPtr elem = nullptr;
+        {
+            TRACE_SCOPE("parseXml");
+            elem = Element::createFromXml(descContentCopy); // get the xml object with tinyxml2
+        }
         if (nullptr == elem)
             return "";
-        return this->getOperate(elem, activity, deviceID);
+        double parsedTimestamp = currentStamp();
+        std::string operateString = this->getOperate(elem, activity, deviceID);
+        if (usePageCache && this->_lastState) {
+            this->_pageCache.recordMiss(parsedTimestamp - startTimestamp + this->_lastBuildCost);
+            this->_pageCache.put(fingerprint, this->_lastState);
+        }
+        return operateString;
     }
 
 
@@ -56,6 +81,19 @@ namespace fastbotx {
         auto agent = AgentFactory::create(agentType, shared_from_this(), useCodeCoverage, deviceType);
         const std::string &deviceID = deviceIDString.empty() ? DefaultDeviceID
                                                              : deviceIDString; // deviceID is device id
+        // a seed in max.config replays the same choices on every run, one per device
+        uint64_t seed = this->_preference ? this->_preference->getRandomSeed() : 0;
+        agent->seedRandom(seed != 0 ? fastMix(seed, fastHash(deviceID)) : timeRandomSeed());
+        if (this->_preference && !this->_preference->getStagnationDetector().empty()) {
+            StagnationDetector detector;
+            if (CodeCoverageMonitor::detectorFromName(this->_preference->getStagnationDetector(), detector))
+                agent->setStagnationDetector(detector);
+            else
+                BLOGE("unknown stagnation detector %s", this->_preference->getStagnationDetector().c_str());
+        }
+        // compare the detectors on a recorded coverage curve
+        if (this->_preference && !this->_preference->getCoverageReplayPath().empty())
+            CodeCoverageMonitor::replayFile(this->_preference->getCoverageReplayPath());
         this->_deviceIDAgentMap.emplace(deviceID,
                                         agent); // add the pair of device and agent to the _deviceIDAgentMap
         this->_graph->addListener(
@@ -82,12 +120,18 @@ namespace fastbotx {
 
     OperatePtr Model::getOperateOpt(const ElementPtr &element, const std::string &activity,
                                     const std::string &deviceID) {
+        return getOperateOpt(element, nullptr, activity, deviceID);
+    }
+
+    OperatePtr Model::getOperateOpt(const ElementPtr &element, const StatePtr &cachedState,
+                                    const std::string &activity, const std::string &deviceID) {
         // the whole process begins.
         double methodStartTimestamp = currentStamp(); //the time stamp of this current time
         ActionPtr customActionPtr = nullptr;
-        if (this->_preference) //load the preferred action in preference file specified by user in sdcard
+        if (this->_preference && !cachedState) //load the preferred action in preference file specified by user in sdcard
         {
             BLOG("try get custom action from preference");
+            TRACE_SCOPE("resolvePage");
             customActionPtr = this->_preference->resolvePageAndGetSpecifiedAction(activity,
                                                                                   element);
         }
@@ -116,18 +160,29 @@ namespace fastbotx {
 
         // get state
         StatePtr state = nullptr;
-        if (nullptr != element) // make sure the XML is not null
+        if (cachedState) {
+            // an exact repeat of a page seen before, the state built from it is still valid
+            state = cachedState;
+        }
+        else if (nullptr != element) // make sure the XML is not null
         {
             //according to the type of the used agent, create the state of this page
             //include all the possible actions according to the widgets inside.
+            TRACE_SCOPE("buildState");
             state = StateFactory::createState(agent->getAlgorithmType(), activityStringPtr,
-                                              element);
+                                              element, this->_lastState);
+            this->_lastBuildCost = currentStamp() - methodStartTimestamp;
+        }
+        if (state)
+        {
             // add state
             // add this state, and the agent will treat this state as the new state(_newState)
             state = this->_graph->addState(state);
+            this->_lastState = state;
             state->visit(this->_graph->getTimestamp());
 
             ReuseStatePtr reuseState = std::dynamic_pointer_cast<ReuseState>(state);
+            TRACE_SCOPE("processState");
             agent->processState(reuseState);
             
         }
@@ -156,6 +211,7 @@ namespace fastbotx {
                 BLOG("Ran into a block state %s", state ? state->getId().c_str() : "");
             } else {
                 // this is also an entry for modifying RL model
+                TRACE_SCOPE("selectAction");
                 action = std::dynamic_pointer_cast<Action>(agent->resolveNewAction());
                 callJavaLogger(MAIN_THREAD, "[MAIN] after resolveNewAction: %s", action->toDescription().c_str());
                 //MLOG("[Action after resolveNewAction]: %s", action->toDescription().c_str());
@@ -219,6 +275,7 @@ namespace fastbotx {
     }
 
     Model::~Model() {
+        BLOG("page cache: %s", this->_pageCache.statistics().c_str());
         this->_deviceIDAgentMap.clear();
     }
 
@@ -16,6 +16,7 @@
 #include "AbstractAgent.h"
 #include "AgentFactory.h"
 #include "Preference.h"
+#include "PageCache.h"
 
 namespace fastbotx {
 
@@ -91,6 +92,11 @@ namespace fastbotx {
         Model();
 
     private:
+        /// getOperateOpt for a page whose state is already known, skipping Preference and state building
+        /// \param cachedState state built from an identical page earlier, nullptr to build one from element
+        OperatePtr getOperateOpt(const ElementPtr &element, const StatePtr &cachedState,
+                                 const std::string &activity, const std::string &deviceID);
+
         // The smart pointer of the graph object
         GraphPtr _graph;
         // A map containing pairs of device id and the corresponding agent object
@@ -101,6 +107,14 @@ namespace fastbotx {
         // The parameters for communicating with the net model
         NetActionParam _netActionParam;
 
+        // The state of the previous page, diffed against the next page when building its state
+        StatePtr _lastState;
+
+        // Raw dump fingerprint => state, lets exact repeats of a page skip parsing and building
+        PageCache _pageCache;
+        // Milliseconds spent on Preference and state building for the last page
+        double _lastBuildCost = 0.0;
+
     };
 
     typedef std::shared_ptr<Model> ModelPtr;
@@ -0,0 +1,133 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef PageCache_CPP_
+#define PageCache_CPP_
+
+#include "PageCache.h"
+#include "../utils.hpp"
+#include <cctype>
+#include <cstring>
+
+namespace fastbotx {
+
+    // attributes parsed by Element but never read by widgets, hashes or descriptions
+    static const char *const VolatileAttributes[] = {"checked", "focusable", "focused", "password",
+                                                     "selected"};
+
+    /// \return the length of `name="value"` if the attribute at data is volatile, otherwise 0
+    static size_t volatileAttributeLength(const char *data, size_t size) {
+        for (const char *name: VolatileAttributes) {
+            size_t nameLength = strlen(name);
+            if (size < nameLength + 2 || strncmp(data, name, nameLength) != 0 ||
+                data[nameLength] != '=' || data[nameLength + 1] != '"') {
+                continue;
+            }
+            const void *closing = memchr(data + nameLength + 2, '"', size - nameLength - 2);
+            if (closing == nullptr) {
+                return 0;
+            }
+            return static_cast<const char *>(closing) - data + 1;
+        }
+        return 0;
+    }
+
+    PageCache::PageCache(size_t capacity)
+            : _capacity(capacity), _hits(0), _misses(0), _hitCost(0.0), _missCost(0.0) {
+    }
+
+    uint64_t PageCache::fingerprint(const std::string &dump, const std::string &activity) {
+        uint64_t hashcode = fastHash(activity, 0x5bd1e995);
+        const char *data = dump.data();
+        size_t size = dump.size();
+        // the kept bytes are hashed span by span, chained through the seed
+        size_t spanStart = 0;
+        bool inTag = false;
+        bool inValue = false;
+        for (size_t i = 0; i < size; i++) {
+            char c = data[i];
+            if (inValue) {
+                inValue = c != '"';
+            } else if (inTag) {
+                if (c == '"') {
+                    inValue = true;
+                } else if (c == '>') {
+                    inTag = false;
+                } else if (c == ' ') {
+                    size_t skip = volatileAttributeLength(data + i + 1, size - i - 1);
+                    if (skip > 0) {
+                        hashcode = fastHash(data + spanStart, i - spanStart, hashcode);
+                        i += skip;
+                        spanStart = i + 1;
+                    }
+                }
+            } else if (c == '<') {
+                inTag = true;
+            } else if (isspace(static_cast<unsigned char>(c))) {
+                size_t end = i;
+                while (end < size && isspace(static_cast<unsigned char>(data[end]))) {
+                    end++;
+                }
+                hashcode = fastHash(data + spanStart, i - spanStart, hashcode);
+                spanStart = end;
+                i = end - 1;
+            }
+        }
+        return fastHash(data + spanStart, size - spanStart, hashcode);
+    }
+
+    StatePtr PageCache::find(uint64_t fingerprint) {
+        auto iterator = this->_index.find(fingerprint);
+        if (iterator == this->_index.end()) {
+            return nullptr;
+        }
+        this->_entries.splice(this->_entries.begin(), this->_entries, iterator->second);
+        return iterator->second->second;
+    }
+
+    void PageCache::put(uint64_t fingerprint, const StatePtr &state) {
+        auto iterator = this->_index.find(fingerprint);
+        if (iterator != this->_index.end()) {
+            iterator->second->second = state;
+            this->_entries.splice(this->_entries.begin(), this->_entries, iterator->second);
+            return;
+        }
+        this->_entries.emplace_front(fingerprint, state);
+        this->_index[fingerprint] = this->_entries.begin();
+        if (this->_entries.size() > this->_capacity) {
+            this->_index.erase(this->_entries.back().first);
+            this->_entries.pop_back();
+        }
+    }
+
+    void PageCache::recordHit(double cost) {
+        this->_hits++;
+        this->_hitCost += cost;
+        if ((this->_hits + this->_misses) % 100 == 0) {
+            BLOG("page cache: %s", statistics().c_str());
+        }
+    }
+
+    void PageCache::recordMiss(double cost) {
+        this->_misses++;
+        this->_missCost += cost;
+        if ((this->_hits + this->_misses) % 100 == 0) {
+            BLOG("page cache: %s", statistics().c_str());
+        }
+    }
+
+    std::string PageCache::statistics() const {
+        long total = this->_hits + this->_misses;
+        double hitRate = total > 0 ? 100.0 * this->_hits / total : 0.0;
+        double averageMissCost = this->_misses > 0 ? this->_missCost / this->_misses : 0.0;
+        // a hit costs the lookup instead of a whole build
+        double saved = averageMissCost * this->_hits - this->_hitCost;
+        std::stringstream stats;
+        stats << "hits " << this->_hits << "/" << total << " (" << hitRate << "%), "
+              << "avg build " << averageMissCost << "ms, saved " << saved << "ms";
+        return stats.str();
+    }
+
+}
+
+#endif //PageCache_CPP_
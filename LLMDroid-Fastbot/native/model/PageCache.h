@@ -0,0 +1,57 @@
+/*
+ * This code is licensed under the Fastbot license. You may obtain a copy of this license in the LICENSE.txt file in the root directory of this source tree.
+ */
+#ifndef PageCache_H_
+#define PageCache_H_
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include "State.h"
+
+namespace fastbotx {
+
+    /// Maps the fingerprint of a raw page dump to the state already built from it, so an exact
+    /// repeat of a page (loading spinners, blocked states) skips parsing, Preference and state building.
+    class PageCache {
+    public:
+        explicit PageCache(size_t capacity = 64);
+
+        /// Fingerprint of a raw xml dump, computed without parsing it.
+        /// Whitespace between tags and the attributes that never reach a state
+        /// (checked, focusable, focused, password, selected) are left out.
+        /// \param dump the xml dump of the page
+        /// \param activity activity of the page
+        /// \return the fingerprint
+        static uint64_t fingerprint(const std::string &dump, const std::string &activity);
+
+        /// \return the state built from a page with this fingerprint, nullptr if not cached
+        StatePtr find(uint64_t fingerprint);
+
+        /// remember the state of a page, evicting the least recently used one when full
+        void put(uint64_t fingerprint, const StatePtr &state);
+
+        /// \param cost milliseconds spent on the cache lookup
+        void recordHit(double cost);
+
+        /// \param cost milliseconds spent on parsing, Preference and building the state
+        void recordMiss(double cost);
+
+        /// hit rate and estimated time saved so far
+        std::string statistics() const;
+
+    private:
+        size_t _capacity;
+        // most recently used first
+        std::list<std::pair<uint64_t, StatePtr>> _entries;
+        std::unordered_map<uint64_t, std::list<std::pair<uint64_t, StatePtr>>::iterator> _index;
+
+        long _hits;
+        long _misses;
+        double _hitCost;
+        double _missCost;
+    };
+
+}
+
+#endif //PageCache_H_
@@ -46,29 +46,36 @@ void initJavaLogger(JNIEnv* env)
 {
     fastbotx::jnienv = env;
     // 1. Get the corresponding Java class object
-    fastbotx::loggerClass = fastbotx::jnienv->FindClass("com/android/commands/monkey/utils/Logger");
-    if (fastbotx::loggerClass == nullptr) {
+    jclass localLoggerClass = fastbotx::jnienv->FindClass("com/android/commands/monkey/utils/Logger");
+    if (localLoggerClass == nullptr) {
         // Handling the case where the class is not found
         MLOG("can't find logger class");
         return;
     }
+    // a global reference, the logger's drain thread uses it long after this call returns
+    fastbotx::loggerClass = (jclass) fastbotx::jnienv->NewGlobalRef(localLoggerClass);
+    fastbotx::jnienv->DeleteLocalRef(localLoggerClass);
     // 2. Get the corresponding static method ID
     fastbotx::printlnMethod = fastbotx::jnienv->GetStaticMethodID(fastbotx::loggerClass, "println", "(Ljava/lang/Object;)V");
     if (fastbotx::printlnMethod == nullptr) {
         // Handle the situation when the method is not found
         return;
     }
+    fastbotx::AsyncLogger::inst().setJavaLogger(fastbotx::jvm, fastbotx::loggerClass, fastbotx::printlnMethod);
 }
 
 void initCodeCoverage()
 {
     // 1. Get the corresponding Java class object
-    fastbotx::codeCoverageClass = fastbotx::jnienv->FindClass("com/android/commands/monkey/utils/CodeCoverage");
-    if (fastbotx::codeCoverageClass == nullptr) {
+    jclass localCodeCoverageClass = fastbotx::jnienv->FindClass("com/android/commands/monkey/utils/CodeCoverage");
+    if (localCodeCoverageClass == nullptr) {
         // Handling the case where the class is not found
         fastbotx::callJavaLogger(MAIN_THREAD, "can't find CodeCoverage class");
         return;
     }
+    // a global reference, the coverage sampler thread uses it
+    fastbotx::codeCoverageClass = (jclass) fastbotx::jnienv->NewGlobalRef(localCodeCoverageClass);
+    fastbotx::jnienv->DeleteLocalRef(localCodeCoverageClass);
     // 2. Get the corresponding static method ID
     fastbotx::getCoverageMethod = fastbotx::jnienv->GetStaticMethodID(fastbotx::codeCoverageClass, "getCoverage", "()D");
     if (fastbotx::getCoverageMethod == nullptr) {
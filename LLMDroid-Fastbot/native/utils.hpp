@@ -10,27 +10,59 @@
 #define TAG "[Fastbot]"
 #define MY_TAG "[MyLog]"
 
+// Lowest level compiled in: 0 debug, 1 info, 2 warn, 3 error.
+// Lines below it cost nothing, their arguments are not even evaluated.
+#ifndef FASTBOT_LOG_LEVEL
+#ifdef NDEBUG
+#define FASTBOT_LOG_LEVEL 1
+#else
+#define FASTBOT_LOG_LEVEL 0
+#endif
+#endif
+
 #ifdef __ANDROID__
 
 #include <android/log.h>
 
+#if FASTBOT_LOG_LEVEL <= 0
 #define LOGD(fmt, ...) __android_log_print(ANDROID_LOG_DEBUG,TAG ,fmt, ##__VA_ARGS__)
+#endif
+#if FASTBOT_LOG_LEVEL <= 1
 #define LOGI(fmt, ...) __android_log_print(ANDROID_LOG_INFO,TAG ,fmt, ##__VA_ARGS__)
+#endif
+#if FASTBOT_LOG_LEVEL <= 2
 #define LOGW(fmt, ...) __android_log_print(ANDROID_LOG_WARN,TAG ,fmt, ##__VA_ARGS__)
+#endif
 #define LOGE(fmt, ...) __android_log_print(ANDROID_LOG_ERROR,TAG ,fmt, ##__VA_ARGS__)
 #define LOGF(fmt, ...) __android_log_print(ANDROID_LOG_FATAL,TAG ,fmt, ##__VA_ARGS__)
 #define MLOG(fmt, ...) __android_log_print(ANDROID_LOG_WARN,MY_TAG ,fmt, ##__VA_ARGS__)
 
 #else
 #define Time_Format_Now (getTimeFormatStr().c_str())
+#if FASTBOT_LOG_LEVEL <= 0
 #define LOGD(fmt, ...) printf(TAG "[%s] DEBUG[%s][%s][%d]:" fmt "\n", Time_Format_Now, __FILE__, __FUNCTION__, __LINE__, ##__VA_ARGS__)
+#endif
+#if FASTBOT_LOG_LEVEL <= 1
 #define LOGI(fmt, ...) printf(TAG "[%s] :" fmt "\n", Time_Format_Now ,##__VA_ARGS__)
+#endif
+#if FASTBOT_LOG_LEVEL <= 2
 #define LOGW(fmt, ...) printf(TAG "[%s] WARNING:" fmt "\n", Time_Format_Now, ##__VA_ARGS__)
+#endif
 #define LOGE(fmt, ...) printf(TAG "[%s] ERROR:" fmt "\n", Time_Format_Now, ##__VA_ARGS__)
 #define LOGF(...)
 #define MLOG(fmt, ...) printf(MY_TAG "[%s]:" fmt "\n", Time_Format_Now ,##__VA_ARGS__)
 #endif
 
+#ifndef LOGD
+#define LOGD(...) ((void)0)
+#endif
+#ifndef LOGI
+#define LOGI(...) ((void)0)
+#endif
+#ifndef LOGW
+#define LOGW(...) ((void)0)
+#endif
+
 #ifdef __ANDROID__
 #define ACTIVITY_VC_STR "activity"
 #else
@@ -68,6 +100,12 @@
 
 #define STATE_MERGE_DETAIL_TEXT 1
 
+// Layout of the string hashes in element, widget, action and state hashes (see hashString).
+// 1 reproduces the std::hash layout of earlier builds, 2 uses fastHash.
+// Action hashes are persisted in the reuse model, whose file name carries the layout version,
+// so a model saved with one layout is never read with another one.
+#define HASH_LAYOUT_VERSION 2
+
 #define BLOCK_STATE_TIME_RESTART (-1)
 
 #define FORCE_EDITTEXT_CLICK_TRUE 1
@@ -0,0 +1,274 @@
+"""
+Offline comparison of the HTML and the compact page description.
+
+Reads the prompts and responses fastbot recorded in /sdcard/gpt.txt, rewrites the page
+descriptions of STATE_OVERVIEW, TEST_FUNCTION and REANALYSIS prompts into the compact
+form (the same encoding as StateStructure::generateCompactDescription) and reports the
+tokens saved. With --ask, the compact prompts are sent to the model and its answers are
+compared with the recorded ones.
+
+    adb pull /sdcard/gpt.txt
+    python compare_description_format.py gpt.txt
+    python compare_description_format.py gpt.txt --ask --api-key sk-... --model gpt-4o-mini
+"""
+import argparse
+import json
+import re
+import sys
+
+SEPARATOR = re.compile(r"^-{39}\d*$")
+
+# must match _compactFormatPrompt in native/agent/prompt.h
+COMPACT_LEGEND = """
+Instead of HTML, the description below uses a compact form with the same information. Each line is one element, and a child is indented one space deeper than its parent, so there are no closing tags.
+A line starts with the tag: b (button), c (checkbox), s (scroller), i (input) or p, followed by "#" and the element's id, e.g. "b#12" is the button whose id is 12. Then come ".class", "@resource-id", "content-desc" in double quotes, dir:v, dir:h or dir:vh (scroll direction), and ": text" at the end.
+A line "+N same as above: #a/#b, #c/#d" stands for N more siblings identical to the previous one, listing their ids in the same order as the ids of the previous one.
+"""
+
+# code block header in the html prompt, question type, header in the compact prompt; a batched
+# overview has one block per state, its header ends with " of State<id>"
+BLOCKS = [
+    (re.compile(r"```HTML Description(?P<state> of State\d+)?\n"), "STATE_OVERVIEW", "```Compact Description"),
+    (re.compile(r"```Page Description\n"), "TEST_FUNCTION", "```Page Description"),
+    (re.compile(r"```Controls in HTML Description\n"), "REANALYSIS", "```Controls in Compact Description"),
+]
+
+TAGS = {"button": "b", "checkbox": "c", "scroller": "s", "input": "i", "p": "p"}
+DIRECTIONS = {"vertical, horizontal": "vh", "horizontal": "h", "vertical": "v"}
+HTML_LINE = re.compile(
+    r'^<(?P<tag>\w+) (?:id=(?P<id>\d+) )?(?:class="(?P<cls>.*?)" )?(?:resource-id="(?P<rid>.*?)" )?'
+    r'(?:content-desc="(?P<desc>.*?)" )?(?:direction="(?P<dir>.*?)" )?(?:input="\?" )?>(?P<text>.*)$')
+CLOSING_LINE = re.compile(r"^</\w+>$")
+
+
+def read_records(path):
+    """Pairs of (prompt, response) in the order they were saved."""
+    chunks, current = [], []
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            if SEPARATOR.match(line.rstrip("\n")):
+                if current:
+                    chunks.append("".join(current))
+                current = []
+            else:
+                current.append(line)
+    if current:
+        chunks.append("".join(current))
+    records, prompt = [], None
+    for chunk in chunks:
+        if chunk.startswith("Prompt:\n"):
+            prompt = chunk[len("Prompt:\n"):].rstrip("\n")
+        elif chunk.startswith("Response:\n") and prompt is not None:
+            records.append((prompt, chunk[len("Response:\n"):].rstrip("\n")))
+            prompt = None
+    return records
+
+
+class Node:
+    def __init__(self, fragment, element_id, depth):
+        self.fragment = fragment  # the line without indentation and id
+        self.id = element_id
+        self.depth = depth
+        self.children = []
+
+    def signature(self):
+        return "".join(self.fragment) + "(" + ",".join(child.signature() for child in self.children) + ")"
+
+    def ids(self):
+        result = [] if self.id is None else ["#" + self.id]
+        for child in self.children:
+            result.extend(child.ids())
+        return result
+
+
+def compact_line(match):
+    tag = match.group("tag")
+    cls, rid, desc, direction = match.group("cls"), match.group("rid"), match.group("desc"), match.group("dir")
+    text = match.group("text")
+    end_tag = "</%s>" % tag
+    if text.endswith(end_tag):
+        text = text[:-len(end_tag)]
+    line = ""
+    if cls:
+        line += " ." + cls
+    if rid:
+        line += " @" + rid
+    if desc:
+        line += ' "%s"' % desc
+    if direction in DIRECTIONS:
+        line += " dir:" + DIRECTIONS[direction]
+    if text:
+        line += ": " + text.replace(" <br> ", " | ")
+    return TAGS.get(tag, tag), line
+
+
+def html_to_compact(html):
+    roots, stack, out = [], [], []
+    for raw in html.split("\n"):
+        depth = len(raw) - len(raw.lstrip("\t"))
+        line = raw.lstrip("\t")
+        if not line or CLOSING_LINE.match(line):
+            continue
+        match = HTML_LINE.match(line)
+        if not match:
+            # "[Activity: ...]" or a line cut by the length limit, kept as it is
+            roots.append(Node(line, None, -1))
+            stack = []
+            continue
+        tag, rest = compact_line(match)
+        node = Node((tag, rest), match.group("id"), depth)
+        while stack and stack[-1].depth >= depth:
+            stack.pop()
+        (stack[-1].children if stack else roots).append(node)
+        stack.append(node)
+
+    def write(node, indent):
+        if node.depth < 0:
+            out.append(node.fragment)
+            return
+        tag, rest = node.fragment
+        out.append(" " * indent + tag + ("#" + node.id if node.id is not None else "") + rest)
+        write_children(node.children, indent + 1)
+
+    def write_children(children, indent):
+        i = 0
+        while i < len(children):
+            write(children[i], indent)
+            j = i + 1
+            while j < len(children) and children[j].signature() == children[i].signature():
+                j += 1
+            if j - i > 1:
+                ids = ", ".join("/".join(child.ids()) for child in children[i + 1:j] if child.ids())
+                out.append(" " * indent + "+%d same as above" % (j - i - 1) + (": " + ids if ids else ""))
+            i = j
+
+    for root in roots:
+        write(root, max(root.depth, 0))
+    return "\n".join(out) + "\n"
+
+
+def to_compact_prompt(prompt):
+    """The compact prompt and its question type, or (None, None) if it has no page description."""
+    for header, question, compact_header in BLOCKS:
+        parts = []
+        position = 0
+        for match in header.finditer(prompt):
+            if match.start() < position:
+                continue
+            end = prompt.find("```", match.end())
+            if end < 0:
+                end = len(prompt)
+            # the legend once, before the first description
+            parts.append(prompt[position:match.start()] + (COMPACT_LEGEND if not parts else ""))
+            parts.append(compact_header + (match.groupdict().get("state") or "") + "\n")
+            parts.append(html_to_compact(prompt[match.end():end].rstrip("\n")))
+            position = end
+        if parts:
+            return "".join(parts) + prompt[position:], question
+    return None, None
+
+
+def token_counter(model):
+    try:
+        import tiktoken
+        try:
+            encoding = tiktoken.encoding_for_model(model)
+        except KeyError:
+            encoding = tiktoken.get_encoding("o200k_base")
+        return (lambda text: len(encoding.encode(text))), "tiktoken"
+    except ImportError:
+        return (lambda text: (len(text) + 3) // 4), "chars/4 estimate"
+
+
+def parse_json(response):
+    start, end = response.find("{"), response.rfind("}")
+    if start < 0 or end < start:
+        return None
+    try:
+        return json.loads(response[start:end + 1])
+    except ValueError:
+        return None
+
+
+def jaccard(a, b):
+    if not a and not b:
+        return 1.0
+    return len(a & b) / len(a | b)
+
+
+def agreement(question, recorded, answered):
+    """1.0 when both answers pick the same elements, None if either can't be read."""
+    recorded, answered = parse_json(recorded), parse_json(answered)
+    if recorded is None or answered is None:
+        return None
+    if question == "TEST_FUNCTION":
+        key = ("Element Id", "Action Type")
+        return 1.0 if tuple(recorded.get(k) for k in key) == tuple(answered.get(k) for k in key) else 0.0
+    if question == "STATE_OVERVIEW":
+        ids = lambda answer: {str(v) for v in (answer.get("Function List") or {}).values()}
+        return jaccard(ids(recorded), ids(answered))
+    return jaccard(set(recorded.keys()), set(answered.keys()))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("records", help="gpt.txt pulled from the device")
+    parser.add_argument("--model", default="gpt-4o-mini")
+    parser.add_argument("--ask", action="store_true", help="send the compact prompts and compare the answers")
+    parser.add_argument("--api-key")
+    parser.add_argument("--base-url")
+    parser.add_argument("--limit", type=int, default=0, help="compare at most this many prompts")
+    parser.add_argument("--dump", help="write the compact prompts to this file")
+    args = parser.parse_args()
+
+    count_tokens, counter_name = token_counter(args.model)
+    client = None
+    if args.ask:
+        from openai import OpenAI
+        client = OpenAI(api_key=args.api_key, base_url=args.base_url)
+
+    stats = {}
+    dump = open(args.dump, "w", encoding="utf-8") if args.dump else None
+    compared = 0
+    for index, (prompt, response) in enumerate(read_records(args.records)):
+        compact, question = to_compact_prompt(prompt)
+        if compact is None:
+            continue
+        if args.limit and compared >= args.limit:
+            break
+        compared += 1
+        html_tokens, compact_tokens = count_tokens(prompt), count_tokens(compact)
+        entry = stats.setdefault(question, {"prompts": 0, "html": 0, "compact": 0, "agreement": []})
+        entry["prompts"] += 1
+        entry["html"] += html_tokens
+        entry["compact"] += compact_tokens
+        line = "#%d %s: %d -> %d tokens" % (index, question, html_tokens, compact_tokens)
+        if client:
+            answer = client.chat.completions.create(model=args.model, temperature=0.0,
+                                                    messages=[{"role": "user", "content": compact}])
+            score = agreement(question, response, answer.choices[0].message.content)
+            if score is not None:
+                entry["agreement"].append(score)
+            line += ", agreement %s" % ("n/a" if score is None else "%.2f" % score)
+        print(line)
+        if dump:
+            dump.write("-" * 39 + "\nPrompt:\n" + compact + "\n")
+
+    if dump:
+        dump.close()
+    if not stats:
+        print("no prompts with a page description in %s" % args.records)
+        return 1
+    print("\ntokens counted with %s" % counter_name)
+    for question, entry in sorted(stats.items()):
+        saved = entry["html"] - entry["compact"]
+        line = "%-15s %4d prompts, %8d -> %8d tokens, saved %5.1f%%" % (
+            question, entry["prompts"], entry["html"], entry["compact"], 100.0 * saved / max(entry["html"], 1))
+        if entry["agreement"]:
+            line += ", answer agreement %.2f" % (sum(entry["agreement"]) / len(entry["agreement"]))
+        print(line)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,48 @@
+#!/bin/bash
+# Builds native/bench/fastbot_bench for arm64, runs it on the connected device and keeps the
+# results as native/bench/baselines/<commit>.json, compared with the newest older baseline.
+#
+#   BENCHMARK_ROOT=$VCPKG_ROOT/installed/arm64-android tools/run_native_bench.sh [benchmark flags]
+#
+# BENCHMARK_ROOT is where Google Benchmark was installed for arm64-android. Set BENCH_TREES to a
+# local directory of dumped pages (*.xml) to also parse recorded trees, and GBENCH_COMPARE to
+# benchmark's tools/compare.py to print the comparison. The agent and reuse model benchmarks
+# need /sdcard/config.json on the device, like a normal run.
+set -e
+
+cd "$(dirname "$0")/.."
+ROOT=$(pwd)
+BUILD_DIR="$ROOT/native/bench/build"
+BASELINES="$ROOT/native/bench/baselines"
+DEVICE_DIR=/data/local/tmp/fastbot_bench
+
+mkdir -p "$BUILD_DIR" "$BASELINES"
+cmake -S native -B "$BUILD_DIR" \
+  -DCMAKE_TOOLCHAIN_FILE=$NDK_ROOT/build/cmake/android.toolchain.cmake \
+  -DANDROID_ABI=arm64-v8a -DCMAKE_BUILD_TYPE=Release \
+  -DFASTBOT_BUILD_BENCH=ON -DCMAKE_PREFIX_PATH="$BENCHMARK_ROOT"
+cmake --build "$BUILD_DIR" --target fastbot_bench -j8
+
+adb shell mkdir -p $DEVICE_DIR/trees
+adb push "$BUILD_DIR/bench/fastbot_bench" $DEVICE_DIR/
+TREES_ENV=""
+if [ -n "$BENCH_TREES" ]; then
+  adb push "$BENCH_TREES"/*.xml $DEVICE_DIR/trees/
+  TREES_ENV="FASTBOT_BENCH_TREES=$DEVICE_DIR/trees"
+fi
+adb shell "cd $DEVICE_DIR && $TREES_ENV ./fastbot_bench --benchmark_out=result.json --benchmark_out_format=json $*"
+
+COMMIT=$(git rev-parse --short HEAD)
+# the baselines kept so far are no change to the code
+if [ -n "$(git status --porcelain -- native ':!native/bench/baselines')" ]; then
+  COMMIT="$COMMIT-dirty"
+fi
+PREVIOUS=$(ls -t "$BASELINES"/*.json 2>/dev/null | grep -v "/$COMMIT.json$" | head -1 || true)
+adb pull $DEVICE_DIR/result.json "$BASELINES/$COMMIT.json"
+echo "results: $BASELINES/$COMMIT.json"
+
+if [ -n "$PREVIOUS" ] && [ -n "$GBENCH_COMPARE" ]; then
+  python3 "$GBENCH_COMPARE" benchmarks "$PREVIOUS" "$BASELINES/$COMMIT.json"
+elif [ -n "$PREVIOUS" ]; then
+  echo "previous baseline: $PREVIOUS, set GBENCH_COMPARE to compare"
+fi